@@ -68,6 +68,9 @@ using namespace vcg;
 bool NumberOfSamples                = false;
 bool SamplesPerAreaUnit             = false;
 bool CleaningFlag=false;
+bool BoundedFlag=false;
+double BoundTolerance=0;
+double BoundThreshold=-1;
 // -----------------------------------------------------------------------------------------------
 
 void Usage()
@@ -94,6 +97,9 @@ void Usage()
 																				"  -O         Use an octree as a Search Structure\n"\
                                         "  -A         Use an AxisAligned Bounding Box Tree as Search Structure\n"\
                                         "  -H         Use an Hashed Uniform Grid as Search Structure\n"\
+                                        "  -b#        compute lower/upper bounds of the Hausdorff distance by adaptive refinement\n"\
+                                        "             instead of dense sampling, until they are closer than # (absolute)\n"\
+                                        "  -t#        with -b, stop as soon as the bounds tell if the distance exceeds #\n"\
                                         "\n"
                                         "Default options are to sample vertexes, edge and faces by taking \n"
                                         "a number of samples that is approx. 10x the face number.\n"
@@ -133,8 +139,8 @@ int main(int argc, char**argv)
     CMesh                 S1, S2;
     float                ColorMin=0, ColorMax=0;
     double                dist1_max, dist2_max;
-    unsigned long         n_samples_target, elapsed_time;
-    double								n_samples_per_area_unit;
+    unsigned long         n_samples_target=0, elapsed_time;
+    double								n_samples_per_area_unit=0;
     int                   flags;
 
     // print program info
@@ -176,6 +182,8 @@ int main(int argc, char**argv)
         case 'a':  SamplesPerAreaUnit    = true;     n_samples_per_area_unit = (unsigned long) atoi(&(argv[i][2])); break;
         case 'c':  flags |= SamplingFlags::SAVE_ERROR;   break;
         case 'L':  CleaningFlag=true; break;
+        case 'b':  BoundedFlag=true; BoundTolerance=atof(&(argv[i][2])); break;
+        case 't':  BoundThreshold=atof(&(argv[i][2])); break;
         case 'C':  ColorMin=float(atof(argv[i+1])); ColorMax=float(atof(argv[i+2])); i+=2; break;
         case 'A':  flags |= SamplingFlags::USE_AABB_TREE;   printf("Using AABB Tree as search structure\n");           break;
         case 'G':  flags |= SamplingFlags::USE_STATIC_GRID; printf("Using static uniform grid as search structure\n"); break;
@@ -234,6 +242,35 @@ int main(int argc, char**argv)
     printf("\tbbox (%7.4f %7.4f %7.4f)-(%7.4f %7.4f %7.4f)\n", tmp_bbox_M2.min[0], tmp_bbox_M2.min[1], tmp_bbox_M2.min[2], tmp_bbox_M2.max[0], tmp_bbox_M2.max[1], tmp_bbox_M2.max[2]);
     printf("\tbbox diagonal %f\n", (float)tmp_bbox_M2.Diag());
 
+    if(BoundedFlag)
+    {
+      Sampling<CMesh> *sampling[2] = { &ForwardSampling, &BackwardSampling };
+      const char *name[2] = { "Forward distance (M1 -> M2)", "Backward distance (M2 -> M1)" };
+      double lb = 0, ub = 0;
+      unsigned long n_queries = 0;
+      for(int k=0; k<2; ++k)
+      {
+        printf("\n%s:\n", name[k]);
+        sampling[k]->SetFlags(flags);
+        sampling[k]->BoundedHausdorff(BoundTolerance, BoundThreshold);
+        const Point3d wp = sampling[k]->GetWorstPoint();
+        printf("  lower bound : %f (%f  wrt bounding box diagonal)\n", sampling[k]->GetDistLowerBound(), sampling[k]->GetDistLowerBound()/bbox.Diag());
+        printf("  upper bound : %f (%f  wrt bounding box diagonal)\n", sampling[k]->GetDistUpperBound(), sampling[k]->GetDistUpperBound()/bbox.Diag());
+        printf("  worst point : (%f %f %f)\n", wp[0], wp[1], wp[2]);
+        printf("# distance queries %9lu\n", sampling[k]->GetNSamples());
+        lb = max(lb, sampling[k]->GetDistLowerBound());
+        ub = max(ub, sampling[k]->GetDistUpperBound());
+        n_queries += sampling[k]->GetNSamples();
+      }
+      elapsed_time = clock() - t0;
+      printf("\nHausdorff distance bounds: [%f, %f] ([%f, %f]  wrt bounding box diagonal)\n", lb, ub, lb/bbox.Diag(), ub/bbox.Diag());
+      if(BoundThreshold >= 0)
+        printf("  Hausdorff distance %s %f\n", (lb > BoundThreshold) ? "exceeds" : (ub <= BoundThreshold) ? "does not exceed" : "is within tolerance from", BoundThreshold);
+      printf("  Computation time  : %d ms\n",(int)(1000.0*elapsed_time/CLOCKS_PER_SEC));
+      printf("  # distance queries: %lu\n\n", n_queries);
+      return 0;
+    }
+
     // Forward distance.
     printf("\nForward distance (M1 -> M2):\n");
     ForwardSampling.SetFlags(flags);
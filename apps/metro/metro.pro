@@ -8,3 +8,10 @@ SOURCES += metro.cpp ../../wrap/ply/plylib.cpp
 
 # Mac specific Config required to avoid to make application bundles
 CONFIG -= app_bundle
+
+# OpenMP, used by the multithreaded sampling
+msvc: QMAKE_CXXFLAGS += /openmp
+else {
+  QMAKE_CXXFLAGS += -fopenmp
+  QMAKE_LFLAGS += -fopenmp
+}
@@ -25,9 +25,11 @@
 #define __VCGLIB__SAMPLING
 
 #include <time.h>
+#include <queue>
 #include <vcg/complex/algorithms/closest.h>
 #include <vcg/space/box3.h>
 #include <vcg/math/histogram.h>
+#include <vcg/math/random_generator.h>
 #include <vcg/space/color4.h>
 #include <vcg/simplex/face/distance.h>
 #include <vcg/complex/algorithms/update/color.h>
@@ -35,6 +37,9 @@
 #include <vcg/space/index/aabb_binary_tree/aabb_binary_tree.h>
 #include <vcg/space/index/octree.h>
 #include <vcg/space/index/spatial_hashing.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 namespace vcg
 {
 
@@ -57,6 +62,19 @@ struct SamplingFlags{
 				};
 	};
 // -----------------------------------------------------------------------------------------------
+/*
+  The sampling is multithreaded (when compiled with OpenMP).
+  The elements (vertices, edges, faces) of S1 are processed in blocks of BlockSize elements;
+  the number of samples of each element is computed serially (as in the original serial code),
+  then the blocks are sampled concurrently. Each block accumulates its own partial statistics,
+  that are merged in block order, and uses its own random stream for the Montecarlo sampling,
+  so the results do not depend on the number of threads. Each thread fills its own histogram.
+  The search structures over S2 are shared read-only: the closest point queries do not mark
+  the faces of S2. The octree is not thread safe and, when it is used, the sampling runs serially.
+
+  BoundedHausdorff() is an adaptive alternative to the dense sampling: it returns a lower and
+  an upper bound of the one sided Hausdorff distance from S1 to S2 (see below).
+*/
 template <class MetroMesh>
 class Sampling
 {
@@ -79,8 +97,32 @@ private:
 
 	typedef Point3<typename MetroMesh::ScalarType> Point3x;
 
+    // hierarchy of face clusters of S1 used by the bounded Hausdorff
+    typedef AABBBinaryTree<FaceType, ScalarType, vcg::EmptyClass> ClusterTree;
+    typedef typename ClusterTree::NodeType ClusterNode;
 
+    // a region of S1 (a cluster of faces or a triangle) with an upper bound
+    // of the distance from S2 of all its points
+    struct BoundRegion
+    {
+      double        ub;
+      ClusterNode  *node;  // the cluster, or 0 for a triangle
+      Point3x       v[3];  // the triangle
+      bool operator < (const BoundRegion &r) const { return ub < r.ub; }
+    };
+
+    // partial statistics of a block of elements
+    struct SampleStats
+    {
+      double        max_dist;
+      double        sum_dist;
+      double        sum_sq_dist;
+      unsigned long n_samples;      // samples that found the other mesh
+      unsigned long n_gen_samples;  // generated samples
+      SampleStats() : max_dist(-HUGE_VAL), sum_dist(0), sum_sq_dist(0), n_samples(0), n_gen_samples(0) {}
+    };
 
+    enum { BlockSize = 1024 };
 
     // data structures
     MetroMesh       &S1;
@@ -104,6 +146,8 @@ private:
 	double					n_samples_per_area_unit;
 	unsigned long   n_samples_target;
 	int             Flags;
+	unsigned int    random_seed;
+	FILE           *log_fp;             // where the sampling progress is printed (default stdout)
 
     // results
     Histogram<double>            hist;
@@ -116,28 +160,41 @@ private:
     double          RMS_dist;
     double          volume;
     double          area_S1;
+    double          lower_bound_dist;
+    double          upper_bound_dist;
+    Point3x         worst_point;
 
-    // globals
-    int             n_samples;
+    // per thread histograms
+    std::vector< Histogram<double> > thread_hist;
 
     // private methods
     inline double   ComputeMeshArea(MetroMesh & mesh);
-    float           AddSample(const Point3x &p);
-    inline void     AddRandomSample(FaceIterator &T);
-    inline void     SampleEdge(const Point3x & v0, const Point3x & v1, int n_samples_per_edge);
+    void            SetSearchStructures();
+    double          ClosestDistance(const Point3x &p);
+    float           AddSample(const Point3x &p, SampleStats &st);
+    void            EvalRegion(BoundRegion &r, const Point3x &q, double radius, unsigned long &n_queries);
+    inline void     AddRandomSample(FaceType &f, math::RandomGenerator &rnd, SampleStats &st);
+    inline void     SampleEdge(const Point3x & v0, const Point3x & v1, int n_samples_per_edge, SampleStats &st);
     void            VertexSampling();
     void            EdgeSampling();
-    void            FaceSubdiv(const Point3x & v0, const Point3x &v1, const Point3x & v2, int maxdepth);
-    void            SimilarTriangles(const Point3x &v0, const Point3x &v1, const Point3x &v2, int n_samples_per_edge);
+    void            FaceSubdiv(const Point3x & v0, const Point3x &v1, const Point3x & v2, int maxdepth, SampleStats &st);
+    void            SimilarTriangles(const Point3x &v0, const Point3x &v1, const Point3x &v2, int n_samples_per_edge, SampleStats &st);
     void            MontecarloFaceSampling();
     void            SubdivFaceSampling();
     void            SimilarFaceSampling();
+    static int      SimilarTrianglesSampleNum(int n_samples_per_edge);
+    template <class BlockSampler>
+    void            ParallelSampling(int elem_num, BlockSampler blockSampler, unsigned long &n_total_kind_samples);
 
 public :
     // public methods
     Sampling(MetroMesh &_s1, MetroMesh &_s2);
         ~Sampling();
     void            Hausdorff();
+    void            BoundedHausdorff(double tolerance, double threshold = -1);
+    double          GetDistLowerBound()         {return lower_bound_dist;}
+    double          GetDistUpperBound()         {return upper_bound_dist;}
+    Point3x         GetWorstPoint()             {return worst_point;}
     double          GetArea()                   {return area_S1;}
     double          GetDistMax()                {return max_dist;}
     double          GetDistMean()               {return mean_dist;}
@@ -155,6 +212,8 @@ public :
     void            SetParam(double _n_samp)    {n_samples_target = _n_samp;}
     void            SetSamplesTarget(unsigned long _n_samp);
     void            SetSamplesPerAreaUnit(double _n_samp);
+    void            SetRandomSeed(unsigned int seed) {random_seed = seed;}
+    void            SetLogFile(FILE *fp)        {log_fp = fp;}
 };
 
 // -----------------------------------------------------------------------------------------------
@@ -164,8 +223,12 @@ template <class MetroMesh>
 Sampling<MetroMesh>::Sampling(MetroMesh &_s1, MetroMesh &_s2):S1(_s1),S2(_s2)
 {
     Flags = 0;
+    random_seed = 0;
+    log_fp = stdout;
     area_S1 = ComputeMeshArea(_s1);
         // set default numbers
+        n_samples_target               = 0;
+        n_samples_per_area_unit        = 0;
         n_samples_per_face             =	10;
         n_samples_edge_to_face_ratio   = 0.1f;
         bbox_factor                    = 0.1f;
@@ -221,41 +284,102 @@ inline double Sampling<MetroMesh>::ComputeMeshArea(MetroMesh & mesh)
 	return area/2.0;
 }
 
+// Build the search structure over S2 selected by the flags.
 template <class MetroMesh>
-float Sampling<MetroMesh>::AddSample(const Point3x &p )
+void Sampling<MetroMesh>::SetSearchStructures()
 {
-    FaceType   *f=0;
-    Point3x             normf, bestq, ip;
-        ScalarType              dist;
+    if(Flags & SamplingFlags::USE_HASH_GRID)   hS2.Set(S2.face.begin(),S2.face.end());
+    if(Flags & SamplingFlags::USE_AABB_TREE)   tS2.Set(S2.face.begin(),S2.face.end());
+    if(Flags & SamplingFlags::USE_STATIC_GRID) gS2.Set(S2.face.begin(),S2.face.end());
+    if(Flags & SamplingFlags::USE_OCTREE)      oS2.Set(S2.face.begin(),S2.face.end());
 
-    dist = dist_upper_bound;
+    dist_upper_bound = /*bbox_factor * */S2.bbox.Diag();
+}
 
-    // compute distance between p_i and the mesh S2
+// Return the distance between p and the mesh S2, or -1 if S2 is farther than dist_upper_bound.
+// It can be called concurrently: the search structures are only read and
+// the faces are not marked (the same face can be tested more than once).
+template <class MetroMesh>
+double Sampling<MetroMesh>::ClosestDistance(const Point3x &p)
+{
+    FaceType   *f=0;
+    Point3x     bestq;
+    ScalarType  dist = dist_upper_bound;
+
+    tri::EmptyTMark<MetroMesh> mf;
+    vcg::face::PointDistanceEPFunctor<ScalarType> PDistFunct;
     if(Flags & SamplingFlags::USE_AABB_TREE)
-      f=tri::GetClosestFaceEP<MetroMesh,MetroMeshAABB>(S2, tS2, p, dist_upper_bound, dist, normf, bestq, ip);
+      f=tS2.GetClosest(PDistFunct, mf, p, dist_upper_bound, dist, bestq);
     if(Flags & SamplingFlags::USE_HASH_GRID)
-      f=tri::GetClosestFaceEP<MetroMesh,MetroMeshHash>(S2, hS2, p, dist_upper_bound, dist, normf, bestq, ip);
+      f=hS2.GetClosest(PDistFunct, mf, p, dist_upper_bound, dist, bestq);
     if(Flags & SamplingFlags::USE_STATIC_GRID)
-      f=tri::GetClosestFaceEP<MetroMesh,MetroMeshGrid>(S2, gS2, p, dist_upper_bound, dist, normf, bestq, ip);
+      f=gS2.GetClosest(PDistFunct, mf, p, dist_upper_bound, dist, bestq);
     if (Flags & SamplingFlags::USE_OCTREE)
-      f=tri::GetClosestFaceEP<MetroMesh,MetroMeshOctree>(S2, oS2, p, dist_upper_bound, dist, normf, bestq, ip);
+      f=oS2.GetClosest(PDistFunct, mf, p, dist_upper_bound, dist, bestq);
+
+    if(f==0 || fabs(dist) >= dist_upper_bound)
+        return -1.0;
+    return fabs(dist);
+}
+
+// Compute the distance between p and the mesh S2 and update the statistics.
+template <class MetroMesh>
+float Sampling<MetroMesh>::AddSample(const Point3x &p, SampleStats &st)
+{
+    st.n_gen_samples++;
+
+    // compute distance between p_i and the mesh S2
+    const double dist = ClosestDistance(p);
 
     // update distance measures
-    if(dist == dist_upper_bound)
+    if(dist < 0)
         return -1.0;
 
-    if(dist > max_dist)
-        max_dist = dist;        // L_inf
-    mean_dist += dist;	        // L_1
-    RMS_dist  += dist*dist;     // L_2
-    n_total_samples++;
+    if(dist > st.max_dist)
+        st.max_dist = dist;        // L_inf
+    st.sum_dist    += dist;	       // L_1
+    st.sum_sq_dist += dist*dist;   // L_2
+    st.n_samples++;
 
     if(Flags &  SamplingFlags::HIST)
-        hist.Add((float)fabs(dist));
+    {
+#ifdef _OPENMP
+      thread_hist[omp_get_thread_num()].Add((float)fabs(dist));
+#else
+      thread_hist[0].Add((float)fabs(dist));
+#endif
+    }
 
     return (float)dist;
 }
 
+// Sample the elements [0,elem_num) in blocks; blockSampler(begin,end,blockIndex,stats)
+// samples the elements [begin,end).
+template <class MetroMesh>
+template <class BlockSampler>
+void Sampling<MetroMesh>::ParallelSampling(int elem_num, BlockSampler blockSampler, unsigned long &n_total_kind_samples)
+{
+    const int block_num = (elem_num + BlockSize - 1) / BlockSize;
+    std::vector<SampleStats> block_stats(block_num);
+    const bool parallel = (Flags & SamplingFlags::USE_OCTREE) == 0;
+    (void)parallel;
+
+#pragma omp parallel for schedule(dynamic, 1) if(parallel)
+    for(int b=0; b<block_num; ++b)
+      blockSampler(b*BlockSize, std::min(elem_num, (b+1)*BlockSize), b, block_stats[b]);
+
+    for(int b=0; b<block_num; ++b)
+    {
+      const SampleStats &st = block_stats[b];
+      if(st.max_dist > max_dist)
+        max_dist = st.max_dist;
+      mean_dist            += st.sum_dist;
+      RMS_dist             += st.sum_sq_dist;
+      n_total_samples      += st.n_samples;
+      n_total_kind_samples += st.n_gen_samples;
+    }
+}
+
 
 // -----------------------------------------------------------------------------------------------
 // --- Vertex Sampling ---------------------------------------------------------------------------
@@ -264,28 +388,22 @@ template <class MetroMesh>
 void Sampling<MetroMesh>::VertexSampling()
 {
     // Vertex sampling.
-    int   cnt = 0;
-    float error;
-
-    printf("Vertex sampling\n");
-    VertexIterator vi;
-        typename std::vector<VertexPointer>::iterator vif;
-    for(vi=S1.vert.begin();vi!=S1.vert.end();++vi)
-            if(  (*vi).IsUserBit(referredBit) || // it is referred
-                    ((Flags&SamplingFlags::INCLUDE_UNREFERENCED_VERTICES) != 0) ) //include also unreferred
+    fprintf(log_fp,"Vertex sampling\n");
+    ParallelSampling(int(S1.vert.size()), [&](int begin, int end, int, SampleStats &st)
     {
-        error = AddSample((*vi).cP());
-
-        n_total_vertex_samples++;
-
-        // save vertex quality
-        if(Flags & SamplingFlags::SAVE_ERROR)  (*vi).Q() = error;
+      for(int i=begin; i<end; ++i)
+      {
+        VertexType &v = S1.vert[i];
+        if(  v.IsUserBit(referredBit) || // it is referred
+            ((Flags&SamplingFlags::INCLUDE_UNREFERENCED_VERTICES) != 0) ) //include also unreferred
+        {
+          float error = AddSample(v.cP(), st);
 
-        // print progress information
-        if(!(++cnt % print_every_n_elements))
-            printf("Sampling vertices %d%%\r", (100 * cnt/S1.vn));
-    }
-    printf("                       \r");
+          // save vertex quality
+          if(Flags & SamplingFlags::SAVE_ERROR)  v.Q() = error;
+        }
+      }
+    }, n_total_vertex_samples);
 }
 
 
@@ -293,17 +411,14 @@ void Sampling<MetroMesh>::VertexSampling()
 // --- Edge Sampling -----------------------------------------------------------------------------
 
 template <class MetroMesh>
-inline void Sampling<MetroMesh>::SampleEdge(const Point3x & v0, const Point3x & v1, int n_samples_per_edge)
+inline void Sampling<MetroMesh>::SampleEdge(const Point3x & v0, const Point3x & v1, int n_samples_per_edge, SampleStats &st)
 {
     // uniform sampling of the segment v0v1.
     Point3x     e((v1-v0)/(double)(n_samples_per_edge+1));
     int         i;
 
     for(i=1; i <= n_samples_per_edge; i++)
-    {
-        AddSample(v0 + e*i);
-        n_total_edge_samples++;
-    }
+        AddSample(v0 + e*i, st);
 }
 
 
@@ -314,7 +429,7 @@ void Sampling<MetroMesh>::EdgeSampling()
 		typedef std::pair<VertexPointer, VertexPointer> pvv;
 		std::vector< pvv > Edges;
 
-	printf("Edge sampling\n");
+	fprintf(log_fp,"Edge sampling\n");
 
     // compute edge list.
     FaceIterator fi;
@@ -329,51 +444,50 @@ void Sampling<MetroMesh>::EdgeSampling()
         typename std::vector< pvv>::iterator edgeend = unique(Edges.begin(), Edges.end());
     Edges.resize(edgeend-Edges.begin());
 
-	// sample edges.
-		typename std::vector<pvv>::iterator   ei;
+	// number of samples of each edge.
 	double                  n_samples_per_length_unit;
 	double                  n_samples_decimal = 0.0;
-	int                     cnt=0;
+	std::vector<int>        edge_samples(Edges.size());
 	if(Flags & SamplingFlags::FACE_SAMPLING)
 		n_samples_per_length_unit = sqrt((double)n_samples_per_area_unit);
 	else
 		n_samples_per_length_unit = n_samples_per_area_unit;
-	for(ei=Edges.begin(); ei!=Edges.end(); ++ei)
+	for(size_t i=0; i<Edges.size(); ++i)
 	{
-		n_samples_decimal += Distance((*ei).first->cP(),(*ei).second->cP()) * n_samples_per_length_unit;
-		n_samples          = (int) n_samples_decimal;
-		SampleEdge((*ei).first->cP(), (*ei).second->cP(), (int) n_samples);
-		n_samples_decimal -= (double) n_samples;
-
-        // print progress information
-        if(!(++cnt % print_every_n_elements))
-            printf("Sampling edge %lu%%\r", (100 * cnt/Edges.size()));
-    }
-    printf("                     \r");
+		n_samples_decimal += Distance(Edges[i].first->cP(),Edges[i].second->cP()) * n_samples_per_length_unit;
+		edge_samples[i]    = (int) n_samples_decimal;
+		n_samples_decimal -= (double) edge_samples[i];
+	}
+
+	// sample edges.
+	ParallelSampling(int(Edges.size()), [&](int begin, int end, int, SampleStats &st)
+	{
+		for(int i=begin; i<end; ++i)
+			SampleEdge(Edges[i].first->cP(), Edges[i].second->cP(), edge_samples[i], st);
+	}, n_total_edge_samples);
 }
 
 
 // -----------------------------------------------------------------------------------------------
 // --- Face Sampling -----------------------------------------------------------------------------
 
-// Montecarlo sampling.
 template <class MetroMesh>
-inline void Sampling<MetroMesh>::AddRandomSample(FaceIterator &T)
+inline void Sampling<MetroMesh>::AddRandomSample(FaceType &f, math::RandomGenerator &rnd, SampleStats &st)
 {
     // random sampling over the input face.
     double      rnd_1, rnd_2;
 
     // vertices of the face T.
-    Point3x p0(T->V(0)->cP());
-    Point3x p1(T->V(1)->cP());
-    Point3x p2(T->V(2)->cP());
+    Point3x p0(f.V(0)->cP());
+    Point3x p1(f.V(1)->cP());
+    Point3x p2(f.V(2)->cP());
     // calculate two edges of T.
     Point3x v1(p1 - p0);
     Point3x v2(p2 - p0);
 
     // choose two random numbers.
-    rnd_1 = (double)rand() / (double)RAND_MAX;
-    rnd_2 = (double)rand() / (double)RAND_MAX;
+    rnd_1 = rnd.generate01closed();
+    rnd_2 = rnd.generate01closed();
     if(rnd_1 + rnd_2 > 1.0)
     {
         rnd_1 = 1.0 - rnd_1;
@@ -381,51 +495,47 @@ inline void Sampling<MetroMesh>::AddRandomSample(FaceIterator &T)
     }
 
     // add a random point on the face T.
-    AddSample (p0 + (v1 * rnd_1 + v2 * rnd_2));
-    n_total_area_samples++;
+    AddSample (p0 + (v1 * rnd_1 + v2 * rnd_2), st);
 }
 
+// Montecarlo sampling.
+// Each block of faces has its own random stream, seeded with the random seed and the block index.
 template <class MetroMesh>
 void Sampling<MetroMesh>::MontecarloFaceSampling()
 {
-    // Montecarlo sampling.
     double  n_samples_decimal = 0.0;
-    FaceIterator fi;
+    std::vector<int> face_samples(S1.face.size(),0);
 
-    srand(clock());
  //   printf("Montecarlo face sampling\n");
-    for(fi=S1.face.begin(); fi != S1.face.end(); fi++)
-        if(!(*fi).IsD())
+    for(size_t i=0; i<S1.face.size(); ++i)
+        if(!S1.face[i].IsD())
     {
         // compute # samples in the current face.
-        n_samples_decimal += 0.5*DoubleArea(*fi) * n_samples_per_area_unit;
-        n_samples          = (int) n_samples_decimal;
+        n_samples_decimal += 0.5*DoubleArea(S1.face[i]) * n_samples_per_area_unit;
+        face_samples[i]    = (int) n_samples_decimal;
+        n_samples_decimal -= (double) face_samples[i];
+    }
 
+    ParallelSampling(int(S1.face.size()), [&](int begin, int end, int block, SampleStats &st)
+    {
+        math::MarsenneTwisterRNG rnd(random_seed*2654435761u + unsigned(block));
         // for every sample p_i in T...
-        for(int i=0; i < n_samples; i++)
-            AddRandomSample(fi);
-
-        n_samples_decimal -= (double) n_samples;
-
-        // print progress information
-//        if(!(++cnt % print_every_n_elements))
- //           printf("Sampling face %d%%\r", (100 * cnt/S1.fn));
-    }
- //   printf("                     \r");
+        for(int i=begin; i<end; ++i)
+            for(int k=0; k < face_samples[i]; k++)
+                AddRandomSample(S1.face[i], rnd, st);
+    }, n_total_area_samples);
 }
 
 
 // Subdivision sampling.
 template <class MetroMesh>
-void Sampling<MetroMesh>::FaceSubdiv(const Point3x & v0, const Point3x & v1, const Point3x & v2, int maxdepth)
+void Sampling<MetroMesh>::FaceSubdiv(const Point3x & v0, const Point3x & v1, const Point3x & v2, int maxdepth, SampleStats &st)
 {
     // recursive face subdivision.
     if(maxdepth == 0)
     {
         // ground case.
-        AddSample((v0+v1+v2)/3.0f);
-        n_total_area_samples++;
-        n_samples++;
+        AddSample((v0+v1+v2)/3.0f, st);
         return;
     }
 
@@ -446,16 +556,16 @@ void Sampling<MetroMesh>::FaceSubdiv(const Point3x & v0, const Point3x & v1, con
     switch(res)
     {
      case 0 :    pp = (v0+v1)/2;
-                 FaceSubdiv(v0,pp,v2,maxdepth-1);
-                 FaceSubdiv(pp,v1,v2,maxdepth-1);
+                 FaceSubdiv(v0,pp,v2,maxdepth-1,st);
+                 FaceSubdiv(pp,v1,v2,maxdepth-1,st);
                  break;
      case 1 :    pp = (v1+v2)/2;
-                 FaceSubdiv(v0,v1,pp,maxdepth-1);
-                 FaceSubdiv(v0,pp,v2,maxdepth-1);
+                 FaceSubdiv(v0,v1,pp,maxdepth-1,st);
+                 FaceSubdiv(v0,pp,v2,maxdepth-1,st);
                  break;
      case 2 :    pp = (v2+v0)/2;
-                 FaceSubdiv(v0,v1,pp,maxdepth-1);
-                 FaceSubdiv(pp,v1,v2,maxdepth-1);
+                 FaceSubdiv(v0,v1,pp,maxdepth-1,st);
+                 FaceSubdiv(pp,v1,v2,maxdepth-1,st);
                  break;
     }
 }
@@ -464,36 +574,37 @@ template <class MetroMesh>
 void Sampling<MetroMesh>::SubdivFaceSampling()
 {
     // Subdivision sampling.
-    int     cnt = 0, maxdepth;
+    int     n_samples;
     double  n_samples_decimal = 0.0;
-    typename MetroMesh::FaceIterator fi;
+    std::vector<int> face_depth(S1.face.size(),-1);
 
-    printf("Subdivision face sampling\n");
-    for(fi=S1.face.begin(); fi != S1.face.end(); fi++)
+    fprintf(log_fp,"Subdivision face sampling\n");
+    for(size_t i=0; i<S1.face.size(); ++i)
     {
         // compute # samples in the current face.
-        n_samples_decimal += 0.5*DoubleArea(*fi) * n_samples_per_area_unit;
+        n_samples_decimal += 0.5*DoubleArea(S1.face[i]) * n_samples_per_area_unit;
         n_samples          = (int) n_samples_decimal;
         if(n_samples)
         {
-            // face sampling.
-            maxdepth = ((int)(log((double)n_samples)/log(2.0)));
-            n_samples = 0;
-            FaceSubdiv((*fi).V(0)->cP(), (*fi).V(1)->cP(), (*fi).V(2)->cP(), maxdepth);
+            // face sampling: a subdivision of depth d gives 2^d samples.
+            face_depth[i] = ((int)(log((double)n_samples)/log(2.0)));
+            n_samples = 1<<face_depth[i];
         }
         n_samples_decimal -= (double) n_samples;
-
-        // print progress information
-        if(!(++cnt % print_every_n_elements))
-            printf("Sampling face %d%%\r", (100 * cnt/S1.fn));
     }
-    printf("                     \r");
+
+    ParallelSampling(int(S1.face.size()), [&](int begin, int end, int, SampleStats &st)
+    {
+        for(int i=begin; i<end; ++i)
+            if(face_depth[i]>=0)
+                FaceSubdiv(S1.face[i].V(0)->cP(), S1.face[i].V(1)->cP(), S1.face[i].V(2)->cP(), face_depth[i], st);
+    }, n_total_area_samples);
 }
 
 
 // Similar Triangles sampling.
 template <class MetroMesh>
-void Sampling<MetroMesh>::SimilarTriangles(const Point3x & v0, const Point3x & v1, const Point3x & v2, int n_samples_per_edge)
+void Sampling<MetroMesh>::SimilarTriangles(const Point3x & v0, const Point3x & v1, const Point3x & v2, int n_samples_per_edge, SampleStats &st)
 {
     Point3x     V1((v1-v0)/(double)(n_samples_per_edge-1));
     Point3x     V2((v2-v0)/(double)(n_samples_per_edge-1));
@@ -502,41 +613,46 @@ void Sampling<MetroMesh>::SimilarTriangles(const Point3x & v0, const Point3x & v
     // face sampling.
     for(i=1; i < n_samples_per_edge-1; i++)
         for(j=1; j < n_samples_per_edge-1-i; j++)
-        {
-            AddSample( v0 + (V1*(double)i + V2*(double)j) );
-            n_total_area_samples++;
-            n_samples++;
-        }
+            AddSample( v0 + (V1*(double)i + V2*(double)j), st );
+}
+
+// Number of samples generated by SimilarTriangles
+template <class MetroMesh>
+int Sampling<MetroMesh>::SimilarTrianglesSampleNum(int n_samples_per_edge)
+{
+    const int k = n_samples_per_edge - 3;
+    return (k > 0) ? k*(k+1)/2 : 0;
 }
 
 template <class MetroMesh>
 void Sampling<MetroMesh>::SimilarFaceSampling()
 {
     // Similar Triangles sampling.
-    int     cnt = 0, n_samples_per_edge;
+    int     n_samples;
     double  n_samples_decimal = 0.0;
-    FaceIterator fi;
+    std::vector<int> face_samples_per_edge(S1.face.size(),0);
 
-    printf("Similar Triangles face sampling\n");
-    for(fi=S1.face.begin(); fi != S1.face.end(); fi++)
+    fprintf(log_fp,"Similar Triangles face sampling\n");
+    for(size_t i=0; i<S1.face.size(); ++i)
     {
         // compute # samples in the current face.
-        n_samples_decimal += 0.5*DoubleArea(*fi) * n_samples_per_area_unit;
+        n_samples_decimal += 0.5*DoubleArea(S1.face[i]) * n_samples_per_area_unit;
         n_samples          = (int) n_samples_decimal;
         if(n_samples)
         {
             // face sampling.
-            n_samples_per_edge = (int)((sqrt(1.0+8.0*(double)n_samples) +5.0)/2.0);
-            n_samples = 0;
-            SimilarTriangles((*fi).V(0)->cP(), (*fi).V(1)->cP(), (*fi).V(2)->cP(), n_samples_per_edge);
+            face_samples_per_edge[i] = (int)((sqrt(1.0+8.0*(double)n_samples) +5.0)/2.0);
+            n_samples = SimilarTrianglesSampleNum(face_samples_per_edge[i]);
         }
         n_samples_decimal -= (double) n_samples;
-
-        // print progress information
-        if(!(++cnt % print_every_n_elements))
-            printf("Sampling face %d%%\r", (100 * cnt/S1.fn));
     }
-    printf("                     \r");
+
+    ParallelSampling(int(S1.face.size()), [&](int begin, int end, int, SampleStats &st)
+    {
+        for(int i=begin; i<end; ++i)
+            if(face_samples_per_edge[i])
+                SimilarTriangles(S1.face[i].V(0)->cP(), S1.face[i].V(1)->cP(), S1.face[i].V(2)->cP(), face_samples_per_edge[i], st);
+    }, n_total_area_samples);
 }
 
 
@@ -546,22 +662,20 @@ void Sampling<MetroMesh>::SimilarFaceSampling()
 template <class MetroMesh>
 void Sampling<MetroMesh>::Hausdorff()
 {
-        Box3< ScalarType> bbox;
-
-    // set grid meshes.
-    if(Flags & SamplingFlags::USE_HASH_GRID)   hS2.Set(S2.face.begin(),S2.face.end());
-    if(Flags & SamplingFlags::USE_AABB_TREE)   tS2.Set(S2.face.begin(),S2.face.end());
-    if(Flags & SamplingFlags::USE_STATIC_GRID) gS2.Set(S2.face.begin(),S2.face.end());
-        if(Flags & SamplingFlags::USE_OCTREE)      oS2.Set(S2.face.begin(),S2.face.end());
-
-    // set bounding box
-    bbox = S2.bbox;
-    dist_upper_bound = /*bbox_factor * */bbox.Diag();
+    // set grid meshes and the bounding box.
+    SetSearchStructures();
     if(Flags &  SamplingFlags::HIST)
+    {
         hist.SetRange(0.0, dist_upper_bound/100.0, n_hist_bins);
+#ifdef _OPENMP
+        thread_hist.resize(omp_get_max_threads(), hist);
+#else
+        thread_hist.resize(1, hist);
+#endif
+    }
 
     // initialize sampling statistics.
-    n_total_area_samples = n_total_edge_samples = n_total_vertex_samples = n_total_samples = n_samples = 0;
+    n_total_area_samples = n_total_edge_samples = n_total_vertex_samples = n_total_samples = 0;
         max_dist             = -HUGE_VAL;
         mean_dist = RMS_dist = 0;
 
@@ -589,6 +703,12 @@ void Sampling<MetroMesh>::Hausdorff()
         }
     }
 
+    // merge the per thread histograms
+    if(Flags &  SamplingFlags::HIST)
+      for(size_t i=0; i<thread_hist.size(); ++i)
+        hist.Merge(thread_hist[i]);
+    thread_hist.clear();
+
     // compute vertex colour
     if(Flags & SamplingFlags::SAVE_ERROR)
       vcg::tri::UpdateColor<MetroMesh>::PerVertexQualityRamp(S1);
@@ -599,5 +719,127 @@ void Sampling<MetroMesh>::Hausdorff()
     mean_dist /= n_total_samples;
     RMS_dist   = sqrt(RMS_dist / n_total_samples);
 }
+
+
+// -----------------------------------------------------------------------------------------------
+// --- Bounded Hausdorff -------------------------------------------------------------------------
+
+// Measure the distance from S2 of the point q of the region r; radius is the max distance between
+// q and the points of r. The distance from S2 is 1-Lipschitz, so every point of r is not farther
+// than d(q)+radius from S2, while d(q) is a lower bound of the Hausdorff distance.
+template <class MetroMesh>
+void Sampling<MetroMesh>::EvalRegion(BoundRegion &r, const Point3x &q, double radius, unsigned long &n_queries)
+{
+    double d = ClosestDistance(q);
+    n_queries++;
+    if(d < 0)
+        d = dist_upper_bound;   // out of the search range, as in the sampling it is not measured
+    else if(d > lower_bound_dist)
+    {
+        lower_bound_dist = d;
+        worst_point      = q;
+    }
+    r.ub = d + radius;
+}
+
+/*
+  Adaptive estimation of the one sided Hausdorff distance from S1 to S2 with guaranteed bounds.
+  S1 is covered by regions: the clusters of an AABB tree over its faces, then the single faces,
+  then their 1-to-4 midpoint subdivisions. Each region gets an upper bound of the distance from S2
+  of its points (see EvalRegion). Starting from the whole mesh, the region with the largest upper
+  bound is refined; the regions whose upper bound is below the current lower bound cannot contain
+  the max and are discarded. The refinement stops when the two bounds are closer than tolerance or,
+  if threshold is not negative, as soon as the bounds tell if the distance exceeds threshold.
+  GetDistLowerBound()/GetDistUpperBound() return the bounds, GetWorstPoint() the point of S1 where
+  the lower bound was found; GetNSamples() is the number of distance queries.
+*/
+template <class MetroMesh>
+void Sampling<MetroMesh>::BoundedHausdorff(double tolerance, double threshold)
+{
+    SetSearchStructures();
+
+    // build the face clusters of S1
+    std::vector<FaceType *> faces;
+    for(FaceIterator fi=S1.face.begin(); fi!=S1.face.end(); ++fi)
+        if(!(*fi).IsD())
+            faces.push_back(&*fi);
+    ClusterTree         tree;
+    GetPointerFunctor   getPtr;
+    GetBox3Functor      getBox;
+    GetBarycenter3Functor getBarycenter;
+    tree.Set(faces.begin(), faces.end(), getPtr, getBox, getBarycenter, 8);
+
+    // refining below the precision of the coordinates is useless
+    tolerance = std::max(tolerance, dist_upper_bound*1e-6);
+
+    unsigned long n_queries = 0;
+    lower_bound_dist = 0;
+    worst_point      = Point3x(0,0,0);
+
+    std::priority_queue<BoundRegion> heap;
+    BoundRegion r, c;
+    r.node = tree.pRoot;
+    c.node = 0;
+    if(r.node != 0)
+    {
+        const Point3x q = Barycenter(**(r.node->oBegin + r.node->ObjectsCount()/2));
+        EvalRegion(r, q, (Abs(q - r.node->boxCenter) + r.node->boxHalfDims).Norm(), n_queries);
+        heap.push(r);
+    }
+
+    while(!heap.empty())
+    {
+        r = heap.top();
+        if(r.ub - lower_bound_dist <= tolerance)
+            break;
+        if(threshold >= 0 && (lower_bound_dist > threshold || r.ub <= threshold))
+            break;
+        heap.pop();
+
+        if(r.node != 0 && !r.node->IsLeaf())
+        {
+            // the two sub clusters
+            for(int i=0; i<2; ++i)
+                if((c.node = r.node->children[i]) != 0)
+                {
+                    const Point3x q = Barycenter(**(c.node->oBegin + c.node->ObjectsCount()/2));
+                    EvalRegion(c, q, (Abs(q - c.node->boxCenter) + c.node->boxHalfDims).Norm(), n_queries);
+                    if(c.ub > lower_bound_dist) heap.push(c);
+                }
+            continue;
+        }
+
+        // the triangles to evaluate, three vertices each
+        std::vector<Point3x> tv;
+        if(r.node != 0)
+        {
+            // the faces of a leaf cluster
+            for(typename ClusterTree::ObjPtrVectorIterator oi=r.node->oBegin; oi!=r.node->oEnd; ++oi)
+                for(int j=0; j<3; ++j) tv.push_back((*oi)->cP(j));
+        }
+        else
+        {
+            // the midpoint subdivision of a triangle
+            const Point3x m01 = (r.v[0]+r.v[1])/2.0, m12 = (r.v[1]+r.v[2])/2.0, m20 = (r.v[2]+r.v[0])/2.0;
+            const Point3x sub[12] = { r.v[0], m01, m20,   m01, r.v[1], m12,   m20, m12, r.v[2],   m12, m20, m01 };
+            tv.assign(sub, sub+12);
+        }
+        c.node = 0;
+        for(size_t i=0; i<tv.size(); i+=3)
+        {
+            for(int j=0; j<3; ++j) c.v[j] = tv[i+j];
+            const Point3x q = (c.v[0]+c.v[1]+c.v[2])/3.0;
+            EvalRegion(c, q, std::max(Distance(q,c.v[0]), std::max(Distance(q,c.v[1]), Distance(q,c.v[2]))), n_queries);
+            if(c.ub > lower_bound_dist) heap.push(c);
+        }
+    }
+    upper_bound_dist = heap.empty() ? lower_bound_dist : std::max(lower_bound_dist, heap.top().ub);
+
+    // the dense sampling statistics are not computed
+    n_total_vertex_samples = n_total_edge_samples = 0;
+    n_total_area_samples   = n_total_samples = n_queries;
+    max_dist   = lower_bound_dist;
+    mean_dist  = RMS_dist = volume = 0;
+}
 }
 #endif
@@ -8,3 +8,9 @@ TEMPLATE = app
 SOURCES += ../../wrap/ply/plylib.cpp \
     plymc_main.cpp
 
+# OpenMP, used by the multithreaded options (-P, -T#) and the parallel rasterization
+msvc: QMAKE_CXXFLAGS += /openmp
+else {
+  QMAKE_CXXFLAGS += -fopenmp
+  QMAKE_LFLAGS += -fopenmp
+}
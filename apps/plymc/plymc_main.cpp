@@ -55,6 +55,9 @@ void usage()
       "         is lower than the specified one are smoothed (default 3 voxel)\n"
       " -Q#     Same of above but expressed in absolute units.\n"
       " -p       use vertex splatting instead face rasterizing\n"
+      " -P      use the multithreaded marching cubes extraction\n"
+      " -H      use a sparse volume that keeps in memory only the blocks near the surface\n"
+      " -T#     process up to <n> subvolumes at the same time (default 1, see -S)\n"
       " -d#     set <n> as verbose level (default 0)\n"
       " -D#     save <n> debug slices during processing\n"
 
@@ -102,12 +105,13 @@ void usage()
 
 
 
-int main(int argc, char *argv[])
+template <class PlyMCType>
+int PlyMCMain(int argc, char *argv[])
 {
 
   Histogram<float> h;
-  tri::PlyMC<SMesh,SimpleMeshProvider<SMesh> > pmc;
-  tri::PlyMC<SMesh,SimpleMeshProvider<SMesh> >::Parameter &p = pmc.p;
+  PlyMCType pmc;
+  typename PlyMCType::Parameter &p = pmc.p;
 
 
   // This line is required to be sure that the decimal separatore is ALWAYS the . and not the ,
@@ -193,6 +197,9 @@ int main(int argc, char *argv[])
 	  break;
 	  //        case 'B' :	p.SafeBorder =atoi(argv[i]+2);printf("Setting SafeBorder among blocks to %i*%i (default 1)\n",p.SafeBorder,Volume<Voxelf>::BLOCKSIDE());break;
 	case 'p' :	p.VertSplatFlag =true; printf("Enabling VertexSplatting instead of face rasterization\n");break;
+	case 'P' :	p.ParallelMCFlag =true; printf("Enabling multithreaded marching cubes\n");break;
+	case 'H' :	printf("Using the sparse (hashed blocks) volume\n");break;
+	case 'T' :	p.ParallelSubVolumeNum = atoi(argv[i]+2); printf("Processing up to %i subvolumes at the same time\n",p.ParallelSubVolumeNum);break;
 	case 'd' : p.VerboseLevel=atoi(argv[i]+2);printf("Enabling VerboseLevel= %i )\n",p.VerboseLevel);break;
   case 'D' : p.VerboseLevel=1; p.SliceNum=atoi(argv[i]+2);printf("Enabling Debug Volume saving of %i slices (VerboseLevel=1)\n",p.SliceNum);break;
 	case 'M' :	p.SimplificationFlag =true; printf("Enabling PostReconstruction simplification\n"); break;
@@ -221,3 +228,12 @@ int main(int argc, char *argv[])
 
   return 0;
 }
+
+int main(int argc, char *argv[])
+{
+  // the volume type is a template parameter of PlyMC, so it has to be chosen before parsing the options
+  for(int i=1;i<argc;++i)
+    if(strcmp(argv[i],"-H")==0)
+      return PlyMCMain< tri::PlyMC<SMesh,SimpleMeshProvider<SMesh>,SparseVolume<Voxelfc> > >(argc,argv);
+  return PlyMCMain< tri::PlyMC<SMesh,SimpleMeshProvider<SMesh> > >(argc,argv);
+}
@@ -1,6 +1,7 @@
 
 TEMPLATE      = subdirs
-SUBDIRS       = trimesh_allocate \
+SUBDIRS       = tetramesh_decimation \
+                trimesh_allocate \
                 trimesh_attribute \
                 trimesh_attribute_saving \
                 trimesh_ball_pivoting \
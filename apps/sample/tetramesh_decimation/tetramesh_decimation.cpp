@@ -0,0 +1,153 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+/*! \file tetramesh_decimation.cpp
+\ingroup code_sample
+
+\brief Simplification of a tetrahedral mesh by vertex fusion, serial vs parallel.
+
+The four corners of the tetrahedron stored in the input file (e.g. apps/meshes/Tetraascii.ply)
+are used to build a finely subdivided tetrahedral mesh, that is then simplified
+by the serial and by the parallel (independent set) drivers of tetra::TetFuser.
+*/
+#include <ctime>
+#include <algorithm>
+#include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/tetra/tetfuse_collapse.h>
+#include <wrap/io_trimesh/import_ply.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace vcg;
+using namespace std;
+
+class MyVertex;
+class MyTetra;
+struct MyUsedTypes : public UsedTypes<	Use<MyVertex>::AsVertexType,
+                                        Use<MyTetra>::AsTetraType>{};
+
+class MyVertex : public Vertex<MyUsedTypes, vertex::Coord3f, vertex::VTAdj, vertex::BitFlags>{};
+class MyTetra  : public TetraSimp<MyUsedTypes, tetrahedron::VertexRef, tetrahedron::VTAdj, tetrahedron::TTAdj, tetrahedron::BitFlags>{};
+class MyMesh   : public tri::TriMesh< vector<MyVertex>, vector<MyTetra> >{};
+
+class MyTriVertex;
+class MyTriFace;
+struct MyTriUsedTypes : public UsedTypes<	Use<MyTriVertex>::AsVertexType,
+                                            Use<MyTriFace>::AsFaceType>{};
+class MyTriVertex : public Vertex<MyTriUsedTypes, vertex::Coord3f, vertex::BitFlags>{};
+class MyTriFace   : public Face<MyTriUsedTypes, face::VertexRef, face::BitFlags>{};
+class MyTriMesh   : public tri::TriMesh< vector<MyTriVertex>, vector<MyTriFace> >{};
+
+double WallTime()
+{
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return double(clock())/CLOCKS_PER_SEC;
+#endif
+}
+
+// Fill the tetrahedron c[0..3] with the Freudenthal subdivision of level n
+// (n^3 tetras) and slightly perturb the interior vertices.
+void BuildTetraMesh(MyMesh &m, const Point3f c[4], int n)
+{
+  m.Clear();
+  const int n1=n+1;
+  vector<int> ind(n1*n1*n1,-1);
+  math::MarsenneTwisterRNG rnd(0);
+  // lattice points of the simplex 0<=z<=y<=x<=n
+  for(int i=0;i<=n;++i)
+    for(int j=0;j<=i;++j)
+      for(int k=0;k<=j;++k)
+      {
+        const float x=float(i)/n, y=float(j)/n, z=float(k)/n;
+        Point3f p = c[0]*(1-x) + c[1]*(x-y) + c[2]*(y-z) + c[3]*z;
+        if(k>0 && j>k && i>j && i<n)
+          p += Point3f(rnd.generate01()-0.5f, rnd.generate01()-0.5f, rnd.generate01()-0.5f) * (0.1f*Distance(c[0],c[1])/n);
+        ind[(i*n1+j)*n1+k]=m.vn;
+        tri::Allocator<MyMesh>::AddVertex(m,p);
+      }
+  // each cube is split in six tetras, one for each permutation of the axes;
+  // only the ones inside the simplex are kept
+  int perm[3]={0,1,2};
+  for(int i=0;i<n;++i)
+    for(int j=0;j<=i;++j)
+      for(int k=0;k<=j;++k)
+      {
+        std::sort(perm,perm+3);
+        do {
+          int p[3]={i,j,k};
+          int vi[4];
+          bool inside=true;
+          for(int s=0;s<4 && inside;++s)
+          {
+            if(s>0) ++p[perm[s-1]];
+            inside = p[2]<=p[1] && p[1]<=p[0] && p[0]<=n;
+            if(inside) vi[s]=ind[(p[0]*n1+p[1])*n1+p[2]];
+          }
+          if(!inside) continue;
+          if(tetra::TetFuser<MyMesh>::Quality(m.vert[vi[0]].P(),m.vert[vi[1]].P(),m.vert[vi[2]].P(),m.vert[vi[3]].P())<0)
+            std::swap(vi[0],vi[1]);
+          tri::Allocator<MyMesh>::AddTetra(m,vi[0],vi[1],vi[2],vi[3]);
+        } while(std::next_permutation(perm,perm+3));
+      }
+}
+
+int main( int argc, char **argv )
+{
+  if(argc<2)
+  {
+    printf("Usage tetramesh_decimation <tetra.ply> [subdivision level (default 64)] [target vertex fraction (default 0.1)]\n");
+    return -1;
+  }
+  MyTriMesh tm;
+  if(tri::io::ImporterPLY<MyTriMesh>::Open(tm,argv[1])!=0 || tm.vn<4)
+  {
+    printf("Error reading file %s\n",argv[1]);
+    return -1;
+  }
+  const int n = (argc>2) ? atoi(argv[2]) : 64;
+  const float frac = (argc>3) ? atof(argv[3]) : 0.1f;
+  Point3f c[4];
+  for(int i=0;i<4;++i) c[i]=tm.vert[i].P();
+
+  MyMesh m;
+  BuildTetraMesh(m,c,n);
+  printf("Input mesh: %i vertices %i tetras\n",m.vn,m.tn);
+
+  tetra::TetFuser<MyMesh>::Param pp;
+  pp.TargetVertexNum = int(m.vn*frac);
+
+  double t0=WallTime();
+  int cn = tetra::TetFuser<MyMesh>::FuseSerial(m,pp);
+  double t1=WallTime();
+  printf("Serial   : %8i collapses, %8i vertices %8i tetras in %6.3f sec\n",cn,m.vn,m.tn,t1-t0);
+
+  BuildTetraMesh(m,c,n);
+  t0=WallTime();
+  cn = tetra::TetFuser<MyMesh>::FuseParallel(m,pp);
+  t1=WallTime();
+  printf("Parallel : %8i collapses, %8i vertices %8i tetras in %6.3f sec\n",cn,m.vn,m.tn,t1-t0);
+
+  return 0;
+}
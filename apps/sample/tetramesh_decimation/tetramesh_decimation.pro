@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = tetramesh_decimation
+SOURCES += tetramesh_decimation.cpp ../../../wrap/ply/plylib.cpp
@@ -27,6 +27,10 @@
 
 #include<vcg/complex/algorithms/point_sampling.h>
 #include<vcg/complex/algorithms/clustering.h>
+#include<vcg/space/index/kdtree/kdtree.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace vcg;
 using namespace std;
@@ -43,20 +47,49 @@ class MyFace    : public Face< MyUsedTypes, face::FFAdj,  face::Normal3f, face::
 class MyEdge    : public Edge<MyUsedTypes>{};
 class MyMesh    : public tri::TriMesh< vector<MyVertex>, vector<MyFace> , vector<MyEdge>  > {};
 
+double WallTime()
+{
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return double(clock())/CLOCKS_PER_SEC;
+#endif
+}
+
+// minimum distance between two points of the mesh
+float MinSampleDistance(MyMesh &m)
+{
+  VertexConstDataWrapper<MyMesh> ww(m);
+  KdTree<float> tree(ww);
+  KdTree<float>::PriorityQueue queue;
+  float minDist = std::numeric_limits<float>::max();
+  for (int j = 0; j < m.VN(); j++) {
+    tree.doQueryK(m.vert[j].cP(), 2, queue);
+    for (int i = 0; i < queue.getNofElements(); i++)
+      if(queue.getIndex(i)!=j)
+        minDist = std::min(minDist, Distance(m.vert[j].cP(),m.vert[queue.getIndex(i)].cP()));
+  }
+  return minDist;
+}
+
 int main( int argc, char **argv )
 {
   if(argc<3)
   {
-    printf("Usage trimesh_base <meshfilename> radius (as perc) (\n");
+    printf("Usage trimesh_pointcloud_sampling <meshfilename> radius (as perc of bbox diag) [montecarlo sample num]\n"
+           "If a number of samples is given the surface of the mesh is sampled with the Montecarlo method\n"
+           "and the samples are pruned, otherwise the vertices of the mesh are pruned.\n");
     return -1;
   }
 
   MyMesh m;
   MyMesh subM;
+  MyMesh parM;
   MyMesh cluM;
   MyMesh rndM;
 
   tri::MeshSampler<MyMesh> mps(subM);
+  tri::MeshSampler<MyMesh> mpps(parM);
   tri::MeshSampler<MyMesh> mrs(rndM);
 
   if(tri::io::Importer<MyMesh>::Open(m,argv[1])!=0)
@@ -64,33 +97,49 @@ int main( int argc, char **argv )
     printf("Error reading file  %s\n",argv[1]);
     exit(0);
   }
+  tri::UpdateBounding<MyMesh>::Box(m);
   tri::SurfaceSampling<MyMesh,tri::TrivialSampler<MyMesh> >::SamplingRandomGenerator().initialize(time(0));
   float perc = atof(argv[2]);
-
   float radius = m.bbox.Diag() * perc;
+
+  if(argc>3)
+  {
+    MyMesh mcM;
+    tri::MeshSampler<MyMesh> mcs(mcM);
+    double t=WallTime();
+    tri::SurfaceSampling<MyMesh,tri::MeshSampler<MyMesh> >::Montecarlo(m, mcs, atoi(argv[3]));
+    printf("Generated %i Montecarlo samples in %5.2f\n",mcM.VN(), WallTime()-t);
+    tri::Append<MyMesh,MyMesh>::MeshCopy(m,mcM);
+    tri::UpdateBounding<MyMesh>::Box(m);
+  }
+
   printf("Subsampling a PointCloud of %i vert with %f radius\n",m.VN(),radius);
   tri::SurfaceSampling<MyMesh,tri::MeshSampler<MyMesh> >::PoissonDiskParam pp;
   pp.bestSampleChoiceFlag=false;
+  pp.randomSeed=1;
+  double t=WallTime();
   tri::SurfaceSampling<MyMesh,tri::MeshSampler<MyMesh> >::PoissonDiskPruning(mps, m, radius, pp);
+  printf("Poisson          : sampled %8i vertices in %6.3f sec, min distance %f\n",subM.VN(), WallTime()-t, MinSampleDistance(subM));
   tri::io::ExporterPLY<MyMesh>::Save(subM,"PoissonMesh.ply");
-  printf("Sampled %i vertices in %5.2f\n",subM.VN(), float(pp.pds.pruneTime+pp.pds.gridTime)/float(CLOCKS_PER_SEC));
 
-  int t0=clock();
+  t=WallTime();
+  tri::SurfaceSampling<MyMesh,tri::MeshSampler<MyMesh> >::PoissonDiskPruningParallel(mpps, m, radius, pp);
+  printf("Poisson parallel : sampled %8i vertices in %6.3f sec, min distance %f\n",parM.VN(), WallTime()-t, MinSampleDistance(parM));
+  tri::io::ExporterPLY<MyMesh>::Save(parM,"PoissonMeshParallel.ply");
+
+  t=WallTime();
   tri::Clustering<MyMesh, vcg::tri::AverageColorCell<MyMesh> > ClusteringGrid;
   ClusteringGrid.Init(m.bbox,100000,radius*sqrt(2.0f));
   ClusteringGrid.AddPointSet(m);
   ClusteringGrid.ExtractMesh(cluM);
-  int t1=clock();
+  printf("Clustering       : sampled %8i vertices in %6.3f sec\n",cluM.VN(), WallTime()-t);
   tri::io::ExporterPLY<MyMesh>::Save(cluM,"ClusterMesh.ply");
-  printf("Sampled %i vertices in %5.2f\n",cluM.VN(), float(t1-t0)/float(CLOCKS_PER_SEC));
 
-  int t2=clock();
+  t=WallTime();
   int sampleNum = (cluM.VN()+subM.VN())/2;
   tri::SurfaceSampling<MyMesh,tri::MeshSampler<MyMesh> >::VertexUniform(m, mrs,sampleNum);
-  int t3=clock();
+  printf("Random           : sampled %8i vertices in %6.3f sec\n",rndM.VN(), WallTime()-t);
   tri::io::ExporterPLY<MyMesh>::Save(rndM,"RandomMesh.ply");
-  printf("Sampled %i vertices in %5.2f\n",rndM.VN(), float(t3-t2)/float(CLOCKS_PER_SEC));
-
 
   return 0;
 }
@@ -0,0 +1,184 @@
+// Test for the parallel ball pivoting reconstruction.
+// The vertices of a jittered sphere are reconstructed with BuildMesh and with BuildMeshParallel:
+// the parallel result must be as closed and manifold as the serial one (no holes left along the seams
+// of the slabs), must not depend on the number of threads and must not be slower than the serial one.
+
+// STD headers
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// VCG headers
+#include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/clean.h>
+#include <vcg/complex/algorithms/update/topology.h>
+#include <vcg/complex/algorithms/create/ball_pivoting.h>
+#include <vcg/math/random_generator.h>
+
+using namespace vcg;
+
+class MyFace;
+class MyVertex;
+
+struct MyUsedTypes : public UsedTypes<Use<MyVertex>::AsVertexType, Use<MyFace>::AsFaceType>{};
+
+class MyVertex : public Vertex< MyUsedTypes, vertex::Coord3f, vertex::Normal3f, vertex::BitFlags, vertex::Mark > {};
+class MyFace   : public Face< MyUsedTypes, face::VertexRef, face::Normal3f, face::BitFlags, face::FFAdj > {};
+class MyMesh   : public tri::TriMesh< std::vector<MyVertex>, std::vector<MyFace> > {};
+
+// About 10k points (40k for level 6) on the unit sphere: the vertices of a subdivided icosahedron
+// moved randomly by a fraction of the edge length and projected back on the sphere.
+void BuildJitteredSphere(MyMesh &m, unsigned int seed, int level=5)
+{
+  tri::Sphere(m,level);
+  math::MarsenneTwisterRNG rnd(seed);
+  const float jitter = 0.2f * 2.0f*float(M_PI)/float(5<<level);
+  for(size_t i=0;i<m.vert.size();++i)
+  {
+    Point3f d(rnd.generate01()-0.5f, rnd.generate01()-0.5f, rnd.generate01()-0.5f);
+    m.vert[i].P() = (m.vert[i].P() + d*jitter).Normalize();
+  }
+  m.face.clear();
+  m.fn=0;
+  tri::UpdateBounding<MyMesh>::Box(m);
+}
+
+// Removes the points within 0.1 from holeNum random points of the sphere, so that the surface has real borders.
+void PunchHoles(MyMesh &m, int holeNum, unsigned int seed)
+{
+  math::MarsenneTwisterRNG rnd(seed);
+  std::vector<Point3f> center;
+  for(int i=0;i<holeNum;++i)
+    center.push_back(m.vert[rnd.generate(m.vert.size())].P());
+  for(size_t i=0;i<m.vert.size();++i)
+    for(size_t j=0;j<center.size();++j)
+      if(!m.vert[i].IsD() && Distance(m.vert[i].P(),center[j])<0.1f)
+        tri::Allocator<MyMesh>::DeleteVertex(m,m.vert[i]);
+  tri::Allocator<MyMesh>::CompactVertexVector(m);
+}
+
+struct Stats
+{
+  int fn, borderEdge, nonManifEdge, nonManifVert;
+  double time; // seconds spent in the reconstruction
+};
+
+Stats Reconstruct(MyMesh &m, int regionNum)
+{
+  const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  tri::BallPivoting<MyMesh> pivot(m, 0, 0.2f);
+  if(regionNum<0) pivot.BuildMesh();
+  else            pivot.BuildMeshParallel(NULL,regionNum);
+  Stats s;
+  s.time = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+  tri::UpdateTopology<MyMesh>::FaceFace(m);
+  s.fn = m.fn;
+  s.borderEdge = 0;
+  for(size_t i=0;i<m.face.size();++i)
+    for(int k=0;k<3;++k)
+      if(face::IsBorder(m.face[i],k)) s.borderEdge++;
+  s.nonManifEdge = tri::Clean<MyMesh>::CountNonManifoldEdgeFF(m);
+  s.nonManifVert = tri::Clean<MyMesh>::CountNonManifoldVertexFF(m,false);
+  return s;
+}
+
+bool SameFaces(MyMesh &m0, MyMesh &m1)
+{
+  if(m0.face.size()!=m1.face.size()) return false;
+  for(size_t i=0;i<m0.face.size();++i)
+    for(int k=0;k<3;++k)
+      if(tri::Index(m0,m0.face[i].V(k))!=tri::Index(m1,m1.face[i].V(k))) return false;
+  return true;
+}
+
+int main()
+{
+  bool ok = true;
+
+  // TEST 1 - THE SEAMS OF THE SLABS ARE CLOSED AS THE REST OF THE SURFACE
+  ///////////////////////////////////////////////////////////////////////////////
+  for(unsigned int seed=1;seed<=3;++seed)
+  {
+    MyMesh ms;
+    BuildJitteredSphere(ms,seed);
+    const Stats serial = Reconstruct(ms,-1);
+    const int regionNum[4] = {0,2,3,4};
+    for(int r=0;r<4;++r)
+    {
+      MyMesh mp;
+      BuildJitteredSphere(mp,seed);
+      const Stats par = Reconstruct(mp,regionNum[r]);
+      printf("seed %u regions %i: fn %i (serial %i) border edges %i (%i) non manifold vertices %i (%i)\n",
+             seed,regionNum[r],par.fn,serial.fn,par.borderEdge,serial.borderEdge,par.nonManifVert,serial.nonManifVert);
+      // BuildMesh itself leaves, depending on the order of the front, a few small holes around single points:
+      // allow a couple of them, the unclosed seams were long strips of holes and pinched vertices
+      if(par.borderEdge>serial.borderEdge+12 || par.nonManifVert>serial.nonManifVert || par.nonManifEdge>serial.nonManifEdge)
+        ok=false;
+    }
+  }
+
+  // TEST 2 - THE RESULT DOES NOT DEPEND ON THE NUMBER OF THREADS
+  ///////////////////////////////////////////////////////////////////////////////
+#ifdef _OPENMP
+  {
+    const int maxThreads = omp_get_max_threads();
+    MyMesh m1,m4;
+    BuildJitteredSphere(m1,1);
+    BuildJitteredSphere(m4,1);
+    omp_set_num_threads(1);
+    Reconstruct(m1,0);
+    omp_set_num_threads(4);
+    Reconstruct(m4,0);
+    omp_set_num_threads(maxThreads);
+    if(!SameFaces(m1,m4))
+    {
+      printf("the result changes with the number of threads\n");
+      ok=false;
+    }
+  }
+#endif
+
+  // TEST 3 - THE PARALLEL RECONSTRUCTION IS NOT SLOWER THAN THE SERIAL ONE
+  ///////////////////////////////////////////////////////////////////////////////
+  // On 40k points with 20 holes crossing the slabs and their seams, where the default splits the cloud in 4 slabs.
+  // Each time is the best of 3 runs. With less than 4 threads (or cores) the slabs cost as much as the serial reconstruction
+  // and the seams come on top of it: only a bound is checked there (pivoting again the whole mesh and all the
+  // borders of the holes at each seam was more than 3 times slower).
+  {
+    Stats serial = {0,0,0,0,1e10}, par = serial;
+    for(int run=0;run<3;++run)
+    {
+      MyMesh ms,mp;
+      BuildJitteredSphere(ms,1,6);
+      BuildJitteredSphere(mp,1,6);
+      PunchHoles(ms,20,1);
+      PunchHoles(mp,20,1);
+      const Stats s = Reconstruct(ms,-1);
+      const Stats p = Reconstruct(mp,0);
+      if(s.time<serial.time) serial=s;
+      if(p.time<par.time) par=p;
+    }
+    int threadNum = 1;
+#ifdef _OPENMP
+    threadNum = std::min(omp_get_max_threads(),omp_get_num_procs());
+#endif
+    printf("40k points with holes, %i threads: parallel %.3fs serial %.3fs, border edges %i (%i) non manifold vertices %i (%i)\n",
+           threadNum,par.time,serial.time,par.borderEdge,serial.borderEdge,par.nonManifVert,serial.nonManifVert);
+    if(par.borderEdge>serial.borderEdge+12 || par.nonManifVert>serial.nonManifVert || par.nonManifEdge>serial.nonManifEdge)
+      ok=false;
+    if(par.time > (threadNum>=4 ? 1.0 : 2.5)*serial.time)
+    {
+      printf("the parallel reconstruction is too slow\n");
+      ok=false;
+    }
+  }
+
+  printf(ok ? "All tests passed\n" : "Some tests FAILED\n");
+  return ok ? 0 : 1;
+}
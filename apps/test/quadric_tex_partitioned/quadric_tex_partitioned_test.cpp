@@ -0,0 +1,176 @@
+// Test for the partitioned (multi threaded) texture aware quadric simplification.
+// A displaced textured grid with a seam in the parametrization is simplified
+// with QuadricTexPartitionedDecimation, both alone and as concurrent sessions,
+// checking the face count, the validity of the result, that the seams between the slabs
+// are simplified as much as the rest of the mesh and that no user bit is leaked.
+
+// STD headers
+#include <cstdio>
+#include <cmath>
+#include <vector>
+
+// VCG headers
+#include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/create/platonic.h>
+#include <vcg/complex/algorithms/clean.h>
+#include <vcg/complex/algorithms/stat.h>
+#include <vcg/complex/algorithms/local_optimization.h>
+#include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric_tex.h>
+
+using namespace vcg;
+using namespace tri;
+
+class MyVertex;
+class MyEdge;
+class MyFace;
+
+struct MyUsedTypes: public UsedTypes<Use<MyVertex>::AsVertexType, Use<MyEdge>::AsEdgeType, Use<MyFace>::AsFaceType>{};
+
+class MyVertex : public Vertex< MyUsedTypes, vertex::VFAdj, vertex::Coord3f, vertex::Normal3f, vertex::Mark, vertex::BitFlags > {};
+class MyEdge   : public Edge< MyUsedTypes> {};
+class MyFace   : public Face< MyUsedTypes, face::VFAdj, face::FFAdj, face::VertexRef, face::Normal3f, face::BitFlags, face::WedgeTexCoord2f > {};
+class MyMesh   : public vcg::tri::TriMesh<std::vector<MyVertex>, std::vector<MyFace> > {};
+
+typedef BasicVertexPair<MyVertex> VertexPair;
+
+class MyTriEdgeCollapseQTex: public TriEdgeCollapseQuadricTex< MyMesh, VertexPair, MyTriEdgeCollapseQTex, QuadricTexPoolHelper<MyMesh> > {
+public:
+  typedef  TriEdgeCollapseQuadricTex< MyMesh, VertexPair, MyTriEdgeCollapseQTex, QuadricTexPoolHelper<MyMesh> > TECQ;
+  inline MyTriEdgeCollapseQTex( const VertexPair &p, int i, BaseParameterClass *pp) :TECQ(p,i,pp){}
+};
+
+typedef QuadricTexPartitionedDecimation<MyMesh,MyTriEdgeCollapseQTex> PartitionedDecimation;
+
+// A wavy grid; the wedge texcoords of the right half are moved in a separate atlas region
+// so that the vertices along the middle column carry two different texcoords.
+void BuildTexturedGrid(MyMesh &m, int n, float phase)
+{
+  std::vector<float> z(n*n);
+  for(int i=0;i<n;++i)
+    for(int j=0;j<n;++j)
+      z[i*n+j] = 0.05f*std::sin(12.0f*j/n+phase)*std::cos(9.0f*i/n);
+  tri::Grid(m,n,n,1.0f,1.0f,&z[0]);
+  for(size_t i=0;i<m.face.size();++i)
+  {
+    const bool right = Barycenter(m.face[i])[0] > 0.5f;
+    for(int j=0;j<3;++j)
+    {
+      m.face[i].WT(j).U() = m.face[i].V(j)->P()[0]*0.5f + (right ? 0.5f : 0.0f);
+      m.face[i].WT(j).V() = m.face[i].V(j)->P()[1];
+      m.face[i].WT(j).N() = 0;
+    }
+  }
+  tri::UpdateBounding<MyMesh>::Box(m);
+  tri::UpdateNormal<MyMesh>::PerFace(m);
+}
+
+bool CheckResult(MyMesh &m, int targetFaceNum, const char *name)
+{
+  // the last collapse can remove two faces
+  if(m.fn>targetFaceNum || m.fn<targetFaceNum-1)
+  {
+    printf("%s: expected %i faces, got %i\n",name,targetFaceNum,m.fn);
+    return false;
+  }
+  for(MyMesh::VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+    if(!vi->IsD())
+      for(int k=0;k<3;++k)
+        if(!std::isfinite(vi->P()[k]))
+        {
+          printf("%s: non finite vertex coord\n",name);
+          return false;
+        }
+  for(MyMesh::FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
+    if(!fi->IsD())
+      for(int j=0;j<3;++j)
+        if(!std::isfinite(fi->WT(j).U()) || !std::isfinite(fi->WT(j).V()))
+        {
+          printf("%s: non finite texcoord\n",name);
+          return false;
+        }
+  tri::UpdateTopology<MyMesh>::FaceFace(m);
+  int nonManifEdge = tri::Clean<MyMesh>::CountNonManifoldEdgeFF(m);
+  if(nonManifEdge>0)
+  {
+    printf("%s: %i non manifold edges\n",name,nonManifEdge);
+    return false;
+  }
+  return true;
+}
+
+// Number of edges shorter than half the side of an equilateral triangle
+// with the mean area of a face of a mesh of the same surface and targetFaceNum faces.
+int CountShortEdges(MyMesh &m, double area, int targetFaceNum)
+{
+  const double len = 0.5*std::sqrt(4.0*area/(std::sqrt(3.0)*targetFaceNum));
+  tri::UpdateTopology<MyMesh>::FaceFace(m);
+  int cnt=0;
+  for(MyMesh::FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
+    if(!fi->IsD())
+      for(int j=0;j<3;++j)
+        if((fi->FFp(j)<&*fi || face::IsBorder(*fi,j)) && Distance(fi->P0(j),fi->P1(j))<len)
+          ++cnt;
+  return cnt;
+}
+
+int main()
+{
+  const int firstUnusedBit = MyVertex::FirstUnusedBitFlag();
+  tri::TriEdgeCollapseQuadricTexParameter pp;
+  pp.SetDefaultParams();
+  pp.PreserveBoundary = true;
+  bool ok = true;
+
+  // TEST 1 - A SINGLE SESSION SPLIT IN SEVERAL SLABS
+  ///////////////////////////////////////////////////////////////////////////////
+  {
+    MyMesh m, ms;
+    BuildTexturedGrid(m,120,0.0f);
+    BuildTexturedGrid(ms,120,0.0f);
+    const int target = m.fn/8;
+    const double area = tri::Stat<MyMesh>::ComputeMeshArea(m);
+    PartitionedDecimation::Do(m,target,pp,6);
+    if(!CheckResult(m,target,"partitioned")) ok=false;
+
+    // the seams left by the slabs must not keep the input resolution:
+    // compare the short edges with the ones of a serial simplification
+    PartitionedDecimation::SerialDecimation(ms,target,pp);
+    const int shortEdge = CountShortEdges(m,area,target);
+    const int serialShortEdge = CountShortEdges(ms,area,target);
+    if(2*shortEdge > 3*serialShortEdge)
+    {
+      printf("partitioned: %i short edges, %i with the serial simplification\n",shortEdge,serialShortEdge);
+      ok=false;
+    }
+  }
+
+  // TEST 2 - CONCURRENT PARTITIONED SESSIONS ON DIFFERENT MESHES
+  ///////////////////////////////////////////////////////////////////////////////
+  {
+    const int meshNum = 4;
+    std::vector<MyMesh> meshVec(meshNum);
+    std::vector<int> target(meshNum);
+    for(int i=0;i<meshNum;++i)
+    {
+      BuildTexturedGrid(meshVec[i],80,float(i));
+      target[i] = meshVec[i].fn/(4+i);
+    }
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int i=0;i<meshNum;++i)
+    {
+      tri::TriEdgeCollapseQuadricTexParameter lpp = pp;
+      PartitionedDecimation::Do(meshVec[i],target[i],lpp,3);
+    }
+    for(int i=0;i<meshNum;++i)
+      if(!CheckResult(meshVec[i],target[i],"concurrent")) ok=false;
+  }
+
+  if(MyVertex::FirstUnusedBitFlag()!=firstUnusedBit)
+  {
+    printf("user bit flags leaked by the simplification\n");
+    ok=false;
+  }
+
+  printf(ok ? "All tests passed\n" : "Some tests FAILED\n");
+  return ok ? 0 : 1;
+}
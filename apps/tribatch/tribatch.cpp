@@ -0,0 +1,513 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+// standard libraries
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// stuff to define the mesh
+#include <vcg/complex/complex.h>
+#include <vcg/simplex/face/component_ep.h>
+#include <vcg/complex/algorithms/update/component_ep.h>
+#include <vcg/complex/algorithms/update/bounding.h>
+#include <vcg/complex/algorithms/clean.h>
+
+// io
+#include <wrap/io_trimesh/import.h>
+#include <wrap/io_trimesh/export.h>
+
+// local optimization
+#include <vcg/complex/algorithms/local_optimization.h>
+#include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric.h>
+
+// metro
+#include "../metro/sampling.h"
+
+using namespace vcg;
+using namespace tri;
+
+/**********************************************************
+tribatch: batch version of tridecimator + metro.
+
+Each input mesh (tile) goes through the stages
+  import -> clean -> simplify -> metro -> export
+A reader thread loads the tiles, a bounded pool of workers does
+the cleaning, the simplification and the metro comparison, and a
+writer thread saves the results, so that the I/O of the next tiles
+overlaps with the processing of the current ones.
+The queues between the stages are bounded, so at most about three
+times the number of workers tiles are kept in memory.
+
+At the end a JSON summary with the per tile and per stage timings
+is written.
+******************************************************/
+
+class MyVertex;
+class MyEdge;
+class MyFace;
+
+struct MyUsedTypes: public UsedTypes<Use<MyVertex>::AsVertexType,Use<MyEdge>::AsEdgeType,Use<MyFace>::AsFaceType>{};
+
+class MyVertex  : public Vertex< MyUsedTypes,
+    vertex::VFAdj,
+    vertex::Coord3f,
+    vertex::Normal3f,
+    vertex::Mark,
+    vertex::Qualityf,
+    vertex::Color4b,
+    vertex::BitFlags  >{
+public:
+  vcg::math::Quadric<double> &Qd() {return q;}
+private:
+  math::Quadric<double> q;
+  };
+
+class MyEdge : public Edge< MyUsedTypes> {};
+
+typedef BasicVertexPair<MyVertex> VertexPair;
+
+class MyFace    : public Face< MyUsedTypes,
+  face::VFAdj,
+  face::VertexRef,
+  face::Normal3f,
+  face::EdgePlane,
+  face::Mark,
+  face::BitFlags > {};
+
+class MyMesh    : public vcg::tri::TriMesh<std::vector<MyVertex>, std::vector<MyFace> > {};
+
+class MyTriEdgeCollapse: public vcg::tri::TriEdgeCollapseQuadric< MyMesh, VertexPair, MyTriEdgeCollapse, QInfoStandard<MyVertex>  > {
+            public:
+            typedef  vcg::tri::TriEdgeCollapseQuadric< MyMesh,  VertexPair, MyTriEdgeCollapse, QInfoStandard<MyVertex>  > TECQ;
+            typedef  MyMesh::VertexType::EdgeType EdgeType;
+            inline MyTriEdgeCollapse(  const VertexPair &p, int i, BaseParameterClass *pp) :TECQ(p,i,pp){}
+};
+
+////////////////// Stages, tiles and queues
+
+enum Stage { ST_IMPORT=0, ST_CLEAN, ST_SIMPLIFY, ST_METRO, ST_EXPORT, ST_NUM };
+const char *StageName[ST_NUM] = { "import", "clean", "simplify", "metro", "export" };
+
+typedef std::chrono::steady_clock BatchClock;
+
+double Elapsed(const BatchClock::time_point &t0)
+{
+  return std::chrono::duration<double>(BatchClock::now()-t0).count();
+}
+
+struct Tile
+{
+  int index;
+  std::string inName, outName;
+  std::string error;
+  MyMesh m;
+  int vnIn=0, fnIn=0, vnOut=0, fnOut=0;
+  int removedDup=0, removedUnref=0;
+  double quadricError=0;
+  double distForward=-1, distBackward=-1, distMean=-1, distRMS=-1, bboxDiag=0;
+  double time[ST_NUM] = {0,0,0,0,0};
+};
+
+typedef std::unique_ptr<Tile> TilePtr;
+
+/// A simple bounded blocking FIFO queue between two stages of the pipeline.
+template <class T>
+class BoundedQueue
+{
+public:
+  explicit BoundedQueue(size_t capacity) : cap(std::max<size_t>(capacity,1)), closed(false) {}
+
+  /// Block while the queue is full
+  void Push(T &&v)
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    notFull.wait(lock,[this]{ return q.size()<cap; });
+    q.push_back(std::move(v));
+    notEmpty.notify_one();
+  }
+
+  /// Block while the queue is empty; return false when the queue is empty and closed
+  bool Pop(T &v)
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    notEmpty.wait(lock,[this]{ return !q.empty() || closed; });
+    if(q.empty()) return false;
+    v = std::move(q.front());
+    q.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+
+  /// No more elements will be pushed
+  void Close()
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    closed=true;
+    notEmpty.notify_all();
+  }
+
+private:
+  std::mutex mtx;
+  std::condition_variable notFull, notEmpty;
+  std::deque<T> q;
+  size_t cap;
+  bool closed;
+};
+
+////////////////// Command line parameters
+
+struct BatchParam
+{
+  TriEdgeCollapseQuadricParameter qparams;
+  int    TargetFaceNum = 0;     // absolute target, if not zero
+  double TargetRatio   = 0.5;   // otherwise the fraction of the input faces
+  double TargetError   = std::numeric_limits<double>::max();
+  bool   CleaningFlag  = false;
+  bool   MetroFlag     = false;
+  int    MetroSamplesPerFace = 10;
+  int    ThreadNum     = 0;
+  std::string OutDir;
+  std::string OutExt;           // empty: keep the input extension
+  std::string SummaryName;      // empty: outDir/tribatch_summary.json, '-': stdout
+};
+
+void Usage()
+{
+    printf(
+          "---------------------------------\n"
+          "        TriBatch 1.0 \n"
+          "     http://vcg.isti.cnr.it\n"
+          "   release date: " __DATE__
+          "\n---------------------------------\n\n"
+          "Copyright 2003-2016 Visual Computing Lab I.S.T.I. C.N.R.\n"
+          "\nUsage:  "\
+          "tribatch outDir fileIn1 [fileIn2 ...] [opt]\n"\
+          "Each input mesh is (optionally) cleaned, simplified, compared with metro\n"\
+          "and saved in outDir with the same name.\n"\
+          "Where opt can be:\n"\
+          "     -f# Target face number (default: use the ratio)\n"
+          "     -r# Target ratio of the input faces (default .5)\n"
+          "     -e# QuadricError threshold  (range [0,inf) default inf)\n"
+          "     -q# Quality threshold (range [0.0, 0.866],  default .3 )\n"
+          "     -B[y|n]  Preserve or not mesh boundary (default no)\n"
+          "     -T[y|n]  Preserve or not Topology (default no)\n"
+          "     -O[y|n]  Use or not vertex optimal placement (default yes)\n"
+          "     -C       Before simplification, remove duplicate & unreferenced vertices\n"
+          "     -M       Compute the Hausdorff distance between input and simplified mesh\n"
+          "     -s#      Number of metro samples per face (default 10)\n"
+          "     -t#      Number of worker threads (default: number of cores)\n"
+          "     -x<ext>  Extension (ply, off, obj, stl) of the saved meshes (default: the input one)\n"
+          "     -j<file> Write the JSON summary to file ('-' for stdout, default: outDir/tribatch_summary.json)\n"
+          );
+  exit(-1);
+}
+
+std::string BaseName(const std::string &name)
+{
+  size_t pos=name.find_last_of("/\\");
+  return (pos==std::string::npos) ? name : name.substr(pos+1);
+}
+
+std::string OutputName(const std::string &inName, const BatchParam &bp)
+{
+  std::string base=BaseName(inName);
+  if(!bp.OutExt.empty())
+    base = base.substr(0,base.find_last_of('.'))+"."+bp.OutExt;
+  return bp.OutDir+"/"+base;
+}
+
+std::string JSONString(const std::string &s)
+{
+  std::string r="\"";
+  for(size_t i=0;i<s.size();++i)
+  {
+    const char c=s[i];
+    if(c=='"' || c=='\\') { r+='\\'; r+=c; }
+    else if(c=='\n') r+="\\n";
+    else if((unsigned char)c<0x20) r+=' ';
+    else r+=c;
+  }
+  return r+"\"";
+}
+
+// JSON has no inf or nan: the non finite values are written as null
+std::string JSONNumber(double v)
+{
+  if(!std::isfinite(v)) return "null";
+  char buf[32];
+  snprintf(buf,sizeof(buf),"%g",v);
+  return buf;
+}
+
+////////////////// Stages
+
+// The Sampling class allocates a per vertex user bit, and user bits must be
+// released in stack order: the metro stages of different tiles are therefore serialized.
+// The sampling itself is the only part of the pipeline that is not overlapped.
+// The simplification sessions allocate no user bit (FaceBorderFromVF counts the border
+// parity without them), so they run concurrently.
+std::mutex MetroMutex;
+
+void CleanTile(Tile &t)
+{
+  t.removedDup = tri::Clean<MyMesh>::RemoveDuplicateVertex(t.m);
+  t.removedUnref = tri::Clean<MyMesh>::RemoveUnreferencedVertex(t.m);
+}
+
+void SimplifyTile(Tile &t, const BatchParam &bp)
+{
+  TriEdgeCollapseQuadricParameter qparams = bp.qparams;
+  const int FinalSize = bp.TargetFaceNum>0 ? bp.TargetFaceNum : int(t.m.fn*bp.TargetRatio);
+  vcg::tri::UpdateBounding<MyMesh>::Box(t.m);
+
+  vcg::LocalOptimization<MyMesh> DeciSession(t.m,&qparams);
+  DeciSession.Init<MyTriEdgeCollapse>();
+  DeciSession.SetTargetSimplices(FinalSize);
+  DeciSession.SetTimeBudget(0.5f);
+  if(bp.TargetError< std::numeric_limits<float>::max() ) DeciSession.SetTargetMetric(bp.TargetError);
+  while(DeciSession.DoOptimization() && t.m.fn>FinalSize && DeciSession.currMetric < bp.TargetError)
+    ;
+  t.quadricError = DeciSession.currMetric;
+  DeciSession.Finalize<MyTriEdgeCollapse>();
+  tri::Allocator<MyMesh>::CompactEveryVector(t.m);
+}
+
+// Symmetric Hausdorff distance as computed by metro with its default settings
+// (vertex, edge and similar triangles sampling, uniform grid).
+// The reported time does not include the wait for the other metro stages.
+void MetroTile(Tile &t, MyMesh &orig, const BatchParam &bp)
+{
+  BatchClock::time_point t0=BatchClock::now();
+  MyMesh &S1=orig;
+  MyMesh &S2=t.m;
+  const int flags = SamplingFlags::VERTEX_SAMPLING | SamplingFlags::EDGE_SAMPLING |
+                    SamplingFlags::FACE_SAMPLING | SamplingFlags::SIMILAR_SAMPLING |
+                    SamplingFlags::USE_STATIC_GRID;
+  const unsigned long n_samples_target = bp.MetroSamplesPerFace * std::max(S1.fn,S2.fn);
+
+  tri::UpdateComponentEP<MyMesh>::Set(S1);
+  tri::UpdateComponentEP<MyMesh>::Set(S2);
+  tri::UpdateBounding<MyMesh>::Box(S1);
+  tri::UpdateBounding<MyMesh>::Box(S2);
+  Box3<MyMesh::ScalarType> bbox;
+  bbox.Add(S1.bbox);
+  bbox.Add(S2.bbox);
+  t.bboxDiag = bbox.Diag();
+  bbox.Offset(bbox.Diag()*0.02);
+  S1.bbox = bbox;
+  S2.bbox = bbox;
+
+  double prepTime=Elapsed(t0);
+  std::lock_guard<std::mutex> lock(MetroMutex);
+  t0=BatchClock::now();
+  Sampling<MyMesh> ForwardSampling(S1,S2);
+  Sampling<MyMesh> BackwardSampling(S2,S1);
+  // the progress goes to stderr, stdout may hold the JSON summary
+  ForwardSampling.SetLogFile(stderr);
+  BackwardSampling.SetLogFile(stderr);
+  ForwardSampling.SetFlags(flags);
+  ForwardSampling.SetSamplesTarget(n_samples_target);
+  ForwardSampling.Hausdorff();
+  BackwardSampling.SetFlags(flags);
+  BackwardSampling.SetSamplesTarget(n_samples_target);
+  BackwardSampling.Hausdorff();
+  t.distForward  = ForwardSampling.GetDistMax();
+  t.distBackward = BackwardSampling.GetDistMax();
+  t.distMean     = ForwardSampling.GetDistMean();
+  t.distRMS      = ForwardSampling.GetDistRMS();
+  t.time[ST_METRO] = prepTime+Elapsed(t0);
+}
+
+void ProcessTile(Tile &t, const BatchParam &bp)
+{
+  BatchClock::time_point t0=BatchClock::now();
+  if(bp.CleaningFlag) CleanTile(t);
+  t.time[ST_CLEAN]=Elapsed(t0);
+
+  MyMesh orig;
+  if(bp.MetroFlag)
+  {
+    tri::Allocator<MyMesh>::CompactEveryVector(t.m);
+    tri::Append<MyMesh,MyMesh>::MeshCopy(orig,t.m);
+  }
+  t0=BatchClock::now();
+  SimplifyTile(t,bp);
+  t.time[ST_SIMPLIFY]=Elapsed(t0);
+  t.vnOut=t.m.vn;
+  t.fnOut=t.m.fn;
+
+  if(bp.MetroFlag)
+    MetroTile(t,orig,bp);
+}
+
+void WriteSummary(FILE *fp, const std::vector<TilePtr> &tileVec, const BatchParam &bp, int threadNum, double totalTime)
+{
+  double stageTot[ST_NUM]={0,0,0,0,0};
+  int failed=0;
+  fprintf(fp,"{\n  \"threads\": %i,\n  \"wall_time\": %f,\n  \"tiles\": [\n",threadNum,totalTime);
+  for(size_t i=0;i<tileVec.size();++i)
+  {
+    const Tile &t=*tileVec[i];
+    fprintf(fp,"    {\"input\": %s, \"output\": %s, \"ok\": %s",
+            JSONString(t.inName).c_str(),JSONString(t.outName).c_str(),t.error.empty()?"true":"false");
+    if(!t.error.empty()) { fprintf(fp,", \"error\": %s",JSONString(t.error).c_str()); ++failed; }
+    fprintf(fp,", \"vn_in\": %i, \"fn_in\": %i, \"vn_out\": %i, \"fn_out\": %i",t.vnIn,t.fnIn,t.vnOut,t.fnOut);
+    if(bp.CleaningFlag) fprintf(fp,", \"removed_duplicate\": %i, \"removed_unreferenced\": %i",t.removedDup,t.removedUnref);
+    fprintf(fp,", \"quadric_error\": %s",JSONNumber(t.quadricError).c_str());
+    if(bp.MetroFlag && t.distForward>=0)
+      fprintf(fp,", \"hausdorff\": %s, \"hausdorff_forward\": %s, \"hausdorff_backward\": %s, \"mean\": %s, \"rms\": %s, \"bbox_diag\": %s",
+              JSONNumber(std::max(t.distForward,t.distBackward)).c_str(),JSONNumber(t.distForward).c_str(),JSONNumber(t.distBackward).c_str(),
+              JSONNumber(t.distMean).c_str(),JSONNumber(t.distRMS).c_str(),JSONNumber(t.bboxDiag).c_str());
+    fprintf(fp,", \"time\": {");
+    for(int s=0;s<ST_NUM;++s)
+    {
+      fprintf(fp,"%s\"%s\": %f",s?", ":"",StageName[s],t.time[s]);
+      stageTot[s]+=t.time[s];
+    }
+    fprintf(fp,"}}%s\n",i+1<tileVec.size()?",":"");
+  }
+  fprintf(fp,"  ],\n  \"failed\": %i,\n  \"stage_time\": {",failed);
+  for(int s=0;s<ST_NUM;++s)
+    fprintf(fp,"%s\"%s\": %f",s?", ":"",StageName[s],stageTot[s]);
+  fprintf(fp,"}\n}\n");
+}
+
+int main(int argc ,char**argv)
+{
+  if(argc<3) Usage();
+
+  BatchParam bp;
+  bp.qparams.QualityThr = .3;
+  bp.OutDir = argv[1];
+  std::vector<std::string> inputVec;
+  for(int i=2; i < argc; ++i)
+  {
+    if(argv[i][0]!='-') { inputVec.push_back(argv[i]); continue; }
+    switch(argv[i][1])
+    {
+      case 'B' : bp.qparams.PreserveBoundary = (argv[i][2]=='y'); break;
+      case 'T' : bp.qparams.PreserveTopology = (argv[i][2]=='y'); break;
+      case 'O' : bp.qparams.OptimalPlacement = (argv[i][2]=='y'); break;
+      case 'q' : bp.qparams.QualityThr = atof(argv[i]+2); break;
+      case 'e' : bp.TargetError        = atof(argv[i]+2); break;
+      case 'f' : bp.TargetFaceNum      = atoi(argv[i]+2); break;
+      case 'r' : bp.TargetRatio        = atof(argv[i]+2); break;
+      case 's' : bp.MetroSamplesPerFace= atoi(argv[i]+2); break;
+      case 't' : bp.ThreadNum          = atoi(argv[i]+2); break;
+      case 'x' : bp.OutExt             = argv[i]+2; break;
+      case 'j' : bp.SummaryName        = argv[i]+2; break;
+      case 'C' : bp.CleaningFlag = true; break;
+      case 'M' : bp.MetroFlag    = true; break;
+      default  :  printf("Unknown option '%s'\n", argv[i]);
+        exit(0);
+    }
+  }
+  if(inputVec.empty()) Usage();
+
+  int threadNum = bp.ThreadNum;
+  if(threadNum<=0) threadNum = std::max(1,int(std::thread::hardware_concurrency()));
+  threadNum = std::min(threadNum,int(inputVec.size()));
+
+  BoundedQueue<TilePtr> loadedQueue(threadNum);
+  BoundedQueue<TilePtr> processedQueue(threadNum);
+  std::vector<TilePtr> doneVec(inputVec.size());
+  BatchClock::time_point start=BatchClock::now();
+
+  // Reader: import the tiles in order, at most threadNum ahead of the workers
+  std::thread reader([&]{
+    for(size_t i=0;i<inputVec.size();++i)
+    {
+      TilePtr t(new Tile);
+      t->index=int(i);
+      t->inName=inputVec[i];
+      t->outName=OutputName(inputVec[i],bp);
+      BatchClock::time_point t0=BatchClock::now();
+      int err=vcg::tri::io::Importer<MyMesh>::Open(t->m,t->inName.c_str());
+      if(err && vcg::tri::io::Importer<MyMesh>::ErrorCritical(err))
+        t->error=vcg::tri::io::Importer<MyMesh>::ErrorMsg(err);
+      t->time[ST_IMPORT]=Elapsed(t0);
+      t->vnIn=t->m.vn;
+      t->fnIn=t->m.fn;
+      loadedQueue.Push(std::move(t));
+    }
+    loadedQueue.Close();
+  });
+
+  // Workers
+  std::vector<std::thread> workerVec;
+  for(int w=0;w<threadNum;++w)
+    workerVec.push_back(std::thread([&]{
+      TilePtr t;
+      while(loadedQueue.Pop(t))
+      {
+        if(t->error.empty()) ProcessTile(*t,bp);
+        processedQueue.Push(std::move(t));
+      }
+    }));
+
+  // Writer: save the tiles as soon as they are ready
+  std::thread writer([&]{
+    TilePtr t;
+    int cnt=0;
+    while(processedQueue.Pop(t))
+    {
+      if(t->error.empty())
+      {
+        BatchClock::time_point t0=BatchClock::now();
+        int err=vcg::tri::io::Exporter<MyMesh>::Save(t->m,t->outName.c_str());
+        if(err) t->error=vcg::tri::io::Exporter<MyMesh>::ErrorMsg(err);
+        t->time[ST_EXPORT]=Elapsed(t0);
+      }
+      fprintf(stderr,"[%i/%i] %s: %i -> %i faces %s\n",++cnt,int(inputVec.size()),t->inName.c_str(),t->fnIn,t->fnOut,t->error.c_str());
+      t->m.Clear();
+      const int ind=t->index;
+      doneVec[ind]=std::move(t);
+    }
+  });
+
+  reader.join();
+  for(size_t w=0;w<workerVec.size();++w) workerVec[w].join();
+  processedQueue.Close();
+  writer.join();
+
+  if(bp.SummaryName.empty()) bp.SummaryName = bp.OutDir+"/tribatch_summary.json";
+  FILE *fp = (bp.SummaryName=="-") ? stdout : fopen(bp.SummaryName.c_str(),"w");
+  if(!fp)
+  {
+    printf("Unable to write summary %s\n",bp.SummaryName.c_str());
+    return -1;
+  }
+  WriteSummary(fp,doneVec,bp,threadNum,Elapsed(start));
+  if(fp!=stdout) fclose(fp);
+
+  for(size_t i=0;i<doneVec.size();++i)
+    if(!doneVec[i]->error.empty()) return 1;
+  return 0;
+}
@@ -0,0 +1,11 @@
+
+TARGET = tribatch
+DEPENDPATH += ../..
+INCLUDEPATH += . ../.. ../../eigenlib
+CONFIG += console stl  c++11 thread debug_and_release
+TEMPLATE = app
+SOURCES += tribatch.cpp ../../wrap/ply/plylib.cpp
+
+
+# Mac specific Config required to avoid to make application bundles
+CONFIG -= app_bundle
@@ -31,6 +31,11 @@
 #include <vcg/complex/algorithms/closest.h>
 #include <vcg/space/index/grid_static_ptr.h>
 #include <vcg/space/index/spatial_hashing.h>
+#include <vcg/space/index/kdtree/kdtree.h>
+#include <vcg/math/disjoint_set.h>
+#include <vcg/math/radix_sort.h>
+#include <atomic>
+#include <cstring>
 #include <vcg/complex/algorithms/update/normal.h>
 #include <vcg/space/triangle3.h>
 #include <vcg/complex/append.h>
@@ -274,6 +279,123 @@ public:
 		return deleted;
 	}
 
+	/** Parallel version of RemoveDuplicateVertex, with the same result on meshes without deleted vertices:
+	*  of each group of vertices with the same position only the first one (in index order) is kept.
+	*  The vertices are grouped by a parallel radix sort on a 64 bit key of their coordinates instead of a comparison
+	*  sort of the vertex pointers, and the references of faces, edges and tetras are updated in parallel.
+	*/
+	static int RemoveDuplicateVertexParallel( MeshType & m, bool RemoveDegenerateFlag=true)
+	{
+		if(m.vert.size()==0 || m.vn==0) return 0;
+		const int vn = int(m.vert.size());
+		std::vector<std::pair<unsigned long long,int> > sorted(vn);
+#pragma omp parallel for schedule(static)
+		for(int i=0; i<vn; ++i)
+			sorted[i] = std::make_pair(PositionKey(m.vert[i].cP()), i);
+		RadixSort(sorted);
+
+		// inside each run of equal keys (in index order, the sort is stable) each vertex goes to the first one with the same position
+		std::vector<int> remap(vn);
+#pragma omp parallel for schedule(static)
+		for(int i=0; i<vn; ++i) remap[i] = i;
+#pragma omp parallel for schedule(dynamic, 4096)
+		for(int b=0; b<vn; ++b)
+		{
+			if(b>0 && sorted[b].first==sorted[b-1].first) continue;
+			int e=b+1;
+			while(e<vn && sorted[e].first==sorted[b].first) ++e;
+			if(e-b<=16)
+			{
+				for(int i=b+1; i<e; ++i)
+				{
+					const VertexType &v = m.vert[sorted[i].second];
+					if(v.IsD()) continue;
+					for(int j=b; j<i; ++j)
+						if(!m.vert[sorted[j].second].IsD() && m.vert[sorted[j].second].cP()==v.cP())
+						{
+							remap[sorted[i].second] = sorted[j].second;
+							break;
+						}
+				}
+			}
+			else
+			{
+				std::vector<int> run;
+				for(int i=b; i<e; ++i)
+					if(!m.vert[sorted[i].second].IsD()) run.push_back(sorted[i].second);
+				std::sort(run.begin(), run.end(), [&m](int a, int c) {
+					return (m.vert[a].cP()==m.vert[c].cP()) ? (a<c) : (m.vert[a].cP()<m.vert[c].cP()); });
+				for(size_t i=1, j=0; i<run.size(); ++i)
+				{
+					if(m.vert[run[i]].cP()==m.vert[run[j]].cP()) remap[run[i]] = run[j];
+					else j = i;
+				}
+			}
+		}
+
+		int deleted=0;
+#pragma omp parallel for schedule(static) reduction(+: deleted)
+		for(int i=0; i<vn; ++i)
+			if(remap[i]!=i)
+			{
+				m.vert[i].SetD();
+				++deleted;
+			}
+		m.vn -= deleted;
+
+#pragma omp parallel for schedule(static)
+		for(int i=0; i<int(m.face.size()); ++i)
+			if(!m.face[i].IsD())
+				for(int k=0; k<m.face[i].VN(); ++k)
+					m.face[i].V(k) = &m.vert[remap[tri::Index(m,m.face[i].V(k))]];
+#pragma omp parallel for schedule(static)
+		for(int i=0; i<int(m.edge.size()); ++i)
+			if(!m.edge[i].IsD())
+				for(int k=0; k<2; ++k)
+					m.edge[i].V(k) = &m.vert[remap[tri::Index(m,m.edge[i].V(k))]];
+#pragma omp parallel for schedule(static)
+		for(int i=0; i<int(m.tetra.size()); ++i)
+			if(!m.tetra[i].IsD())
+				for(int k=0; k<4; ++k)
+					m.tetra[i].V(k) = &m.vert[remap[tri::Index(m,m.tetra[i].V(k))]];
+
+		if(RemoveDegenerateFlag) RemoveDegenerateFace(m);
+		if(RemoveDegenerateFlag && m.en>0) {
+			RemoveDegenerateEdge(m);
+			RemoveDuplicateEdge(m);
+		}
+		return deleted;
+	}
+
+	/// 64 bit key of a position: equal positions have the same key (0 and -0 too); different ones usually not
+	static unsigned long long PositionKey(const CoordType &p)
+	{
+		unsigned long long h = 0;
+		for(int k=0; k<3; ++k)
+		{
+			ScalarType c = p[k];
+			if(c==0) c=0;
+			unsigned long long bits = 0;
+			std::memcpy(&bits, &c, std::min(sizeof(c), sizeof(bits)));
+			h = MixKey(h + bits);
+		}
+		return h;
+	}
+
+	/// 64 bit key of a cell of an integer grid (see ClusterVertexParallel); different cells usually have different keys
+	static unsigned long long CellKey(const Point3<long long> &c)
+	{
+		return MixKey(MixKey(MixKey((unsigned long long)(c[0])) + (unsigned long long)(c[1])) + (unsigned long long)(c[2]));
+	}
+
+	/// bit mixing of the splitmix64 generator
+	static unsigned long long MixKey(unsigned long long h)
+	{
+		h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+		h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+		return h ^ (h >> 31);
+	}
+
 	class SortedPair
 	{
 	public:
@@ -1259,6 +1381,80 @@ public:
 		return int(CCV.size());
 	}
 
+	/*
+  Same result of ConnectedComponents (same components, in the same order and with the same representative face)
+  computed in parallel with a concurrent union-find over the FF adjacency; the V flag of the faces is not used.
+ */
+	static int ConnectedComponentsParallel(MeshType &m, std::vector< std::pair<int,FacePointer> > &CCV)
+	{
+		std::vector<int> label;
+		const int ccNum = ConnectedComponentLabels(m, label);
+		CCV.assign(ccNum, std::make_pair(0, FacePointer(0)));
+		for(size_t i=0; i<m.face.size(); ++i)
+			if(label[i]>=0)
+			{
+				if(CCV[label[i]].first==0) CCV[label[i]].second=&m.face[i];
+				++CCV[label[i]].first;
+			}
+		return ccNum;
+	}
+
+	/*
+  Label each face with the index of its connected component (through FF adjacency), in parallel.
+  The components are numbered in the order of their first face and deleted faces get -1;
+  returns the number of components.
+ */
+	static int ConnectedComponentLabels(MeshType &m, std::vector<int> &label)
+	{
+		tri::RequireFFAdjacency(m);
+		const int fn = int(m.face.size());
+		ConcurrentDisjointSet ds(fn);
+		std::vector<char> deleted(fn);
+#pragma omp parallel for schedule(dynamic, 4096)
+		for(int i=0; i<fn; ++i)
+		{
+			FaceType &f = m.face[i];
+			deleted[i] = f.IsD();
+			if(f.IsD()) continue;
+			for(int j=0; j<f.VN(); ++j)
+				if(!face::IsBorder(f,j))
+					ds.Union(i, int(tri::Index(m, f.FFp(j))));
+		}
+		return ds.Labels(label, &deleted);
+	}
+
+	/*
+  Label each vertex with the index of its cluster, in parallel: two vertices are in the same cluster
+  when they are closer than radius. Numbering as in ConnectedComponentLabels, deleted vertices get -1;
+  returns the number of clusters. Faces are not used, so it works on point clouds.
+ */
+	static int PointCloudConnectedComponentLabels(MeshType &m, ScalarType radius, std::vector<int> &label)
+	{
+		const int vn = int(m.vert.size());
+		VertexConstDataWrapper<MeshType> ww(m);
+		KdTree<ScalarType> tree(ww);
+		ConcurrentDisjointSet ds(vn);
+		std::vector<char> deleted(vn);
+#pragma omp parallel
+		{
+			std::vector<unsigned int> nb;
+			std::vector<ScalarType> sqDist;
+#pragma omp for schedule(dynamic, 1024)
+			for(int i=0; i<vn; ++i)
+			{
+				deleted[i] = m.vert[i].IsD();
+				if(deleted[i]) continue;
+				nb.clear();
+				sqDist.clear();
+				tree.doQueryDist(m.vert[i].cP(), radius, nb, sqDist);
+				for(size_t k=0; k<nb.size(); ++k)
+					if(int(nb[k])<i && !m.vert[nb[k]].IsD())
+						ds.Union(i, int(nb[k]));
+			}
+		}
+		return ds.Labels(label, &deleted);
+	}
+
 	static int edgeMeshConnectedComponents(MeshType & poly,  std::vector<std::pair<int, typename MeshType::EdgePointer> > &eCC)
 	{
 		typedef typename MeshType::EdgePointer EdgePointer;
@@ -1863,6 +2059,149 @@ public:
 		return mergedCnt;
 	}
 
+	/**
+	  Parallel version of MergeCloseVertex, with the same result.
+*/
+	static int MergeCloseVertexParallel(MeshType &m, const ScalarType radius)
+	{
+		int mergedCnt=0;
+		mergedCnt = ClusterVertexParallel(m,radius);
+		RemoveDuplicateVertexParallel(m,true);
+		return mergedCnt;
+	}
+
+	/**
+	  Parallel version of ClusterVertex, with the same result: in index order, each vertex not yet moved moves
+	  to its position the vertices closer than radius not yet moved. So a vertex is moved to the first vertex
+	  closer than radius (in index order) that has not been moved itself, or stays where it is if there is none.
+	  The vertices are sorted in a hashed grid of cells of side radius and, in rounds, each cell decides in parallel
+	  the vertices whose closer vertices with lower index have already been decided; the first undecided vertex
+	  can always be decided, and usually a few rounds are enough.
+*/
+	static int ClusterVertexParallel(MeshType &m, const ScalarType radius)
+	{
+		if(m.vn==0) return 0;
+		tri::Allocator<MeshType>::CompactVertexVector(m);
+		const int vn = int(m.vert.size());
+		UpdateFlags<MeshType>::VertexSetV(m);
+		if(!(radius>0)) return 0;
+
+		// the vertices sorted by cell; each cell is a range of sorted
+		std::vector<std::pair<unsigned long long,int> > sorted(vn);
+		std::vector<Point3<long long> > cell(vn);
+#pragma omp parallel for schedule(static)
+		for(int i=0; i<vn; ++i)
+		{
+			for(int k=0; k<3; ++k)
+				cell[i][k] = (long long)(std::floor(m.vert[i].cP()[k]/radius));
+			sorted[i] = std::make_pair(CellKey(cell[i]), i);
+		}
+		RadixSort(sorted);
+		std::vector<unsigned long long> cellKey;
+		std::vector<int> cellBegin;
+		for(int i=0; i<vn; ++i)
+			if(i==0 || sorted[i].first!=sorted[i-1].first)
+			{
+				cellKey.push_back(sorted[i].first);
+				cellBegin.push_back(i);
+			}
+		cellBegin.push_back(vn);
+		// open addressing table from the key of a cell to its index in cellKey
+		size_t tableSize = 64;
+		while(tableSize < 2*cellKey.size()) tableSize *= 2;
+		std::vector<int> cellTable(tableSize, -1);
+		for(size_t c=0; c<cellKey.size(); ++c)
+		{
+			size_t h = size_t(cellKey[c] >> 32) & (tableSize-1);
+			while(cellTable[h]!=-1) h = (h+1) & (tableSize-1);
+			cellTable[h] = int(c);
+		}
+
+		// owner of each vertex: -1 undecided, itself if it stays, the vertex it is moved to otherwise
+		std::vector<std::atomic<int> > owner(vn);
+#pragma omp parallel for schedule(static)
+		for(int i=0; i<vn; ++i) owner[i].store(-1, std::memory_order_relaxed);
+		std::vector<int> activeCell(cellKey.size());
+		for(size_t c=0; c<cellKey.size(); ++c) activeCell[c] = int(c);
+		while(!activeCell.empty())
+		{
+			std::vector<char> stillActive(activeCell.size(), 0);
+#pragma omp parallel
+			{
+				std::vector<std::pair<int,int> > range;
+				std::vector<int> closer;
+#pragma omp for schedule(dynamic, 64)
+				for(int a=0; a<int(activeCell.size()); ++a)
+				{
+					const int c = activeCell[a];
+					Point3<long long> cc(0,0,0);
+					range.clear();
+					// the vertices of the cell are in index order
+					for(int i=cellBegin[c]; i<cellBegin[c+1]; ++i)
+					{
+						const int v = sorted[i].second;
+						if(owner[v].load(std::memory_order_relaxed)!=-1) continue;
+						// the ranges of the 27 cells around; a range can hold more cells with the same key
+						if(range.empty() || cell[v]!=cc)
+						{
+							cc = cell[v];
+							range.clear();
+							for(long long dx=-1; dx<=1; ++dx)
+								for(long long dy=-1; dy<=1; ++dy)
+									for(long long dz=-1; dz<=1; ++dz)
+									{
+										const unsigned long long key = CellKey(cc+Point3<long long>(dx,dy,dz));
+										for(size_t h = size_t(key >> 32) & (tableSize-1); cellTable[h]!=-1; h = (h+1) & (tableSize-1))
+											if(cellKey[cellTable[h]]==key)
+											{
+												range.push_back(std::make_pair(cellBegin[cellTable[h]], cellBegin[cellTable[h]+1]));
+												break;
+											}
+									}
+							std::sort(range.begin(), range.end());
+							range.erase(std::unique(range.begin(), range.end()), range.end());
+						}
+						const CoordType &p = m.vert[v].cP();
+						closer.clear();
+						for(size_t r=0; r<range.size(); ++r)
+							for(int j=range[r].first; j<range[r].second; ++j)
+							{
+								const int u = sorted[j].second;
+								if(u<v && Distance(p, m.vert[u].cP())<radius) closer.push_back(u);
+							}
+						std::sort(closer.begin(), closer.end());
+						// moved to the first closer vertex that stays, unless an undecided one comes before it
+						int o = v;
+						for(size_t j=0; j<closer.size(); ++j)
+						{
+							const int ou = owner[closer[j]].load(std::memory_order_relaxed);
+							if(ou==-1 || ou==closer[j]) { o = ou; break; }
+						}
+						if(o==-1) stillActive[a] = 1;
+						else owner[v].store(o, std::memory_order_relaxed);
+					}
+				}
+			}
+			std::vector<int> nextActive;
+			for(size_t a=0; a<activeCell.size(); ++a)
+				if(stillActive[a]) nextActive.push_back(activeCell[a]);
+			activeCell.swap(nextActive);
+		}
+
+		int mergedCnt=0;
+#pragma omp parallel for schedule(static) reduction(+: mergedCnt)
+		for(int i=0; i<vn; ++i)
+		{
+			const int o = owner[i].load(std::memory_order_relaxed);
+			if(o!=i)
+			{
+				m.vert[i].P() = m.vert[o].cP();
+				++mergedCnt;
+			}
+		}
+		return mergedCnt;
+	}
+
 	static int ClusterVertex(MeshType &m, const ScalarType radius)
 	{
 		if(m.vn==0) return 0;
@@ -26,6 +26,8 @@
 
 #include <iostream>
 #include <list>
+#include <algorithm>
+#include <unordered_map>
 
 namespace vcg {
   namespace tri {
@@ -78,21 +80,16 @@ template <class MESH> class AdvancingFront {
   std::vector<int> nb; //number of fronts a vertex is into,
                        //this is used for the Visited and Border flags
                        //but adding topology may not be needed anymore
+  std::vector<int> vfHead; //when the mesh has no VF adjacency: first face corner (3*face+wedge) on each vertex
+  std::vector<int> vfNext; //and next corner on the same vertex (-1 at the end); used by CheckEdge
+  std::unordered_multimap<int, std::list<FrontEdge>::iterator> edgeFrom; //front and dead edges by their v0
 
  public:
 
   MESH &mesh;           //this structure will be filled by the algorithm
 
   AdvancingFront(MESH &_mesh): mesh(_mesh) {
-
-
-    UpdateFlags<MESH>::FaceBorderFromNone(mesh);
-    UpdateFlags<MESH>::VertexBorderFromFaceBorder(mesh);
-
-    nb.clear();
-    nb.resize(mesh.vert.size(), 0);
-
-    CreateLoops();
+    ResetFront();
   }
   virtual ~AdvancingFront() {}
 
@@ -124,6 +121,23 @@ protected:
   // return -1 in case of failure
   virtual int Place(FrontEdge &e, ResultIterator &touch) = 0;
 
+  //rebuild the front from the borders of the current faces of the mesh
+  void ResetFront()
+  {
+    front.clear();
+    deads.clear();
+    edgeFrom.clear();
+
+    UpdateFlags<MESH>::FaceBorderFromNone(mesh);
+    UpdateFlags<MESH>::VertexBorderFromFaceBorder(mesh);
+
+    nb.clear();
+    nb.resize(mesh.vert.size(), 0);
+
+    BuildVFIndex();
+    CreateLoops();
+  }
+
   //create the FrontEdge loops from seed faces
   void CreateLoops()
   {
@@ -144,11 +158,19 @@ protected:
       (*s).previous = front.end();
       (*s).next = front.end();
     }
-    //now create loops:
+    //now create loops: the next of s is the first edge (in front order) starting from s.v1 still without a previous
+    std::vector<std::list<FrontEdge>::iterator> edges;
+    std::vector<std::pair<int,int> > start; //(v0, position in front) sorted
     for(std::list<FrontEdge>::iterator s = front.begin(); s != front.end(); s++) {
-      for(std::list<FrontEdge>::iterator j = front.begin(); j != front.end(); j++) {
+      start.push_back(std::make_pair((*s).v0, int(edges.size())));
+      edges.push_back(s);
+    }
+    std::sort(start.begin(), start.end());
+    for(std::list<FrontEdge>::iterator s = front.begin(); s != front.end(); s++) {
+      std::vector<std::pair<int,int> >::iterator c = std::lower_bound(start.begin(), start.end(), std::make_pair((*s).v1, -1));
+      for(; c != start.end() && (*c).first == (*s).v1; ++c) {
+        std::list<FrontEdge>::iterator j = edges[(*c).second];
         if(s == j) continue;
-        if((*s).v1 != (*j).v0) continue;
         if((*j).previous != front.end()) continue;
         (*s).next = j;
         (*j).previous = s;
@@ -182,6 +204,7 @@ protected:
       nb[v[i]]++;
 
       e = front.insert(front.begin(), FrontEdge(v0, v1, v2));
+      edgeFrom.insert(std::make_pair(v0, e));
       if(i != 0) {
         (*last).next = e;
         (*e).previous = last;
@@ -376,6 +399,33 @@ protected:
         (*fi).V(j)->VFi() = j;
       }
     }
+    else if(vfNext.size() + 3 != mesh.face.size()*3) //faces added from outside
+      BuildVFIndex();
+    else
+    {
+      if(vfHead.size() < mesh.vert.size()) vfHead.resize(mesh.vert.size(), -1);
+      int v[3] = {v0, v1, v2};
+      for(int j=0;j<3;++j)
+      {
+        vfNext.push_back(vfHead[v[j]]);
+        vfHead[v[j]] = int(mesh.face.size()-1)*3+j;
+      }
+    }
+  }
+
+  //index of the faces around each vertex, kept when the mesh has no VF adjacency
+  void BuildVFIndex() {
+    vfHead.clear();
+    vfNext.clear();
+    if(tri::HasVFAdjacency(mesh)) return;
+    vfHead.resize(mesh.vert.size(), -1);
+    vfNext.resize(mesh.face.size()*3, -1);
+    for(int i = 0; i < (int)mesh.face.size(); i++)
+      for(int k = 0; k < 3; k++) {
+        int v = int(tri::Index(mesh, mesh.face[i].V(k)));
+        vfNext[i*3+k] = vfHead[v];
+        vfHead[v] = i*3+k;
+      }
   }
 
   void AddVertex(VertexType &vertex) {
@@ -417,8 +467,10 @@ protected:
       }
       return true;
     }
-    for(int i = 0; i < (int)mesh.face.size(); i++) {
-      FaceType &f = mesh.face[i];
+    //only the faces around v0 can have the edge
+    if(v0 >= (int)vfHead.size()) return true;
+    for(int c = vfHead[v0]; c != -1; c = vfNext[c]) {
+      FaceType &f = mesh.face[c/3];
       for(int k = 0; k < 3; k++) {
         if(vv0 == f.V0(k) && vv1 == f.V1(k))  //orientation non constistent
            return false;
@@ -434,7 +486,31 @@ protected:
 
   //Add a new FrontEdge to the back of the queue
   std::list<FrontEdge>::iterator addNewEdge(FrontEdge e) {
-    return front.insert(front.end(), e);
+    std::list<FrontEdge>::iterator ne = front.insert(front.end(), e);
+    edgeFrom.insert(std::make_pair(e.v0, ne));
+    return ne;
+  }
+
+  //find the edge starting from v that is touched by a new face: the last one of the deads if any,
+  //otherwise the last one of the front (same result of scanning both lists);
+  //touch is left untouched if there is no such edge
+  void FindEdgeFrom(int v, ResultIterator &touch) {
+    int frontNum = 0, deadNum = 0;
+    std::list<FrontEdge>::iterator fe, de;
+    typedef std::unordered_multimap<int, std::list<FrontEdge>::iterator>::iterator EdgeFromIterator;
+    std::pair<EdgeFromIterator, EdgeFromIterator> r = edgeFrom.equal_range(v);
+    for(EdgeFromIterator k = r.first; k != r.second; ++k) {
+      if((*(*k).second).active) { fe = (*k).second; frontNum++; }
+      else { de = (*k).second; deadNum++; }
+    }
+    std::list<FrontEdge> &l = deadNum ? deads : front;
+    if(deadNum + frontNum == 0) return;
+    touch.first = deadNum ? DEADS : FRONT;
+    touch.second = deadNum ? de : fe;
+    if((deadNum ? deadNum : frontNum) == 1) return;
+    //more edges from v: the order in the list decides
+    for(std::list<FrontEdge>::iterator k = l.begin(); k != l.end(); k++)
+      if((*k).v0 == v) touch.second = k;
   }
 
   //move an Edge among the dead ones
@@ -453,6 +529,10 @@ protected:
   }
 
   void Erase(std::list<FrontEdge>::iterator e) {
+    typedef std::unordered_multimap<int, std::list<FrontEdge>::iterator>::iterator EdgeFromIterator;
+    std::pair<EdgeFromIterator, EdgeFromIterator> r = edgeFrom.equal_range((*e).v0);
+    for(EdgeFromIterator k = r.first; k != r.second; ++k)
+      if((*k).second == e) { edgeFrom.erase(k); break; }
     if((*e).active) front.erase(e);
     else deads.erase(e);
   }
@@ -27,6 +27,7 @@
 #include <vcg/space/index/kdtree/kdtree.h>
 
 #include <vcg/complex/algorithms/closest.h>
+#include <map>
 
 /* Ball pivoting algorithm:
    1) the vertices used in the new mesh are marked as visited
@@ -34,6 +35,8 @@
    3) the vector nb is used to keep track of the number of borders a vertex belongs to
    4) usedBit flag is used to select the points in the mesh already processed
 
+   BuildMeshParallel reconstructs in parallel independent slabs of the point cloud and then
+   closes in parallel each seam between them with an advancing front local to the seam (see below).
 */
 namespace vcg {
   namespace tri {
@@ -61,7 +64,7 @@ template <class MESH> class BallPivoting: public AdvancingFront<MESH> {
 
     AdvancingFront<MESH>(_mesh), radius(_radius),
     min_edge(minr), max_edge(1.8), max_angle(cos(angle)),
-    last_seed(-1) {
+    last_seed(-1), ownBit(true) {
 
     //compute bbox
     baricenter = Point3x(0, 0, 0);
@@ -79,28 +82,115 @@ template <class MESH> class BallPivoting: public AdvancingFront<MESH> {
     min_edge *= radius;
     max_edge *= radius;
 
-    VertexConstDataWrapper<MESH> ww(this->mesh);
-    tree = new KdTree<ScalarType>(ww);
-//    tree->setMaxNofNeighbors(16);
-
     usedBit = VertexType::NewBitFlag();
-    UpdateFlags<MESH>::VertexClear(this->mesh,usedBit);
-    UpdateFlags<MESH>::VertexClearV(this->mesh);
-
-    for(int i = 0; i < (int)this->mesh.face.size(); i++) {
-      FaceType &f = this->mesh.face[i];
-      if(f.IsD()) continue;
-      for(int k = 0; k < 3; k++) {
-        Mark(f.V(k));
-      }
-    }
+    Init();
   }
 
   ~BallPivoting() {
-    VertexType::DeleteBitFlag(usedBit);
+    if(ownBit) VertexType::DeleteBitFlag(usedBit);
     delete tree;
   }
 
+  /// Multithreaded version of BuildMesh for point clouds (meshes without faces; otherwise BuildMesh is used).
+  /// The points are split along the longest side of the bbox in regionNum slabs with the same number of points
+  /// (by default one every 2048 points, at most 16). Each slab owns its points and is reconstructed by a different thread
+  /// on its own mesh, so the fronts of a slab stop at its borders and the slabs share no vertex or face.
+  /// The slabs are seeded independently, so before joining them the orientation of their pieces is made
+  /// consistent across the seams. Each seam is then closed locally, in parallel with the others, by BuildSeam:
+  /// a front is started only from the borders of the faces of the two slabs facing the seam, on the strip of points
+  /// around it, and the holes left where the fronts of the two sides meet are pivoted again. The borders of the
+  /// sampling itself are left as they are, so the whole mesh is never pivoted again.
+  /// The result is manifold as the one of BuildMesh, and far from the seams it is usually the same.
+  void BuildMeshParallel(CallBackPos call = NULL, int regionNum = 0)
+  {
+    MESH &m = this->mesh;
+    // the default depends only on the points, so that the result does not change with the number of threads
+    if(regionNum <= 0) regionNum = std::min(16, m.vn/2048);
+    const int axis = m.bbox.MaxDim();
+    // the faces within margin from a seam are pivoted again on the points within seamWidth from it;
+    // the strips of two seams must not overlap
+    const ScalarType margin = 2*radius;
+    const ScalarType seamWidth = margin + 4*radius;
+    regionNum = std::min(regionNum, int(m.bbox.Dim()[axis] / (4*seamWidth)));
+    if(m.fn > 0 || regionNum <= 1) {
+      this->BuildMesh(call);
+      return;
+    }
+
+    // vertices sorted along the axis, and the first one of each slab
+    std::vector<std::pair<ScalarType,int> > sorted;
+    for(int i = 0; i < (int)m.vert.size(); i++)
+      if(!m.vert[i].IsD()) sorted.push_back(std::make_pair(m.vert[i].cP()[axis], i));
+    std::sort(sorted.begin(), sorted.end());
+    // a seam closer than 4*seamWidth to the previous one (or to the end) is skipped: the slab would be too thin,
+    // mostly made of the strips pivoted again
+    std::vector<int> start(1, 0);
+    std::vector<ScalarType> bound(1, sorted.front().first);
+    for(int r = 1; r < regionNum; r++) {
+      const ScalarType b = sorted[sorted.size()*r/regionNum].first;
+      if(b - bound.back() < 4*seamWidth || sorted.back().first - b < 4*seamWidth) continue;
+      bound.push_back(b);
+      start.push_back(int(std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(b, -1)) - sorted.begin()));
+    }
+    start.push_back(int(sorted.size()));
+    bound.push_back(sorted.back().first);
+    regionNum = int(start.size())-1;
+    if(regionNum <= 1) {
+      this->BuildMesh(call);
+      return;
+    }
+
+    if(call) (*call)(0, "Reconstructing slabs");
+    std::vector<std::vector<int> > regionFace(regionNum); // faces, as global vertex indexes
+    std::vector<std::vector<int> > regionUsed(regionNum); // processed vertices far from the seams
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int r = 0; r < regionNum; r++)
+      BuildRegion(sorted, start, bound, r, axis, regionFace[r], regionUsed[r]);
+
+    if(call) (*call)(50, "Closing seams");
+    std::vector<int> regionOf(m.vert.size(), -1);
+    for(int r = 0; r < regionNum; r++)
+      for(int i = start[r]; i < start[r+1]; i++) regionOf[sorted[i].second] = r;
+    OrientRegions(regionFace, regionOf, bound, axis);
+    // the faces near the seams have been built without the points of the other side: they are dropped
+    // and each seam is pivoted again, on its own strip of points, by a different thread
+    for(int r = 0; r < regionNum; r++) {
+      std::vector<int> kept;
+      for(size_t i = 0; i < regionFace[r].size(); i += 3) {
+        bool nearSeam = false;
+        for(int k = 0; k < 3; k++) {
+          ScalarType c = m.vert[regionFace[r][i+k]].cP()[axis];
+          nearSeam = nearSeam || (r > 0 && c < bound[r]+margin) || (r < regionNum-1 && c >= bound[r+1]-margin);
+        }
+        if(!nearSeam) kept.insert(kept.end(), regionFace[r].begin()+i, regionFace[r].begin()+i+3);
+      }
+      regionFace[r].swap(kept);
+    }
+    std::vector<char> used(m.vert.size(), 0);
+    for(int r = 0; r < regionNum; r++)
+      for(size_t i = 0; i < regionUsed[r].size(); i++) used[regionUsed[r][i]] = 1;
+    std::vector<std::vector<int> > seamFace(regionNum);
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int r = 1; r < regionNum; r++)
+      BuildSeam(sorted, bound, r, axis, regionFace, used, seamFace[r]);
+
+    // the faces of the slabs inside a strip are replaced by the ones of the strip
+    std::vector<int> faceVec;
+    for(int r = 0; r < regionNum; r++) {
+      for(size_t i = 0; i < regionFace[r].size(); i += 3) {
+        bool inStrip[2] = {r > 0, r < regionNum-1};
+        for(int k = 0; k < 3; k++) {
+          ScalarType c = m.vert[regionFace[r][i+k]].cP()[axis];
+          inStrip[0] = inStrip[0] && c < bound[r]+seamWidth;
+          inStrip[1] = inStrip[1] && c >= bound[r+1]-seamWidth;
+        }
+        if(!inStrip[0] && !inStrip[1]) faceVec.insert(faceVec.end(), regionFace[r].begin()+i, regionFace[r].begin()+i+3);
+      }
+      faceVec.insert(faceVec.end(), seamFace[r].begin(), seamFace[r].end());
+    }
+    RestartFront(faceVec, used);
+  }
+
   bool Seed(int &v0, int &v1, int &v2) {
     //get a sphere of neighbours
     while(++last_seed < (int)(this->mesh.vert.size())) {
@@ -321,22 +411,7 @@ template <class MESH> class BallPivoting: public AdvancingFront<MESH> {
     }
 
     //test if id is in some border (to return touch
-    for(std::list<FrontEdge>::iterator k = this->front.begin(); k != this->front.end(); k++)
-    {
-      if((*k).v0 == candidateIndex)
-      {
-        touch.first = AdvancingFront<MESH>::FRONT;
-        touch.second = k;
-      }
-    }
-    for(std::list<FrontEdge>::iterator k = this->deads.begin(); k != this->deads.end(); k++)
-    {
-      if((*k).v0 == candidateIndex)
-      {
-        touch.first = AdvancingFront<MESH>::DEADS;
-        touch.second = k;
-      }
-    }
+    this->FindEdgeFrom(candidateIndex, touch);
 
     //mark vertices close to candidate
     Mark(candidate);
@@ -346,9 +421,419 @@ template <class MESH> class BallPivoting: public AdvancingFront<MESH> {
  private:
   int last_seed;     //used for new seeds when front is empty
   int usedBit;       //use to detect if a vertex has been already processed.
+  bool ownBit;       //false if usedBit belongs to another BallPivoting
   Point3x baricenter;//used for the first seed.
   KdTree<ScalarType> *tree;
 
+  // BallPivoting for a slab of the points of parent (see BuildMeshParallel): same parameters, orientation and user bit.
+  BallPivoting(MESH &_mesh, const BallPivoting &parent):
+    AdvancingFront<MESH>(_mesh), radius(parent.radius),
+    min_edge(parent.min_edge), max_edge(parent.max_edge), max_angle(parent.max_angle),
+    last_seed(-1), usedBit(parent.usedBit), ownBit(false),
+    baricenter(parent.baricenter) {
+    Init();
+  }
+
+  void Init() {
+    VertexConstDataWrapper<MESH> ww(this->mesh);
+    tree = new KdTree<ScalarType>(ww);
+//    tree->setMaxNofNeighbors(16);
+
+    UpdateFlags<MESH>::VertexClear(this->mesh,usedBit);
+    UpdateFlags<MESH>::VertexClearV(this->mesh);
+    MarkFaceVertices();
+  }
+
+  // Mark() all the vertices of the faces; the neighbourhoods are searched in parallel
+  void MarkFaceVertices() {
+    std::vector<char> ref(this->mesh.vert.size(), 0);
+    for(int i = 0; i < (int)this->mesh.face.size(); i++) {
+      FaceType &f = this->mesh.face[i];
+      if(f.IsD()) continue;
+      for(int k = 0; k < 3; k++)
+        ref[tri::Index(this->mesh, f.V(k))] = 1;
+    }
+    std::vector<int> marked;
+#pragma omp parallel
+    {
+      std::vector<int> loc;
+      typename KdTree<ScalarType>::PriorityQueue pq;
+#pragma omp for schedule(dynamic, 1024)
+      for(int i = 0; i < (int)ref.size(); i++) {
+        if(!ref[i]) continue;
+        const VertexType &v = this->mesh.vert[i];
+        tree->doQueryK(v.cP(),16,pq);
+        int n = pq.getNofElements();
+        for (int j = 0; j < n; j++)
+          if(Distance(v.cP(),this->mesh.vert[pq.getIndex(j)].cP())<min_edge)
+            loc.push_back(pq.getIndex(j));
+      }
+#pragma omp critical
+      marked.insert(marked.end(), loc.begin(), loc.end());
+    }
+    for(size_t i = 0; i < marked.size(); i++)
+      this->mesh.vert[marked[i]].SetUserBit(usedBit);
+    for(size_t i = 0; i < ref.size(); i++)
+      if(ref[i]) this->mesh.vert[i].SetV();
+  }
+
+  // Replaces the faces of the mesh with faceVec (triples of vertex indexes) and sets the same state of a
+  // BallPivoting created on the mesh with these faces, except that also the vertices flagged in used are
+  // considered processed. As MarkFaceVertices, but only the neighbourhoods of the other vertices are searched.
+  void RestartFront(const std::vector<int> &faceVec, const std::vector<char> &used) {
+    MESH &m = this->mesh;
+    m.face.clear();
+    m.fn = 0;
+    if(tri::HasVFAdjacency(m))
+      for(size_t i = 0; i < m.vert.size(); i++) { m.vert[i].VFp() = 0; m.vert[i].VFi() = -1; }
+    for(size_t i = 0; i < faceVec.size(); i += 3)
+      this->AddFace(faceVec[i], faceVec[i+1], faceVec[i+2]);
+    this->ResetFront();
+    UpdateFlags<MESH>::VertexClear(m,usedBit);
+    UpdateFlags<MESH>::VertexClearV(m);
+    std::vector<char> ref(m.vert.size(), 0);
+    for(size_t i = 0; i < faceVec.size(); i++) ref[faceVec[i]] = 1;
+    std::vector<char> marked(used);
+#pragma omp parallel
+    {
+      typename KdTree<ScalarType>::PriorityQueue pq;
+#pragma omp for schedule(dynamic, 1024)
+      for(int i = 0; i < (int)m.vert.size(); i++) {
+        if(used[i] || m.vert[i].IsD()) continue;
+        tree->doQueryK(m.vert[i].cP(),16,pq);
+        for(int j = 0; j < pq.getNofElements(); j++)
+          if(ref[pq.getIndex(j)] && Distance(m.vert[i].cP(),m.vert[pq.getIndex(j)].cP())<min_edge)
+            marked[i] = 1;
+      }
+    }
+    for(size_t i = 0; i < m.vert.size(); i++) {
+      if(marked[i]) m.vert[i].SetUserBit(usedBit);
+      if(ref[i]) m.vert[i].SetV();
+    }
+    last_seed = -1;
+  }
+
+  // Flags in zone the vertices of the defects left in the faces faceVec of a strip of BuildSeam where the fronts coming
+  // from the two sides of the seam meet: the edges shared by more than two faces or with inconsistent orientation, and
+  // the open edges, except the borders left out of the front (deadEdge), with a vertex shared by faces of the two sides.
+  // The side of a face is the one of the closest (through the edges) face of the slabs (side: 0, 1, or -1 for the
+  // faces built by the strip). The holes of the sampling inside one side are not counted. Returns the number of edges.
+  static int SeamDefects(const std::vector<int> &faceVec, const std::vector<int> &side, int vn,
+                         const std::vector<std::pair<int,int> > &deadEdge, std::vector<char> &zone) {
+    const int fn = int(faceVec.size()/3);
+    std::vector<std::pair<std::pair<int,int>, int> > edge; // (min vertex, max vertex), 3*face+wedge
+    for(int i = 0; i < fn; i++)
+      for(int k = 0; k < 3; k++) {
+        const int v0 = faceVec[3*i+k], v1 = faceVec[3*i+(k+1)%3];
+        edge.push_back(std::make_pair(std::make_pair(std::min(v0,v1), std::max(v0,v1)), 3*i+k));
+      }
+    std::sort(edge.begin(), edge.end());
+    std::vector<int> adj(3*fn, -1);
+    for(size_t i = 0; i + 1 < edge.size(); i++)
+      if(edge[i].first == edge[i+1].first && (i + 2 == edge.size() || edge[i+2].first != edge[i].first) &&
+         (i == 0 || edge[i-1].first != edge[i].first)) {
+        adj[edge[i].second] = edge[i+1].second/3;
+        adj[edge[i+1].second] = edge[i].second/3;
+      }
+    // breadth first visit from the faces of the slabs
+    std::vector<int> faceSide(side.begin(), side.begin()+fn), queue;
+    for(int i = 0; i < fn; i++)
+      if(faceSide[i] >= 0) queue.push_back(i);
+    for(size_t q = 0; q < queue.size(); q++)
+      for(int k = 0; k < 3; k++) {
+        const int f = adj[3*queue[q]+k];
+        if(f >= 0 && faceSide[f] < 0) { faceSide[f] = faceSide[queue[q]]; queue.push_back(f); }
+      }
+    std::vector<int> vertSide(vn, -2); // -2 no face, -3 faces of different sides
+    for(int i = 0; i < fn; i++)
+      for(int k = 0; k < 3; k++) {
+        int &vs = vertSide[faceVec[3*i+k]];
+        if(vs == -2) vs = faceSide[i];
+        else if(vs != faceSide[i]) vs = -3;
+      }
+
+    zone.assign(vn, 0);
+    int defectNum = 0;
+    for(size_t i = 0; i < edge.size(); ) {
+      size_t j = i;
+      int dir = 0;
+      for(; j < edge.size() && edge[j].first == edge[i].first; j++) {
+        const int e = edge[j].second;
+        dir += (faceVec[e] < faceVec[3*(e/3)+(e%3+1)%3]) ? 1 : -1;
+      }
+      const int v0 = edge[i].first.first, v1 = edge[i].first.second;
+      const bool open = (j-i == 1);
+      if((!open && (j-i != 2 || dir != 0)) ||
+         (open && (vertSide[v0] == -3 || vertSide[v1] == -3) && !std::binary_search(deadEdge.begin(), deadEdge.end(), edge[i].first))) {
+        zone[v0] = zone[v1] = 1;
+        defectNum++;
+      }
+      i = j;
+    }
+    return defectNum;
+  }
+
+  // Moves to the dead edges the edges of the front in edgeSet (as sorted pairs of min and max vertex)
+  // and, if active is not empty, the ones with a vertex not flagged in active
+  void KillEdges(const std::vector<std::pair<int,int> > &edgeSet, const std::vector<char> &active) {
+    std::vector<std::list<FrontEdge>::iterator> dead;
+    for(std::list<FrontEdge>::iterator e = this->front.begin(); e != this->front.end(); ++e)
+      if((!active.empty() && (!active[(*e).v0] || !active[(*e).v1])) ||
+         std::binary_search(edgeSet.begin(), edgeSet.end(), std::make_pair(std::min((*e).v0, (*e).v1), std::max((*e).v0, (*e).v1))))
+        dead.push_back(e);
+    for(size_t i = 0; i < dead.size(); i++) this->KillEdge(dead[i]);
+  }
+
+  static int FindRoot(std::vector<int> &parent, int x) {
+    while(parent[x] != x) x = parent[x] = parent[parent[x]];
+    return x;
+  }
+
+  // Flips the pieces (connected components) of the slabs of BuildMeshParallel so that their orientation agrees
+  // across the seams: each border vertex near a seam votes, with the sign of the dot product of the normals,
+  // for the relative orientation of its piece and of the piece of the closest vertex of the other slab.
+  // Each group of pieces linked by the votes is then oriented as the seeds, i.e. outward from the barycenter.
+  void OrientRegions(std::vector<std::vector<int> > &regionFace, const std::vector<int> &regionOf,
+                     const std::vector<ScalarType> &bound, int axis) {
+    const int regionNum = int(regionFace.size());
+    const int vn = int(this->mesh.vert.size());
+    std::vector<int> comp(vn);
+    for(int i = 0; i < vn; i++) comp[i] = i;
+    std::vector<Point3x> normal(vn, Point3x(0,0,0));
+    std::vector<char> inFace(vn, 0);
+    for(int r = 0; r < regionNum; r++)
+      for(size_t i = 0; i < regionFace[r].size(); i += 3) {
+        const int *v = &regionFace[r][i];
+        comp[FindRoot(comp, v[1])] = FindRoot(comp, v[0]);
+        comp[FindRoot(comp, v[2])] = FindRoot(comp, v[0]);
+        const Point3x &p0 = this->mesh.vert[v[0]].cP();
+        Point3x n = (this->mesh.vert[v[1]].cP() - p0)^(this->mesh.vert[v[2]].cP() - p0);
+        for(int k = 0; k < 3; k++) { normal[v[k]] += n; inFace[v[k]] = 1; }
+      }
+    for(int i = 0; i < vn; i++) comp[i] = FindRoot(comp, i);
+
+    // votes between the pieces facing each other across a seam
+    std::map<std::pair<int,int>, int> vote;
+    const ScalarType seamDist = 2*max_edge;
+    typename KdTree<ScalarType>::PriorityQueue pq;
+    for(int i = 0; i < vn; i++) {
+      if(!inFace[i]) continue;
+      const int r = regionOf[i];
+      const ScalarType c = this->mesh.vert[i].cP()[axis];
+      if(!((r > 0 && c < bound[r]+seamDist) || (r < regionNum-1 && c >= bound[r+1]-seamDist))) continue;
+      tree->doQueryK(this->mesh.vert[i].cP(),16,pq);
+      int best = -1;
+      ScalarType bestDist = 0;
+      for(int j = 0; j < pq.getNofElements(); j++) {
+        const int w = pq.getIndex(j);
+        if(!inFace[w] || regionOf[w] == r) continue;
+        if(best == -1 || pq.getWeight(j) < bestDist) { best = w; bestDist = pq.getWeight(j); }
+      }
+      if(best == -1 || comp[best] == comp[i]) continue;
+      const ScalarType d = normal[i].dot(normal[best]);
+      if(d == 0) continue;
+      vote[std::make_pair(std::min(comp[i], comp[best]), std::max(comp[i], comp[best]))] += (d > 0) ? 1 : -1;
+    }
+    std::map<int, std::vector<std::pair<int,bool> > > link; // piece -> (piece, opposite orientation)
+    for(typename std::map<std::pair<int,int>, int>::iterator vi = vote.begin(); vi != vote.end(); ++vi)
+      if(vi->second != 0) {
+        link[vi->first.first].push_back(std::make_pair(vi->first.second, vi->second < 0));
+        link[vi->first.second].push_back(std::make_pair(vi->first.first, vi->second < 0));
+      }
+
+    // outwardness of each piece: sum of n.(barycenter of the face - baricenter)
+    std::map<int, ScalarType> outward;
+    for(int r = 0; r < regionNum; r++)
+      for(size_t i = 0; i < regionFace[r].size(); i += 3) {
+        const int *v = &regionFace[r][i];
+        const Point3x &p0 = this->mesh.vert[v[0]].cP(), &p1 = this->mesh.vert[v[1]].cP(), &p2 = this->mesh.vert[v[2]].cP();
+        outward[comp[v[0]]] += ((p1 - p0)^(p2 - p0)).dot((p0 + p1 + p2)/3 - baricenter);
+      }
+
+    // relative orientation inside each group of linked pieces, then the absolute one
+    std::map<int, bool> flip;
+    for(typename std::map<int, ScalarType>::iterator oi = outward.begin(); oi != outward.end(); ++oi) {
+      if(flip.count(oi->first)) continue;
+      std::vector<int> group(1, oi->first);
+      flip[oi->first] = false;
+      ScalarType groupOutward = 0;
+      for(size_t g = 0; g < group.size(); g++) {
+        const int cur = group[g];
+        groupOutward += flip[cur] ? -outward[cur] : outward[cur];
+        std::vector<std::pair<int,bool> > &adj = link[cur];
+        for(size_t a = 0; a < adj.size(); a++)
+          if(!flip.count(adj[a].first)) {
+            flip[adj[a].first] = flip[cur] != adj[a].second;
+            group.push_back(adj[a].first);
+          }
+      }
+      if(groupOutward < 0)
+        for(size_t g = 0; g < group.size(); g++) flip[group[g]] = !flip[group[g]];
+    }
+
+    for(int r = 0; r < regionNum; r++)
+      for(size_t i = 0; i < regionFace[r].size(); i += 3)
+        if(flip[comp[regionFace[r][i]]]) std::swap(regionFace[r][i+1], regionFace[r][i+2]);
+  }
+
+  // Pivots again the seam r of BuildMeshParallel, between the slabs r-1 and r, on a temporary mesh made of the points
+  // within seamWidth from it, starting from the faces of the two slabs that lie in the strip. Only the borders facing
+  // the seam are left in the front: the ones where the strip cuts the faces of the slabs, or around the holes of the
+  // sampling far from the seam, are dead from the start. All the faces of the strip are returned as global vertex indexes.
+  void BuildSeam(const std::vector<std::pair<ScalarType,int> > &sorted, const std::vector<ScalarType> &bound, int r, int axis,
+                 const std::vector<std::vector<int> > &regionFace, const std::vector<char> &used,
+                 std::vector<int> &faceVec) {
+    const ScalarType margin = 2*radius;
+    const ScalarType seamWidth = margin + 4*radius;
+    const int first = int(std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(bound[r]-seamWidth, -1)) - sorted.begin());
+    const int last = int(std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(bound[r]+seamWidth, -1)) - sorted.begin());
+    std::vector<int> l2g;
+    for(int i = first; i < last; i++) l2g.push_back(sorted[i].second);
+    std::sort(l2g.begin(), l2g.end());
+    if(l2g.size() <= 3) return;
+
+    std::vector<int> stripFace, curSide; // faces of the strip and their side (0 for the slab r-1, 1 for r, -1 new)
+    for(int s = r-1; s <= r; s++)
+      for(size_t i = 0; i < regionFace[s].size(); i += 3) {
+        int v[3];
+        for(int k = 0; k < 3; k++) {
+          std::vector<int>::const_iterator li = std::lower_bound(l2g.begin(), l2g.end(), regionFace[s][i+k]);
+          v[k] = (li != l2g.end() && *li == regionFace[s][i+k]) ? int(li - l2g.begin()) : -1;
+        }
+        if(v[0] >= 0 && v[1] >= 0 && v[2] >= 0) {
+          stripFace.insert(stripFace.end(), v, v+3);
+          curSide.push_back(s-r+1);
+        }
+      }
+
+    MESH sub;
+    Allocator<MESH>::AddVertices(sub, l2g.size());
+    std::vector<char> curUsed(l2g.size());
+    for(size_t i = 0; i < l2g.size(); i++) {
+      sub.vert[i].ImportData(this->mesh.vert[l2g[i]]);
+      curUsed[i] = used[l2g[i]];
+    }
+    BallPivoting<MESH> pivot(sub, *this);
+    pivot.RestartFront(stripFace, curUsed);
+    std::vector<char> inBand(l2g.size());
+    for(size_t i = 0; i < l2g.size(); i++)
+      inBand[i] = math::Abs(sub.vert[i].cP()[axis] - bound[r]) < margin + 2*radius;
+    std::vector<std::pair<int,int> > deadEdge;
+    for(std::list<FrontEdge>::iterator e = pivot.front.begin(); e != pivot.front.end(); ++e)
+      if(!inBand[(*e).v0] || !inBand[(*e).v1])
+        deadEdge.push_back(std::make_pair(std::min((*e).v0, (*e).v1), std::max((*e).v0, (*e).v1)));
+    std::sort(deadEdge.begin(), deadEdge.end());
+    // the front of the slab r-1 crosses the seam first, up to the borders of the slab r: two fronts advancing
+    // one against the other along the whole seam leave a line of holes where they meet. The front is then
+    // rebuilt from the borders left by the first one.
+    std::vector<char> lower(l2g.size());
+    for(size_t i = 0; i < l2g.size(); i++)
+      lower[i] = inBand[i] && sub.vert[i].cP()[axis] < bound[r];
+    pivot.KillEdges(deadEdge, lower);
+    pivot.BuildMesh();
+    std::vector<int> curFace;
+    for(size_t i = 0; i < sub.face.size(); i++)
+      for(int k = 0; k < 3; k++) curFace.push_back(int(tri::Index(sub, sub.face[i].cV(k))));
+    for(size_t i = 0; i < sub.vert.size(); i++) curUsed[i] = sub.vert[i].IsUserBit(usedBit);
+    pivot.RestartFront(curFace, curUsed);
+    pivot.KillEdges(deadEdge, std::vector<char>());
+    pivot.BuildMesh();
+
+    // where the fronts coming from the two sides of the seam meet they can leave small holes and pinched vertices:
+    // the new faces around them are dropped and pivoted again, this time by a single front around each hole,
+    // with a larger neighbourhood at each round. A round that does not reduce the defects is undone and ends
+    // the process: the defects left are mostly holes of the sampling crossing the seam.
+    curFace.clear();
+    for(size_t i = 0; i < sub.face.size(); i++)
+      for(int k = 0; k < 3; k++) curFace.push_back(int(tri::Index(sub, sub.face[i].cV(k))));
+    for(size_t i = 0; i < sub.vert.size(); i++) curUsed[i] = sub.vert[i].IsUserBit(usedBit);
+    curSide.resize(sub.face.size(), -1);
+    std::vector<char> zone;
+    int defectNum = SeamDefects(curFace, curSide, int(l2g.size()), deadEdge, zone);
+    for(int iter = 0; iter < 6 && defectNum > 0; iter++) {
+      for(int ring = 0; ring <= iter + 1; ring++) {
+        std::vector<char> grow = zone;
+        for(size_t i = 0; i < curFace.size(); i += 3)
+          if(zone[curFace[i]] || zone[curFace[i+1]] || zone[curFace[i+2]])
+            grow[curFace[i]] = grow[curFace[i+1]] = grow[curFace[i+2]] = 1;
+        zone.swap(grow);
+      }
+      // and the points left out of the faces inside it
+      std::vector<char> ref(sub.vert.size(), 0);
+      for(size_t i = 0; i < curFace.size(); i++) ref[curFace[i]] = 1;
+      std::vector<char> grow = zone;
+      typename KdTree<ScalarType>::PriorityQueue pq;
+      for(size_t i = 0; i < zone.size(); i++)
+        if(zone[i]) {
+          pivot.tree->doQueryK(sub.vert[i].cP(),16,pq);
+          for(int j = 0; j < pq.getNofElements(); j++)
+            if(!ref[pq.getIndex(j)]) grow[pq.getIndex(j)] = 1;
+        }
+      zone.swap(grow);
+      // the faces reaching the borders left out of the front are kept;
+      // only the borders of the holes left by the dropped ones are pivoted
+      std::vector<int> newFace, newSide;
+      std::vector<char> hole(sub.vert.size(), 0);
+      for(size_t i = 0; i < curFace.size(); i += 3)
+        if((!zone[curFace[i]] && !zone[curFace[i+1]] && !zone[curFace[i+2]]) ||
+           !inBand[curFace[i]] || !inBand[curFace[i+1]] || !inBand[curFace[i+2]]) {
+          newFace.insert(newFace.end(), curFace.begin()+i, curFace.begin()+i+3);
+          newSide.push_back(curSide[i/3]);
+        }
+        else hole[curFace[i]] = hole[curFace[i+1]] = hole[curFace[i+2]] = 1;
+      std::vector<char> newUsed(sub.vert.size());
+      for(size_t i = 0; i < zone.size(); i++) newUsed[i] = curUsed[i] && !zone[i];
+      pivot.RestartFront(newFace, newUsed);
+      pivot.KillEdges(deadEdge, hole);
+      pivot.BuildMesh();
+
+      newFace.clear();
+      for(size_t i = 0; i < sub.face.size(); i++)
+        for(int k = 0; k < 3; k++) newFace.push_back(int(tri::Index(sub, sub.face[i].cV(k))));
+      newSide.resize(sub.face.size(), -1);
+      const int newDefectNum = SeamDefects(newFace, newSide, int(l2g.size()), deadEdge, zone);
+      if(newDefectNum >= defectNum) break;
+      curFace.swap(newFace);
+      curSide.swap(newSide);
+      for(size_t i = 0; i < sub.vert.size(); i++) curUsed[i] = sub.vert[i].IsUserBit(usedBit);
+      defectNum = newDefectNum;
+    }
+
+    for(size_t i = 0; i < curFace.size(); i++)
+      faceVec.push_back(l2g[curFace[i]]);
+  }
+
+  // Reconstructs the slab r of BuildMeshParallel on a temporary mesh made of its points, in index order.
+  void BuildRegion(const std::vector<std::pair<ScalarType,int> > &sorted, const std::vector<int> &start,
+                   const std::vector<ScalarType> &bound, int r, int axis,
+                   std::vector<int> &faceVec, std::vector<int> &usedVec) {
+    const int regionNum = int(start.size())-1;
+    const bool first = (r == 0), last = (r == regionNum-1);
+    const ScalarType margin = 2*radius;
+    std::vector<int> l2g;
+    for(int i = start[r]; i < start[r+1]; i++) l2g.push_back(sorted[i].second);
+    std::sort(l2g.begin(), l2g.end());
+    if(l2g.size() <= 3) return;
+
+    MESH sub;
+    Allocator<MESH>::AddVertices(sub, l2g.size());
+    for(size_t i = 0; i < l2g.size(); i++)
+      sub.vert[i].ImportData(this->mesh.vert[l2g[i]]);
+
+    BallPivoting<MESH> pivot(sub, *this);
+    pivot.BuildMesh();
+
+    for(size_t i = 0; i < sub.face.size(); i++)
+      for(int k = 0; k < 3; k++)
+        faceVec.push_back(l2g[tri::Index(sub, sub.face[i].cV(k))]);
+    // processed points that cannot be reached by the fronts of the seams
+    for(size_t i = 0; i < l2g.size(); i++) {
+      ScalarType c = sub.vert[i].cP()[axis];
+      if((!first && c < bound[r]+margin) || (!last && c >= bound[r+1]-margin)) continue;
+      if(sub.vert[i].IsUserBit(usedBit)) usedVec.push_back(l2g[i]);
+    }
+  }
+
 
   /* returns the sphere touching p0, p1, p2 of radius r such that
      the normal of the face points toward the center of the sphere */
@@ -24,6 +24,10 @@
 #define __VCG_TRIVIAL_WALKER
 
 #include<vcg/space/index/grid_util.h>
+#include<vcg/complex/algorithms/create/marching_cubes.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace vcg {
 
@@ -218,7 +222,7 @@ private:
 
     bool Exist(const vcg::Point3i &p0, const vcg::Point3i &p1, VertexPointer &v)
     {
-        int pos = p0.X()+p0.Z()*_bbox.DimX();
+        int pos = (p0.X()-_bbox.min.X())+(p0.Z()-_bbox.min.Z())*_bbox.DimX();
         int vidx;
 
         if (p0.X()!=p1.X()) // punti allineati lungo l'asse X
@@ -356,6 +360,379 @@ protected:
 
     }
 };
+
+// Support for the parallel extraction: the volume is cut along Y in slabs of slices, each slab is
+// extracted by its own walker in its own mesh, then the slabs are joined in order.
+// Each slab (but the first) also re-runs the slice before it (pre-roll), so that when its first slice
+// is processed the vertices on the shared plane exist exactly as in a sequential visit; the pre-roll
+// faces are dropped and its vertices are merged with the ones of the previous slab.
+// In this way the joined mesh is the same, vertex by vertex and face by face, of the sequential one.
+template <class MeshType>
+class MCSlabs
+{
+public:
+  struct Slab
+  {
+    MeshType mesh;
+    size_t preVertNum;  // vertices (and faces) added by the pre-roll
+    size_t preFaceNum;
+    std::vector<std::pair<int,int> > first; // (edge key, vertex) of the pre-roll vertices on the first plane
+    std::vector<std::pair<int,int> > last;  // (edge key, vertex) on the plane after the last slice
+    Slab() : preVertNum(0), preFaceNum(0) {}
+  };
+
+  std::vector<Slab> slab;
+
+  /// Splits the slices [y0,y1) in slabs of slabSize slices (0 means a few slabs per thread).
+  void Init(int y0, int y1, int slabSize)
+  {
+    int threadNum = 1;
+#ifdef _OPENMP
+    threadNum = omp_get_max_threads();
+#endif
+    if(slabSize<=0) slabSize = std::max(8, (y1-y0 + 4*threadNum-1)/(4*threadNum));
+    start.clear();
+    for(int y=y0; y<y1; y+=slabSize)
+      start.push_back(y);
+    start.push_back(y1);
+    std::vector<Slab>(start.size()-1).swap(slab); // meshes cannot be copied
+  }
+
+  int SlabNum() const { return int(slab.size()); }
+  int Start(int i) const { return start[i]; }
+  int End(int i) const { return start[i+1]; }
+
+  /// Records the (edge key, vertex) pairs of the X and Z edges of a plane; keys are sorted.
+  static void Capture(const int *xIndex, const int *zIndex, int planeSize, std::vector<std::pair<int,int> > &list)
+  {
+    list.clear();
+    for(int i=0; i<planeSize; ++i)
+    {
+      if(xIndex[i]!=-1) list.push_back(std::make_pair(2*i  , xIndex[i]));
+      if(zIndex[i]!=-1) list.push_back(std::make_pair(2*i+1, zIndex[i]));
+    }
+  }
+
+  /// Joins the slabs in m; the slab meshes are cleared.
+  void Join(MeshType &m)
+  {
+    const int sn = SlabNum();
+    std::vector<size_t> vertBase(sn+1,0), faceBase(sn+1,0);
+    for(int s=0; s<sn; ++s)
+    {
+      vertBase[s+1] = vertBase[s] + slab[s].mesh.vert.size() - slab[s].preVertNum;
+      faceBase[s+1] = faceBase[s] + slab[s].mesh.face.size() - slab[s].preFaceNum;
+    }
+
+    // global index of every slab vertex, -1 for the dropped pre-roll ones
+    std::vector<std::vector<int> > remap(sn);
+#pragma omp parallel for schedule(dynamic,1)
+    for(int s=0; s<sn; ++s)
+    {
+      remap[s].assign(slab[s].mesh.vert.size(), -1);
+      for(size_t i=slab[s].preVertNum; i<slab[s].mesh.vert.size(); ++i)
+        remap[s][i] = int(vertBase[s] + i - slab[s].preVertNum);
+    }
+#pragma omp parallel for schedule(dynamic,1)
+    for(int s=1; s<sn; ++s)
+    {
+      const std::vector<std::pair<int,int> > &a = slab[s].first, &b = slab[s-1].last;
+      size_t j=0;
+      for(size_t i=0; i<a.size(); ++i)
+      {
+        while(j<b.size() && b[j].first<a[i].first) ++j;
+        if(j<b.size() && b[j].first==a[i].first)
+          remap[s][a[i].second] = remap[s-1][b[j].second];
+      }
+    }
+
+    m.Clear();
+    Allocator<MeshType>::AddVertices(m, vertBase[sn]);
+    Allocator<MeshType>::AddFaces(m, faceBase[sn]);
+#pragma omp parallel for schedule(dynamic,1)
+    for(int s=0; s<sn; ++s)
+    {
+      MeshType &sm = slab[s].mesh;
+      for(size_t i=slab[s].preVertNum; i<sm.vert.size(); ++i)
+        m.vert[remap[s][i]].ImportData(sm.vert[i]);
+      for(size_t i=slab[s].preFaceNum; i<sm.face.size(); ++i)
+      {
+        typename MeshType::FaceType &f = m.face[faceBase[s] + i - slab[s].preFaceNum];
+        for(int j=0; j<3; ++j)
+        {
+          const int vi = remap[s][tri::Index(sm, sm.face[i].V(j))];
+          assert(vi!=-1);
+          f.V(j) = &m.vert[vi];
+        }
+      }
+      sm.Clear();
+    }
+  }
+
+private:
+  std::vector<int> start;
+};
+
+// Multithreaded version of the TrivialWalker: the slabs are extracted in parallel and joined
+// (see MCSlabs) so the result is the same of TrivialWalker with MarchingCubes, for any number of threads.
+// Before being processed the cells are classified with the signs of the field, computed once
+// per voxel on whole planes, and the cells where the field does not change sign are skipped.
+// The volume is accessed concurrently, so its Val, ValidCell and Get?Intercept must be thread safe.
+// For sparse volumes SetActiveBlocks restricts the whole visit to the blocks that hold data.
+template <class MeshType, class VolumeType>
+class ParallelTrivialWalker
+{
+public:
+  int SlabSize; // slices of each slab, 0 means automatic
+
+  ParallelTrivialWalker() : SlabSize(0) { _bbox.SetNull(); }
+
+  // SetExtractionBox set the portion of the volume to be traversed
+  void SetExtractionBox(Box3i subbox) { _bbox = subbox; }
+
+  // Visit only the voxels and the cells (by their first corner) inside the given disjoint boxes,
+  // e.g. the allocated blocks of a Volume (see Volume::AllocatedBlocks); the cells starting
+  // outside them must not be valid. An empty vector means the whole extraction box.
+  void SetActiveBlocks(const std::vector<Box3i> &blocks) { _blocks = blocks; }
+
+  void BuildMesh(MeshType &mesh, VolumeType &volume, const float threshold, vcg::CallBackPos * cb=0)
+  {
+    if(_bbox.IsNull())
+      _bbox = Box3i(Point3i(0,0,0),volume.ISize());
+    mesh.Clear();
+    // the same slices visited by TrivialWalker::BuildMesh
+    const int y0 = _bbox.min.Y(), y1 = (_bbox.max.Y()-1)-1;
+    if(y1<=y0) return;
+
+    // for each plane, the active blocks that cross it
+    std::vector<std::vector<int> > planeBlocks;
+    if(!_blocks.empty())
+    {
+      planeBlocks.resize(_bbox.DimY());
+      for(size_t b=0; b<_blocks.size(); ++b)
+        for(int y=std::max(_blocks[b].min.Y(),_bbox.min.Y()); y<std::min(_blocks[b].max.Y(),_bbox.max.Y()); ++y)
+          planeBlocks[y-_bbox.min.Y()].push_back(int(b));
+    }
+
+    MCSlabs<MeshType> slabs;
+    slabs.Init(y0, y1, SlabSize);
+    if(cb) cb(0,"Marching volume");
+#pragma omp parallel
+    {
+      SlabWalker walker(_bbox, _blocks, planeBlocks);
+#pragma omp for schedule(dynamic,1)
+      for(int s=0; s<slabs.SlabNum(); ++s)
+        walker.Extract(volume, threshold, slabs.Start(s), slabs.End(s), slabs.slab[s]);
+    }
+    if(cb) cb(90,"Joining slabs");
+    slabs.Join(mesh);
+  }
+
+private:
+  Box3i _bbox;
+  std::vector<Box3i> _blocks;
+
+  class SlabWalker : public TrivialWalker<MeshType, VolumeType>
+  {
+    typedef TrivialWalker<MeshType, VolumeType> Base;
+  public:
+    SlabWalker(const Box3i &bbox, const std::vector<Box3i> &blocks, const std::vector<std::vector<int> > &planeBlocks)
+      : _blocks(blocks), _planeBlocks(planeBlocks)
+    {
+      this->SetExtractionBox(bbox);
+      _sign_cs.resize(this->_slice_dimension);
+      _sign_ns.resize(this->_slice_dimension);
+      _cell.resize(this->_slice_dimension);
+    }
+    ~SlabWalker()
+    {
+      delete [] this->_x_cs; delete [] this->_y_cs; delete [] this->_z_cs;
+      delete [] this->_x_ns; delete [] this->_z_ns;
+    }
+
+    void Extract(VolumeType &volume, const float threshold, int y0, int y1, typename MCSlabs<MeshType>::Slab &slab)
+    {
+      this->_volume = &volume;
+      this->_mesh   = &slab.mesh;
+      this->_thr    = threshold;
+      MarchingCubes<MeshType, SlabWalker> extractor(slab.mesh, *this);
+      extractor.Initialize();
+      this->Begin();
+
+      const bool preRoll = (y0 > this->_bbox.min.Y());
+      this->_current_slice = preRoll ? y0-1 : y0;
+      ComputeSigns(this->_current_slice, _sign_cs);
+      if(preRoll)
+      {
+        ProcessSlice(extractor);
+        this->NextYSlice();
+        MCSlabs<MeshType>::Capture(this->_x_cs, this->_z_cs, this->_slice_dimension, slab.first);
+      }
+      slab.preVertNum = slab.mesh.vert.size();
+      slab.preFaceNum = slab.mesh.face.size();
+
+      for(int j=y0; j<y1; ++j)
+      {
+        ProcessSlice(extractor);
+        if(j==y1-1)
+          MCSlabs<MeshType>::Capture(this->_x_ns, this->_z_ns, this->_slice_dimension, slab.last);
+        this->NextYSlice();
+      }
+      extractor.Finalize();
+      this->_volume = NULL;
+      this->_mesh   = NULL;
+    }
+
+  private:
+    std::vector<unsigned char> _sign_cs, _sign_ns, _cell;
+    const std::vector<Box3i> &_blocks;
+    const std::vector<std::vector<int> > &_planeBlocks; // empty: visit the whole planes
+    std::vector<int> _mixed;
+
+    static const std::vector<int> &NoBlocks() { static std::vector<int> none; return none; }
+
+    // the active blocks crossing the plane y
+    const std::vector<int> &PlaneBlocks(int y) const
+    {
+      const int py = y - this->_bbox.min.Y();
+      return (py>=0 && py<int(_planeBlocks.size())) ? _planeBlocks[py] : NoBlocks();
+    }
+
+    // sign of the field on the voxels of plane y that are corners of some visited cell;
+    // with active blocks only the voxels inside them are computed (the others are left unchanged:
+    // the cells with such a corner are not valid)
+    void ComputeSigns(int y, std::vector<unsigned char> &sign)
+    {
+      const Box3i &b = this->_bbox;
+      if(_planeBlocks.empty())
+      {
+        ComputeSigns(y, sign, b.min.X(), b.max.X()-1, b.min.Z(), b.max.Z()-1);
+        return;
+      }
+      const std::vector<int> &pb = PlaneBlocks(y);
+      for(size_t t=0; t<pb.size(); ++t)
+      {
+        const Box3i &a = _blocks[pb[t]];
+        ComputeSigns(y, sign, std::max(a.min.X(),b.min.X()), std::min(a.max.X(),b.max.X()-1),
+                              std::max(a.min.Z(),b.min.Z()), std::min(a.max.Z(),b.max.Z()-1));
+      }
+    }
+
+    void ComputeSigns(int y, std::vector<unsigned char> &sign, int x0, int x1, int z0, int z1)
+    {
+      const Box3i &b = this->_bbox;
+      const int dx = b.DimX();
+      for(int k=z0; k<z1; ++k)
+      {
+        unsigned char *row = &sign[(k-b.min.Z())*dx];
+        for(int i=x0; i<x1; ++i)
+          row[i-b.min.X()] = (this->V(i,y,k)>0) ? 1 : 0;
+      }
+    }
+
+    // a cell is crossed by the surface if the signs of its corners are not all equal
+    void ClassifyCells(int x0, int x1, int z0, int z1)
+    {
+      const Box3i &b = this->_bbox;
+      const int dx = b.DimX();
+      for(int k=z0; k<z1; ++k)
+      {
+        const int r = (k-b.min.Z())*dx + (x0-b.min.X());
+        const unsigned char *c0 = &_sign_cs[r], *c1 = &_sign_cs[r+dx];
+        const unsigned char *n0 = &_sign_ns[r], *n1 = &_sign_ns[r+dx];
+        unsigned char *cell = &_cell[r];
+        const int n = x1-x0;
+        for(int i=0; i<n; ++i)
+        {
+          const int cnt = c0[i]+c0[i+1]+c1[i]+c1[i+1]+n0[i]+n0[i+1]+n1[i]+n1[i+1];
+          cell[i] = (cnt!=0 && cnt!=8) ? 1 : 0;
+        }
+      }
+    }
+
+    // With active blocks only the vertex indexes written by the cells of the active blocks of
+    // the last two planes are reset, instead of the whole slice.
+    void NextYSlice()
+    {
+      if(_planeBlocks.empty())
+      {
+        Base::NextYSlice();
+        return;
+      }
+      const Box3i &b = this->_bbox;
+      const int dx = b.DimX();
+      for(int y=this->_current_slice-1; y<=this->_current_slice; ++y)
+      {
+        const std::vector<int> &pb = PlaneBlocks(y);
+        for(size_t t=0; t<pb.size(); ++t)
+        {
+          const Box3i &a = _blocks[pb[t]];
+          const int x0 = std::max(a.min.X(),b.min.X()), x1 = std::min(a.max.X()+1,b.max.X());
+          const int z0 = std::max(a.min.Z(),b.min.Z()), z1 = std::min(a.max.Z()+1,b.max.Z());
+          for(int k=z0; k<z1; ++k)
+          {
+            const int r = (k-b.min.Z())*dx + (x0-b.min.X());
+            std::fill(this->_x_cs+r, this->_x_cs+r+(x1-x0), -1);
+            std::fill(this->_y_cs+r, this->_y_cs+r+(x1-x0), -1);
+            std::fill(this->_z_cs+r, this->_z_cs+r+(x1-x0), -1);
+          }
+        }
+      }
+      std::swap(this->_x_cs, this->_x_ns);
+      std::swap(this->_z_cs, this->_z_ns);
+      this->_current_slice += 1;
+    }
+
+    template<class EXTRACTOR_TYPE>
+    void ProcessSlice(EXTRACTOR_TYPE &extractor)
+    {
+      const Box3i &b = this->_bbox;
+      const int dx = b.DimX();
+      const int j = this->_current_slice;
+      ComputeSigns(j+1, _sign_ns);
+
+      if(_planeBlocks.empty())
+      {
+        ClassifyCells(b.min.X(), (b.max.X()-1)-1, b.min.Z(), (b.max.Z()-1)-1);
+        for(int i=b.min.X(); i<(b.max.X()-1)-1; ++i)
+          for(int k=b.min.Z(); k<(b.max.Z()-1)-1; ++k)
+            if(_cell[(i-b.min.X())+(k-b.min.Z())*dx])
+              ProcessCell(extractor, i, j, k);
+      }
+      else
+      {
+        // collect the crossed cells of the active blocks and visit them in the sequential order (x, then z)
+        const int dz = b.DimZ();
+        _mixed.clear();
+        const std::vector<int> &pb = PlaneBlocks(j);
+        for(size_t t=0; t<pb.size(); ++t)
+        {
+          const Box3i &a = _blocks[pb[t]];
+          const int x0 = std::max(a.min.X(),b.min.X()), x1 = std::min(a.max.X(),(b.max.X()-1)-1);
+          const int z0 = std::max(a.min.Z(),b.min.Z()), z1 = std::min(a.max.Z(),(b.max.Z()-1)-1);
+          ClassifyCells(x0, x1, z0, z1);
+          for(int k=z0; k<z1; ++k)
+            for(int i=x0; i<x1; ++i)
+              if(_cell[(i-b.min.X())+(k-b.min.Z())*dx])
+                _mixed.push_back((i-b.min.X())*dz + (k-b.min.Z()));
+        }
+        std::sort(_mixed.begin(), _mixed.end());
+        for(size_t t=0; t<_mixed.size(); ++t)
+          ProcessCell(extractor, b.min.X() + _mixed[t]/dz, j, b.min.Z() + _mixed[t]%dz);
+      }
+      _sign_cs.swap(_sign_ns);
+    }
+
+    template<class EXTRACTOR_TYPE>
+    void ProcessCell(EXTRACTOR_TYPE &extractor, int i, int j, int k)
+    {
+      Point3i p1(i,j,k);
+      Point3i p2(i+1,j+1,k+1);
+      if(this->_volume->ValidCell(p1,p2))
+        extractor.ProcessCell(p1, p2);
+    }
+  };
+};
 } // end namespace tri
 } // end namespace vcg
 #endif // __VCGTEST_WALKER
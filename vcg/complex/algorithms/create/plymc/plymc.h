@@ -52,7 +52,11 @@
 #include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric.h>
 
 #include <stdarg.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "volume.h"
+#include "sparse_volume.h"
 #include "tri_edge_collapse_mc.h"
 namespace vcg {
 namespace tri {
@@ -69,9 +73,11 @@ int MCSimplify( MeshType &m, float perc, bool preserveBB=true, vcg::CallBackPos
  *  IT is the surface reconstrction algorithm that have been used for a long time inside the ISTI-Visual Computer Lab.
  *  It is mostly a variant of the Curless et al. e.g. a volumetric approach with some original weighting schemes,"
  *  a different expansion rule, and another approach to hole filling through volume dilation/relaxations.
+ *  The volume type can be either Volume<Voxelfc> or SparseVolume<Voxelfc>; the latter keeps in memory
+ *  only the blocks around the surface, useful for thin scans inside large bounding boxes.
  */
 
-template < class SMesh, class MeshProvider>
+template < class SMesh, class MeshProvider, class VolumeType = Volume<Voxelfc> >
 class PlyMC
 {
 public:
@@ -132,6 +138,8 @@ public:
       SimplificationFlag=false;
       VertSplatFlag=false;
       MergeColor=false;
+      ParallelMCFlag=false;
+      ParallelSubVolumeNum=1;
       basename = "plymcout";
     }
 
@@ -164,15 +172,20 @@ public:
     bool SimplificationFlag;
     bool VertSplatFlag;
     bool MergeColor;
+    bool ParallelMCFlag; // extract the surface with the ParallelTrivialWalker (same result, multithreaded)
+    int ParallelSubVolumeNum; // subvolumes processed at the same time; each one keeps in memory its volumes and a copy of the mesh being added
     std::string basename;
     std::vector<std::string> OutNameVec;
     std::vector<std::string> OutNameSimpVec;
   }; //end Parameter class
 
+  // Volume used to rasterize a part of a mesh in parallel (see ScanMesh)
+  typedef Volume<typename VolumeType::voxel_type, typename VolumeType::scalar, HashBlockIndex> SlabVolume;
+
   /// PLYMC Data
   MeshProvider MP;
   Parameter p;
-  Volume<Voxelf> VV;
+  VolumeType VV;
   char errorMessage[1024];
 
 /// PLYMC Methods
@@ -252,17 +265,22 @@ public:
   // This function add a mesh (or a point cloud to the volume)
 // the point cloud MUST have normalized vertex normals.
     bool AddMeshToVolumeM(SMesh &m, std::string meshname, const double w )
+    {
+      return AddMeshToVolumeM(m,meshname,w,VV);
+    }
+
+    // Same of above, the mesh is added to the volume V
+    bool AddMeshToVolumeM(SMesh &m, std::string meshname, const double w, VolumeType &V )
     {
       tri::RequireCompactness(m);
-      if(!m.bbox.Collide(VV.SubBoxSafe)) return false;
+      if(!m.bbox.Collide(V.SubBoxSafe)) return false;
       size_t found =meshname.find_last_of("/\\");
       std::string shortname = meshname.substr(found+1);
 
-      Volume <Voxelf> B;
-      B.Init(VV);
+      VolumeType B;
+      B.Init(V);
 
       bool res=false;
-      double quality=0;
 
       // Now add the mesh to the volume
       if(!p.VertSplatFlag)
@@ -282,25 +300,13 @@ public:
             // Classical approach: scan each face
             int tt0=clock();
             printf("---- Face Rasterization");
-            for(SFaceIterator fi=m.face.begin(); fi!=m.face.end();++fi)
-                {
-                    if(closed || (p.PLYFileQualityFlag==false && p.GeodesicQualityFlag==false)) quality=1.0;
-                    else quality=w*(*fi).Q();
-                    if(quality)
-                            res |= B.ScanFace((*fi).V(0)->P(),(*fi).V(1)->P(),(*fi).V(2)->P(),quality,(*fi).N());
-                }
+            res = ScanMesh(m,B,w,closed);
             printf(" : %li\n",clock()-tt0);
 
     } else
     {	// Splat approach add only the vertices to the volume
         printf("Vertex Splatting\n");
-        for(SVertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
-                {
-                    if(p.PLYFileQualityFlag==false) quality=1.0;
-                    else quality=w*(*vi).Q();
-                    if(quality)
-                        res |= B.SplatVert((*vi).P(),quality,(*vi).N(),(*vi).C());
-                }
+        res = ScanMesh(m,B,w,false);
     }
     if(!res) return false;
 
@@ -317,8 +323,8 @@ public:
         if(p.VerboseLevel>1) B.SlicedPPM(shortname.c_str(),SFormat("%02if",vstp++),p.SliceNum	);
         if(p.IntraSmoothFlag)
         {
-            Volume <Voxelf> SM;
-            SM.Init(VV);
+            VolumeType SM;
+            SM.Init(V);
             SM.CopySmooth(B,1,p.QualitySmoothAbs);
             B=SM;
             if(p.VerboseLevel>1) B.SlicedPPM(shortname.c_str(),SFormat("%02is",vstp++),p.SliceNum	);
@@ -327,17 +333,90 @@ public:
     }
     if(p.SmoothNum>0)
         {
-            Volume <Voxelf> SM;
-            SM.Init(VV);
+            VolumeType SM;
+            SM.Init(V);
             SM.CopySmooth(B,1,p.QualitySmoothAbs);
             B=SM;
             if(p.VerboseLevel>1) B.SlicedPPM(shortname.c_str(),SFormat("%02isf",vstp++),p.SliceNum	);
         }
-    VV.Merge(B);
-    if(p.VerboseLevel>0) VV.SlicedPPMQ(std::string("merge_").c_str(),shortname.c_str(),p.SliceNum	);
+    V.Merge(B);
+    if(p.VerboseLevel>0) V.SlicedPPMQ(std::string("merge_").c_str(),shortname.c_str(),p.SliceNum	);
     return true;
 }
 
+  // Rasterizes the faces (or splats the vertices) of m in the empty volume B.
+  // With one thread it is rasterized directly. With more threads the safe subpart is cut along z
+  // in slabs of whole blocks: each slab is rasterized by a thread in its own sparse volume, that writes only the voxels of the slab,
+  // and then its blocks are moved in B. Every voxel receives the same values, in the same order,
+  // of the sequential rasterization, so the result does not depend on the number of threads.
+  bool ScanMesh(SMesh &m, VolumeType &B, const double w, const bool closed)
+  {
+    int threadNum=1;
+#ifdef _OPENMP
+    if(!omp_in_parallel()) threadNum=omp_get_max_threads();
+#endif
+    const int bs=VolumeType::BLOCKSIDE();
+    const int z0=B.SubPartSafe.min[2], z1=B.SubPartSafe.max[2];
+    if(threadNum<=1)
+      return ScanMesh(m,B,w,closed,z0,z1);
+    const int blockNum=(z1-z0+bs-1)/bs;
+    const int slabNum=std::min(blockNum,2*threadNum);
+    if(slabNum<=1)
+      return ScanMesh(m,B,w,closed,z0,z1);
+
+    std::vector<SlabVolume> slab(slabNum);
+    int res=0;
+#pragma omp parallel for schedule(dynamic,1) reduction(+: res)
+    for(int s=0;s<slabNum;++s)
+    {
+      slab[s].Init(B);
+      slab[s].ScanBox.min[2]=z0+bs*(s*blockNum/slabNum);
+      slab[s].ScanBox.max[2]=std::min(z1,z0+bs*((s+1)*blockNum/slabNum));
+      if(ScanMesh(m,slab[s],w,closed,slab[s].ScanBox.min[2],slab[s].ScanBox.max[2])) ++res;
+    }
+    for(int s=0;s<slabNum;++s)
+    {
+      B.MoveBlocks(slab[s]);
+      slab[s]=SlabVolume();
+    }
+    return res>0;
+  }
+
+  // Adds to V the faces (or the vertices) of m that can write some voxel in the z range [z0,z1)
+  template <class VOL>
+  bool ScanMesh(SMesh &m, VOL &V, const double w, const bool closed, const int z0, const int z1)
+  {
+    bool res=false;
+    double quality=0;
+    if(!p.VertSplatFlag)
+    {
+      // along z the intercepts are written from WN to WP voxels around the face
+      const int zlo=std::min(V.WN,0)-1, zhi=std::max(V.WP,0)+1;
+      for(SFaceIterator fi=m.face.begin(); fi!=m.face.end();++fi)
+          {
+              if(closed || (p.PLYFileQualityFlag==false && p.GeodesicQualityFlag==false)) quality=1.0;
+              else quality=w*(*fi).Q();
+              const float fz0=std::min((*fi).V(0)->P()[2],std::min((*fi).V(1)->P()[2],(*fi).V(2)->P()[2]));
+              const float fz1=std::max((*fi).V(0)->P()[2],std::max((*fi).V(1)->P()[2],(*fi).V(2)->P()[2]));
+              if(floor(fz1)+zhi < z0 || floor(fz0)+zlo >= z1) continue;
+              if(quality)
+                      res |= V.ScanFace((*fi).V(0)->P(),(*fi).V(1)->P(),(*fi).V(2)->P(),quality,(*fi).N());
+          }
+    }
+    else
+    {
+      for(SVertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+          {
+              if(p.PLYFileQualityFlag==false) quality=1.0;
+              else quality=w*(*vi).Q();
+              if(floor((*vi).P()[2])+1 < z0 || floor((*vi).P()[2]) >= z1) continue;
+              if(quality)
+                  res |= V.SplatVert((*vi).P(),quality,(*vi).N(),(*vi).C());
+          }
+    }
+    return res;
+  }
+
 bool Process(vcg::CallBackPos *cb=0)
 {
   sprintf(errorMessage,"");
@@ -364,7 +443,7 @@ bool Process(vcg::CallBackPos *cb=0)
   else cells = (__int64)(voxdim[0]/p.VoxSize) * (__int64)(voxdim[1]/p.VoxSize) *(__int64)(voxdim[2]/p.VoxSize) ;
 
   {
-    Volume<Voxelf> B; // local to this small block
+    VolumeType B; // local to this small block
 
     Box3f fullbf; fullbf.Import(fullb);
     B.Init(cells,fullbf,p.IDiv,p.IPosS);
@@ -379,160 +458,224 @@ bool Process(vcg::CallBackPos *cb=0)
 
   int TotAdd=0,TotMC=0,TotSav=0; // partial timings counter
 
+  // the subvolumes to be processed, in the usual order
+  std::vector<Point3i> subVec;
   for(p.IPos[0]=p.IPosS[0];p.IPos[0]<=p.IPosE[0];++p.IPos[0])
     for(p.IPos[1]=p.IPosS[1];p.IPos[1]<=p.IPosE[1];++p.IPos[1])
       for(p.IPos[2]=p.IPosS[2];p.IPos[2]<=p.IPosE[2];++p.IPos[2])
         if((p.IPos[2]+(p.IPos[1]*p.IDiv[2])+(p.IPos[0]*p.IDiv[2]*p.IDiv[1])) >=
            (p.IPosB[2]+(p.IPosB[1]*p.IDiv[2])+(p.IPosB[0]*p.IDiv[2]*p.IDiv[1]))) // skip until IPos >= IPosB
+          subVec.push_back(p.IPos);
+        else
         {
-          printf("----------- SubBlock %2i %2i %2i ----------\n",p.IPos[0],p.IPos[1],p.IPos[2]);
-          //Volume<Voxelf> B;
-          int t0=clock();
+          printf("----------- skipping SubBlock %2i %2i %2i ----------\n",p.IPos[0],p.IPos[1],p.IPos[2]);
+        }
 
-          Box3f fullbf; fullbf.Import(fullb);
+  const int subNum=int(subVec.size());
+  const int parNum=std::min(p.ParallelSubVolumeNum,subNum);
+  if(parNum<=1)
+  {
+    for(int s=0;s<subNum;++s)
+    {
+      if(!ProcessSubVolume(subVec[s],VV,false,cells,fullb,saveMask,TotAdd,TotMC,TotSav,p.OutNameVec,p.OutNameSimpVec,cb))
+        return false;
+    }
+    return true;
+  }
 
-          VV.Init(cells,fullbf,p.IDiv,p.IPos);
-          printf("\n\n --------------- Allocated subcells. %i\n",VV.Allocated());
+  // Independent subvolumes are processed in parallel, at most parNum at the same time:
+  // each thread has its own volumes and works on its own copies of the meshes, while the mesh provider
+  // (and its cache) is accessed by one thread at a time. VV keeps the grid used to interize the meshes.
+  Box3f fullbf; fullbf.Import(fullb);
+  VV.Init(cells,fullbf,p.IDiv,subVec[0]);
+  std::vector< std::vector<std::string> > outName(subNum), outSimpName(subNum);
+  int failNum=0;
+#pragma omp parallel for num_threads(parNum) schedule(dynamic,1) reduction(+: failNum)
+  for(int s=0;s<subNum;++s)
+  {
+    VolumeType V;
+    if(!ProcessSubVolume(subVec[s],V,true,cells,fullb,saveMask,TotAdd,TotMC,TotSav,outName[s],outSimpName[s],0))
+      ++failNum;
+  }
+  for(int s=0;s<subNum;++s)
+  {
+    p.OutNameVec.insert(p.OutNameVec.end(),outName[s].begin(),outName[s].end());
+    p.OutNameSimpVec.insert(p.OutNameSimpVec.end(),outSimpName[s].begin(),outSimpName[s].end());
+  }
+  return failNum==0;
+}
 
-          std::string filename=p.basename;
-          if(p.IDiv!=Point3i(1,1,1))
-          {
-            std::string subvoltag;
-            VV.GetSubVolumeTag(subvoltag);
-            filename+=subvoltag;
-          }
-          /********** Grande loop di scansione di tutte le mesh *********/
-          bool res=false;
-          if(!cb) printf("Step 1: Converting meshes into volume\n");
-          for(int i=0;i<MP.size();++i)
-          {
-            Box3f bbb= MP.bb(i);
-            /**********************/
-            if(cb) cb((i+1)/MP.size(),"Step 1: Converting meshes into volume");
-            /**********************/
-            // if bbox of mesh #i is part of the subblock, then process it
-            if(bbb.Collide(VV.SubBoxSafe))
-            {
-              SMesh *sm;
-              if(!MP.Find(i,sm) )
-              {
-                res = InitMesh(*sm,MP.MeshName(i).c_str(),MP.Tr(i));
-                if(!res)
-                {
-                  sprintf(errorMessage,"%sFailed Init of mesh %s\n",errorMessage,MP.MeshName(i).c_str());
-                  return false ;
-                }
-              }
-              res |= AddMeshToVolumeM(*sm, MP.MeshName(i),MP.W(i));
-            }
-          }
+// Builds the volume V of the subvolume ipos with all the meshes that touch it and extracts its surface.
+// With copyMesh each mesh is copied from the provider, so that more subvolumes can be processed at the same time.
+bool ProcessSubVolume(Point3i ipos, VolumeType &V, bool copyMesh, __int64 cells, Box3f fullb, int saveMask,
+                      int &TotAdd, int &TotMC, int &TotSav,
+                      std::vector<std::string> &outNameVec, std::vector<std::string> &outNameSimpVec,
+                      vcg::CallBackPos *cb)
+{
+  printf("----------- SubBlock %2i %2i %2i ----------\n",ipos[0],ipos[1],ipos[2]);
+  //Volume<Voxelf> B;
+  int t0=clock();
 
-          //B.Normalize(1);
-          printf("End Scanning\n");
-          if(p.OffsetFlag)
-          {
-            VV.Offset(p.OffsetThr);
-            if (p.VerboseLevel>0)
-            {
-              VV.SlicedPPM("finaloff","__",p.SliceNum);
-              VV.SlicedPPMQ("finaloff","__",p.SliceNum);
-            }
-          }
-          //if(p.VerboseLevel>1) VV.SlicedPPM(filename.c_str(),SFormat("_%02im",i),p.SliceNum	);
+  Box3f fullbf; fullbf.Import(fullb);
 
-          for(int i=0;i<p.RefillNum;++i)
-          {
-            VV.Refill(3,6);
-            if(p.VerboseLevel>1) VV.SlicedPPM(filename.c_str(),SFormat("_%02imsr",i),p.SliceNum	);
-            //if(VerboseLevel>1) VV.SlicedPPMQ(filename,SFormat("_%02ips",i++),SliceNum	);
-          }
+  V.Init(cells,fullbf,p.IDiv,ipos);
+  printf("\n\n --------------- Allocated subcells. %i\n",V.Allocated());
 
-          for(int i=0;i<p.SmoothNum;++i)
-          {
-            Volume <Voxelf> SM;
-            SM.Init(VV);
-            printf("%2i/%2i: ",i,p.SmoothNum);
-            SM.CopySmooth(VV,1,p.QualitySmoothAbs);
-            VV=SM;
-            VV.Refill(3,6);
-            if(p.VerboseLevel>1) VV.SlicedPPM(filename.c_str(),SFormat("_%02ims",i),p.SliceNum	);
-          }
+  std::string filename=p.basename;
+  if(p.IDiv!=Point3i(1,1,1))
+  {
+    std::string subvoltag;
+    V.GetSubVolumeTag(subvoltag);
+    filename+=subvoltag;
+  }
+  /********** Grande loop di scansione di tutte le mesh *********/
+  bool res=false;
+  if(!cb) printf("Step 1: Converting meshes into volume\n");
+  for(int i=0;i<MP.size();++i)
+  {
+    Box3f bbb= MP.bb(i);
+    /**********************/
+    if(cb) cb((i+1)/MP.size(),"Step 1: Converting meshes into volume");
+    /**********************/
+    // if bbox of mesh #i is part of the subblock, then process it
+    if(bbb.Collide(V.SubBoxSafe))
+    {
+      SMesh *sm;
+      SMesh lm;
+      bool ok=true;
+#pragma omp critical (PlyMCMeshProvider)
+      {
+        if(!MP.Find(i,sm) )
+        {
+          ok = res = InitMesh(*sm,MP.MeshName(i).c_str(),MP.Tr(i));
+          if(!ok)
+            sprintf(errorMessage,"%sFailed Init of mesh %s\n",errorMessage,MP.MeshName(i).c_str());
+        }
+        if(ok && copyMesh)
+          tri::Append<SMesh,SMesh>::MeshCopy(lm,*sm);
+      }
+      if(!ok) return false ;
+      if(copyMesh) sm=&lm;
+      res |= AddMeshToVolumeM(*sm, MP.MeshName(i),MP.W(i),V);
+    }
+  }
 
-          int t1=clock();  //--------
-          TotAdd+=t1-t0;
-          printf("Extracting surface...\r");
-          if (p.VerboseLevel>0)
-          {
-            VV.SlicedPPM("final","__",p.SliceNum);
-            VV.SlicedPPMQ("final","__",p.SliceNum);
-          }
-          MCMesh me;
-          if(res)
-          {
-            typedef vcg::tri::TrivialWalker<MCMesh, Volume <Voxelf> >	  Walker;
-            typedef vcg::tri::MarchingCubes<MCMesh, Walker>             MarchingCubes;
-
-            Walker walker;
-            MarchingCubes	mc(me, walker);
-            /**********************/
-            if(cb) cb(50,"Step 2: Marching Cube...");
-            else printf("Step 2: Marching Cube...\n");
-            /**********************/
-            walker.SetExtractionBox(VV.SubPartSafe);
-            walker.BuildMesh(me,VV,mc,0);
-
-            typename MCMesh::VertexIterator vi;
-            Box3f bbb; bbb.Import(VV.SubPart);
-            for(vi=me.vert.begin();vi!=me.vert.end();++vi)
-            {
-              if(!bbb.IsIn((*vi).P()))
-                vcg::tri::Allocator< MCMesh >::DeleteVertex(me,*vi);
-              VV.DeInterize((*vi).P());
-            }
-            for (typename MCMesh::FaceIterator fi = me.face.begin(); fi != me.face.end(); ++fi)
-            {
-              if((*fi).V(0)->IsD() || (*fi).V(1)->IsD() || (*fi).V(2)->IsD() )
-                vcg::tri::Allocator< MCMesh >::DeleteFace(me,*fi);
-              else std::swap((*fi).V1(0), (*fi).V2(0));
-            }
+  //B.Normalize(1);
+  printf("End Scanning\n");
+  if(p.OffsetFlag)
+  {
+    V.Offset(p.OffsetThr);
+    if (p.VerboseLevel>0)
+    {
+      V.SlicedPPM("finaloff","__",p.SliceNum);
+      V.SlicedPPMQ("finaloff","__",p.SliceNum);
+    }
+  }
+  //if(p.VerboseLevel>1) V.SlicedPPM(filename.c_str(),SFormat("_%02im",i),p.SliceNum	);
 
-            int t2=clock();  //--------
-            TotMC+=t2-t1;
-            if(me.vn >0 || me.fn >0)
-            {
-              p.OutNameVec.push_back(filename+std::string(".ply"));
-              tri::io::ExporterPLY<MCMesh>::Save(me,p.OutNameVec.back().c_str(),saveMask);
-              if(p.SimplificationFlag)
-              {
-                /**********************/
-                if(cb) cb(50,"Step 3: Simplify mesh...");
-                else printf("Step 3: Simplify mesh...\n");
-                /**********************/
-                p.OutNameSimpVec.push_back(filename+std::string(".d.ply"));
-                me.face.EnableVFAdjacency();
-                MCSimplify<MCMesh>(me, VV.voxel[0]/4.0);
-                tri::Allocator<MCMesh>::CompactFaceVector(me);
-                me.face.EnableFFAdjacency();
-                tri::Clean<MCMesh>::RemoveTVertexByFlip(me,20,true);
-                tri::Clean<MCMesh>::RemoveFaceFoldByFlip(me);
-                tri::io::ExporterPLY<MCMesh>::Save(me,p.OutNameSimpVec.back().c_str(),saveMask);
-              }
-            }
-            int t3=clock();  //--------
-            TotSav+=t3-t2;
+  for(int i=0;i<p.RefillNum;++i)
+  {
+    V.Refill(3,6);
+    if(p.VerboseLevel>1) V.SlicedPPM(filename.c_str(),SFormat("_%02imsr",i),p.SliceNum	);
+    //if(VerboseLevel>1) V.SlicedPPMQ(filename,SFormat("_%02ips",i++),SliceNum	);
+  }
 
-          }
+  for(int i=0;i<p.SmoothNum;++i)
+  {
+    VolumeType SM;
+    SM.Init(V);
+    printf("%2i/%2i: ",i,p.SmoothNum);
+    SM.CopySmooth(V,1,p.QualitySmoothAbs);
+    V=SM;
+    V.Refill(3,6);
+    if(p.VerboseLevel>1) V.SlicedPPM(filename.c_str(),SFormat("_%02ims",i),p.SliceNum	);
+  }
 
-          printf("Mesh Saved '%s':  %8d vertices, %8d faces                   \n",(filename+std::string(".ply")).c_str(),me.vn,me.fn);
-          printf("Adding Meshes %8i\n",TotAdd);
-          printf("MC            %8i\n",TotMC);
-          printf("Saving        %8i\n",TotSav);
-          printf("Total         %8i\n",TotAdd+TotMC+TotSav);
-        }
-        else
-        {
-          printf("----------- skipping SubBlock %2i %2i %2i ----------\n",p.IPos[0],p.IPos[1],p.IPos[2]);
-        }
+  int t1=clock();  //--------
+#pragma omp atomic
+  TotAdd+=t1-t0;
+  printf("Extracting surface...\r");
+  if (p.VerboseLevel>0)
+  {
+    V.SlicedPPM("final","__",p.SliceNum);
+    V.SlicedPPMQ("final","__",p.SliceNum);
+  }
+  MCMesh me;
+  if(res)
+  {
+    typedef vcg::tri::TrivialWalker<MCMesh, VolumeType >	  Walker;
+    typedef vcg::tri::MarchingCubes<MCMesh, Walker>             MarchingCubes;
+
+    /**********************/
+    if(cb) cb(50,"Step 2: Marching Cube...");
+    else printf("Step 2: Marching Cube...\n");
+    /**********************/
+    if(p.ParallelMCFlag)
+    {
+      vcg::tri::ParallelTrivialWalker<MCMesh, VolumeType > pwalker;
+      std::vector<Box3i> blocks;
+      V.AllocatedBlocks(blocks);
+      pwalker.SetExtractionBox(V.SubPartSafe);
+      pwalker.SetActiveBlocks(blocks);
+      pwalker.BuildMesh(me,V,0);
+    }
+    else
+    {
+      Walker walker;
+      MarchingCubes	mc(me, walker);
+      walker.SetExtractionBox(V.SubPartSafe);
+      walker.BuildMesh(me,V,mc,0);
+    }
+
+    typename MCMesh::VertexIterator vi;
+    Box3f bbb; bbb.Import(V.SubPart);
+    for(vi=me.vert.begin();vi!=me.vert.end();++vi)
+    {
+      if(!bbb.IsIn((*vi).P()))
+        vcg::tri::Allocator< MCMesh >::DeleteVertex(me,*vi);
+      V.DeInterize((*vi).P());
+    }
+    for (typename MCMesh::FaceIterator fi = me.face.begin(); fi != me.face.end(); ++fi)
+    {
+      if((*fi).V(0)->IsD() || (*fi).V(1)->IsD() || (*fi).V(2)->IsD() )
+        vcg::tri::Allocator< MCMesh >::DeleteFace(me,*fi);
+      else std::swap((*fi).V1(0), (*fi).V2(0));
+    }
+
+    int t2=clock();  //--------
+#pragma omp atomic
+    TotMC+=t2-t1;
+    if(me.vn >0 || me.fn >0)
+    {
+      outNameVec.push_back(filename+std::string(".ply"));
+      tri::io::ExporterPLY<MCMesh>::Save(me,outNameVec.back().c_str(),saveMask);
+      if(p.SimplificationFlag)
+      {
+        /**********************/
+        if(cb) cb(50,"Step 3: Simplify mesh...");
+        else printf("Step 3: Simplify mesh...\n");
+        /**********************/
+        outNameSimpVec.push_back(filename+std::string(".d.ply"));
+        me.face.EnableVFAdjacency();
+        MCSimplify<MCMesh>(me, V.voxel[0]/4.0);
+        tri::Allocator<MCMesh>::CompactFaceVector(me);
+        me.face.EnableFFAdjacency();
+        tri::Clean<MCMesh>::RemoveTVertexByFlip(me,20,true);
+        tri::Clean<MCMesh>::RemoveFaceFoldByFlip(me);
+        tri::io::ExporterPLY<MCMesh>::Save(me,outNameSimpVec.back().c_str(),saveMask);
+      }
+    }
+    int t3=clock();  //--------
+#pragma omp atomic
+    TotSav+=t3-t2;
+
+  }
+
+  printf("Mesh Saved '%s':  %8d vertices, %8d faces                   \n",(filename+std::string(".ply")).c_str(),me.vn,me.fn);
+  printf("Adding Meshes %8i\n",TotAdd);
+  printf("MC            %8i\n",TotMC);
+  printf("Saving        %8i\n",TotSav);
+  printf("Total         %8i\n",TotAdd+TotMC+TotSav);
   return true;
 }
 
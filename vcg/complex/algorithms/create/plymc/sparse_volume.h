@@ -0,0 +1,156 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __SPARSE_VOLUME_H__
+#define __SPARSE_VOLUME_H__
+
+#include <algorithm>
+#include "volume.h"
+
+namespace vcg {
+
+// Block index that stores only the allocated blocks: rv is the list of the allocated blocks,
+// in allocation order, and a flat open addressing hash table (linear probing) maps the
+// block coords to their position in rv.
+// In this way the memory is proportional to the number of allocated blocks (i.e. to the narrow band
+// around the surface) and not to the size of the (sub)volume, and the VolumeIterator visits
+// only the allocated blocks.
+class HashBlockIndex
+{
+public:
+    HashBlockIndex() { Init(Point3i(0,0,0)); }
+
+    void Init(const Point3i &_asz)
+    {
+        asz=_asz;
+        key.clear();
+        table.assign(64,Entry());
+    }
+
+    int InitialSize() const { return 0; }
+
+    // the blocks are stored in allocation order
+    static bool FixedPlaces() { return false; }
+
+    int Find(const int rx, const int ry, const int rz) const
+    {
+        const long long k=Key(rx,ry,rz);
+        const size_t mask=table.size()-1;
+        for(size_t h=Hash(k)&mask; table[h].rpos!=-1; h=(h+1)&mask)
+            if(table[h].key==k) return table[h].rpos;
+        return -1;
+    }
+
+    int Insert(const int rx, const int ry, const int rz, const int rpos)
+    {
+        assert(rpos==int(key.size()));
+        assert(Find(rx,ry,rz)==-1);
+        key.push_back(Key(rx,ry,rz));
+        if(2*key.size() > table.size()) Rehash(2*table.size());
+        else Place(rpos);
+        return rpos;
+    }
+
+    void Block(const int rpos, int &rx, int &ry, int &rz) const
+    {
+        const long long k=key[rpos];
+        const long long slice=(long long)(asz[0])*asz[1];
+        rz = int(k / slice);
+        ry = int((k % slice) / asz[0]);
+        rx = int(k % asz[0]);
+    }
+
+    // reorders the blocks (and rv with them) in lexicographic (z,y,x) order
+    template <class BLOCK_TYPE>
+    void Sort(std::vector<BLOCK_TYPE> &rv)
+    {
+        assert(rv.size()==key.size());
+        std::vector<std::pair<long long,int> > order(key.size());
+        for(size_t i=0;i<key.size();++i)
+            order[i]=std::make_pair(key[i],int(i));
+        bool sorted=true;
+        for(size_t i=1;i<key.size() && sorted;++i)
+            sorted = key[i-1]<key[i];
+        if(sorted) return;
+        std::sort(order.begin(),order.end());
+        std::vector<BLOCK_TYPE> srv(rv.size());
+        for(size_t i=0;i<order.size();++i)
+        {
+            key[i]=order[i].first;
+            srv[i].swap(rv[order[i].second]);
+        }
+        rv.swap(srv);
+        Rehash(table.size());
+    }
+
+private:
+    Point3i asz;
+    struct Entry
+    {
+        long long key;
+        int rpos; // position in rv, -1 for the empty entries
+        Entry() : key(-1), rpos(-1) {}
+    };
+    std::vector<long long> key; // linear index of each block of rv in the grid of the blocks
+    std::vector<Entry> table;   // the size is a power of two
+
+    long long Key(const int rx, const int ry, const int rz) const
+    {
+        return ((long long)(rz)*asz[1]+ry)*asz[0]+rx;
+    }
+
+    static size_t Hash(const long long k)
+    {
+        return size_t(((unsigned long long)(k)*0x9E3779B97F4A7C15ull)>>32);
+    }
+
+    void Place(const int rpos)
+    {
+        const size_t mask=table.size()-1;
+        size_t h=Hash(key[rpos])&mask;
+        while(table[h].rpos!=-1) h=(h+1)&mask;
+        table[h].key=key[rpos];
+        table[h].rpos=rpos;
+    }
+
+    void Rehash(const size_t tableSize)
+    {
+        table.assign(tableSize,Entry());
+        for(size_t i=0;i<key.size();++i)
+            Place(int(i));
+    }
+};
+
+// A Volume that keeps in memory only its allocated blocks (8^3 voxels each).
+// It has the same interface of Volume so it can be used in its place by PlyMC and by the
+// marching cubes walkers; after the blocks have been sorted (Refill and Expand do it) the
+// processing gives the same results of the dense-indexed Volume.
+// Use Volume::AllocatedBlocks with ParallelTrivialWalker::SetActiveBlocks to extract the surface
+// visiting only the allocated blocks.
+template<class VOX_TYPE, class SCALAR_TYPE=float>
+class SparseVolume : public Volume<VOX_TYPE, SCALAR_TYPE, HashBlockIndex>
+{
+};
+
+} // end namespace vcg
+#endif // __SPARSE_VOLUME_H__
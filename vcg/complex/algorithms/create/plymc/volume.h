@@ -47,8 +47,44 @@ const char *SFormat( const char * f, ... )
         return buf;
     }
 
+// Maps the block (rx,ry,rz) of a Volume (block coords relative to the safe subpart)
+// to its position in the block vector rv.
+// This one keeps a slot for every block of the subpart, left empty until the block is allocated;
+// see HashBlockIndex (sparse_volume.h) for an index that stores only the allocated blocks.
+class GridBlockIndex
+{
+public:
+    void Init(const Point3i &_asz) { asz=_asz; }
+
+    // number of (empty) blocks that rv must have after the Init
+    int InitialSize() const { return asz[0]*asz[1]*asz[2]; }
+
+    // true if a block has the same position in the rv of every volume with the same grid
+    static bool FixedPlaces() { return true; }
+
+    // position of the block in rv, -1 if it has no place there
+    int Find(const int rx, const int ry, const int rz) const { return rz*asz[0]*asz[1]+ry*asz[0]+rx; }
+
+    // makes room for the block, that would be appended to rv at position rpos; returns its position
+    int Insert(const int rx, const int ry, const int rz, const int /*rpos*/) { return Find(rx,ry,rz); }
 
-template<class VOX_TYPE, class SCALAR_TYPE=float>
+    void Block(const int rpos, int &rx, int &ry, int &rz) const
+    {
+        rz =   rpos / (asz[0]*asz[1]);	int remainder =  rpos % (asz[0]*asz[1]);
+        ry = ( remainder ) / asz[0] ;
+        rx =   remainder % asz[0];
+    }
+
+    // reorders the blocks in lexicographic (z,y,x) order; they already are.
+    template <class BLOCK_TYPE>
+    void Sort(std::vector<BLOCK_TYPE> &/*rv*/) {}
+
+private:
+    Point3i asz;
+};
+
+
+template<class VOX_TYPE, class SCALAR_TYPE=float, class BLOCK_INDEX=GridBlockIndex>
 class Volume {
 public:
   typedef SCALAR_TYPE scalar;
@@ -64,6 +100,7 @@ public:
     // I dati veri e propri
     // Sono contenuti in un vettore di blocchi.
     std::vector<  std::vector<VOX_TYPE>  > rv;
+    BLOCK_INDEX bi; // where each block is stored in rv
     Box3x   bbox;
 
         _int64 AskedCells;
@@ -95,11 +132,14 @@ private :
         /// Gestione sottoparte
     Point3i div;
     Point3i pos;
+
+    template <class, class, class> friend class Volume;
 public:
     Box3i	  SubPart;                 // Sottoparte del volume da considerare ufficialmente
     Box3x     SubBox;                  // BBox della sottoparte del volume da considerare in coord assolute
     Box3i	  SubPartSafe;             // come sopra ma aumentati per sicurezza.
     Box3x     SubBoxSafe;
+    Box3i     ScanBox;                 // ScanFace and SplatVert write only the voxels inside this box (by default SubPartSafe)
 
  FILE *LogFP;
 bool Verbose; // se true stampa un sacco di info in piu su logfp;
@@ -114,7 +154,9 @@ bool Verbose; // se true stampa un sacco di info in piu su logfp;
          LogFP=stderr;
         }
 
-    void Init(const Volume &VV)
+    // Same grid and subpart of VV, whatever its block index
+    template <class VOL>
+    void Init(const VOL &VV)
     {
         SetDefaultParam();
         WN=VV.WN;
@@ -149,10 +191,12 @@ bool Verbose; // se true stampa un sacco di info in piu su logfp;
         voxel[2]=dim[2]/sz[2];
 
         SetSubPart(_div,_pos);
+        ScanBox=SubPartSafe;
         ssz=SubPartSafe.max-SubPartSafe.min;
         asz=ssz/BLOCKSIDE() + Point3i(1,1,1);
+        bi.Init(asz);
         rv.clear();
-        rv.resize(asz[0]*asz[1]*asz[2]);
+        rv.resize(bi.InitialSize());
         for(size_t i=0;i<rv.size();++i)
             rv[i].resize(0,VOX_TYPE::Zero());
         SetDim(bb);
@@ -323,11 +367,11 @@ public:
 
         int rx=x/BLOCKSIDE();		int ry=y/BLOCKSIDE();		int rz=z/BLOCKSIDE();
         assert(rx>=0 && rx<asz[0] && ry>=0 && ry<asz[1] && rz>=0 && rz<asz[2]);
-        rpos = rz*asz[0]*asz[1]+ry*asz[0]+rx;
+        rpos = bi.Find(rx,ry,rz);
         assert(rpos < int(rv.size()));
         int lx = x%BLOCKSIDE();		int ly = y%BLOCKSIDE();		int lz = z % BLOCKSIDE();
         lpos = lz*BLOCKSIDE()*BLOCKSIDE()+ly*BLOCKSIDE()+lx;
-        if(rv[rpos].empty()) return false;
+        if((!BLOCK_INDEX::FixedPlaces() && rpos<0) || rv[rpos].empty()) return false;
         return true;
      }
 
@@ -339,9 +383,8 @@ public:
     {
         assert (rpos>=0 && lpos  >=0);
 
-        int rz =   rpos / (asz[0]*asz[1]);	int remainder =  rpos % (asz[0]*asz[1]);
-        int ry = ( remainder ) / asz[0] ;
-        int rx =   remainder % asz[0];
+        int rx,ry,rz;
+        bi.Block(rpos,rx,ry,rz);
 
         assert(rx>=0 && rx<asz[0] && ry>=0 && ry<asz[1] && rz>=0 && rz<asz[2]);
 
@@ -369,6 +412,57 @@ public:
     {
         rv[rpos].resize(BLOCKSIDE()*BLOCKSIDE()*BLOCKSIDE(),zeroval);
     }
+
+    // Position in rv of the (not allocated) block containing the voxel (x,y,z), making room for it
+    int Slot(const int &x,const int &y,const int &z)
+    {
+        int rpos=bi.Insert((x-SubPartSafe.min[0])/BLOCKSIDE(),(y-SubPartSafe.min[1])/BLOCKSIDE(),(z-SubPartSafe.min[2])/BLOCKSIDE(),int(rv.size()));
+        if(rpos==int(rv.size())) rv.push_back(std::vector<VOX_TYPE>());
+        return rpos;
+    }
+
+    // Allocates the block containing the voxel (x,y,z) and returns its position in rv
+    int Alloc(const int &x,const int &y,const int &z, const VOX_TYPE &zeroval)
+    {
+        int rpos=Slot(x,y,z);
+        Alloc(rpos,zeroval);
+        return rpos;
+    }
+
+    // Moves here the allocated blocks of S, a volume with the same grid and subpart (see Init(VV))
+    // but possibly a different block index; the two volumes must not have allocated blocks in common.
+    template <class VOL>
+    void MoveBlocks(VOL &S)
+    {
+        for(size_t i=0;i<S.rv.size();++i)
+            if(!S.rv[i].empty())
+            {
+                int x,y,z;
+                S.IPos(x,y,z,int(i),0);
+                int rpos=Slot(x,y,z);
+                assert(rv[rpos].empty());
+                rv[rpos].swap(S.rv[i]);
+            }
+    }
+
+    // Reorders the allocated blocks in lexicographic (z,y,x) order, so that the visits
+    // of the VolumeIterator do not depend on the order in which the blocks have been allocated.
+    void SortBlocks() { bi.Sort(rv); }
+
+    // The voxels covered by each allocated block (clipped to the safe subpart), in storage order.
+    void AllocatedBlocks(std::vector<Box3i> &blocks) const
+    {
+        blocks.clear();
+        for(size_t i=0;i<rv.size();++i)
+            if(!rv[i].empty())
+            {
+                Box3i b;
+                IPos(b.min[0],b.min[1],b.min[2],int(i),0);
+                b.max=b.min+Point3i(BLOCKSIDE(),BLOCKSIDE(),BLOCKSIDE());
+                b.Intersect(SubPartSafe);
+                blocks.push_back(b);
+            }
+    }
     /************************************/
     // Funzioni di accesso ai dati
   bool ValidCell(const Point3i &p1, const Point3i &p2) const
@@ -392,7 +486,12 @@ public:
 
     VOX_TYPE &V(const int &x,const int &y,const int &z) {
         int rpos,lpos;
-        if(!Pos(x,y,z,rpos,lpos)) Alloc(rpos,VOX_TYPE::Zero());
+        if(!Pos(x,y,z,rpos,lpos))
+        {
+            // with the grid index the block always has its place: this keeps V() as small as before
+            if(!BLOCK_INDEX::FixedPlaces() && rpos<0) rpos=Slot(x,y,z);
+            Alloc(rpos,VOX_TYPE::Zero());
+        }
         return rv[rpos][lpos];
     }
 
@@ -437,7 +536,7 @@ void Fill(VOX_TYPE const p)
 // il parametro serve a specificare il range di valori di campo vicini allo zero che non vanno mediati!
 // questo perche se si smootha anche sullo zero si smoota anche dove e' bene allineato
 
-void CopySmooth( Volume<VOX_TYPE> &S, scalar SafeZone=1, scalar SafeQuality=0)
+void CopySmooth( Volume &S, scalar SafeZone=1, scalar SafeQuality=0)
 {
     if(sz!=S.sz)
         {
@@ -456,7 +555,7 @@ void CopySmooth( Volume<VOX_TYPE> &S, scalar SafeZone=1, scalar SafeQuality=0)
         if((*vi).B())
         {
             int x,y,z;
-            IPos(x,y,z,vi.rpos,vi.lpos);
+            S.IPos(x,y,z,vi.rpos,vi.lpos);
             if(Bound1(x,y,z))
                 {
                   VOX_TYPE &VC =  V(x,y,z);
@@ -503,7 +602,15 @@ void CopySmooth( Volume<VOX_TYPE> &S, scalar SafeZone=1, scalar SafeQuality=0)
     {
         if((*svi).Cnt()>0)
         {
-            VOX_TYPE &sv=S.rv[svi.rpos][svi.lpos];
+            const VOX_TYPE *svp;
+            if(BLOCK_INDEX::FixedPlaces()) svp=&S.rv[svi.rpos][svi.lpos];
+            else
+            {
+                int x,y,z;
+                IPos(x,y,z,svi.rpos,svi.lpos);
+                svp=&S.cV(x,y,z);
+            }
+            const VOX_TYPE &sv=*svp;
             (*svi).Normalize(1); // contiene il valore mediato
             float SafeThr = fabs(sv.V());
 
@@ -536,7 +643,7 @@ void CopySmooth( Volume<VOX_TYPE> &S, scalar SafeZone=1, scalar SafeQuality=0)
  if(Verbose) fprintf(LogFP,"CopySmooth %i voxels, %i preserved, %i blended\n",smoothcnt,preservedcnt,blendedcnt);
 }
 
-void Merge(Volume<VOX_TYPE> &S)
+void Merge(Volume &S)
 {
  VolumeIterator< Volume > svi(S);
  svi.Restart();
@@ -548,7 +655,7 @@ void Merge(Volume<VOX_TYPE> &S)
      if((*svi).B())
          {
           int x,y,z;
-            IPos(x,y,z,svi.rpos,svi.lpos);
+            S.IPos(x,y,z,svi.rpos,svi.lpos);
             if(cV(x,y,z).B())	V(x,y,z).Merge( (*svi));
                     else {
                         V(x,y,z).Set((*svi));
@@ -603,6 +710,13 @@ bool SplatVert( const Point3x & v0, double quality, const Point3x & nn, Color4b
             return false;
         }
 
+    // only the voxels inside the ScanBox are written
+    for(int k=0;k<3;++k)
+    {
+        ibox.min[k] = std::max(ScanBox.min[k],ibox.min[k]);
+        ibox.max[k] = std::min(ScanBox.max[k]-1,ibox.max[k]);
+    }
+
     Point3x iV, deltaIV;
 
     // Now scan the eight voxel surrounding the splat
@@ -660,7 +774,7 @@ template<int CoordZ>
 
     for(int k=WN;k<=WP;k++)
     {
-        if(zint+k >= SubPartSafe.min[CoordZ] && zint+k < SubPartSafe.max[CoordZ])
+        if(zint+k >= ScanBox.min[CoordZ] && zint+k < ScanBox.max[CoordZ])
         {
             VOX_TYPE *VV;
             if(CoordZ==2) VV=&V(x,y,zint+k);
@@ -712,9 +826,9 @@ bool ScanFace2( const Point3x & v0, const Point3x & v1, const Point3x & v2,
         /**** Rasterizzazione bbox ****/
 
     // Clamping dei valori di rasterizzazione al subbox corrente
-    sx = std::max(SubPartSafe.min[0],sx); ex = std::min(SubPartSafe.max[0]-1,ex);
-    sy = std::max(SubPartSafe.min[1],sy); ey = std::min(SubPartSafe.max[1]-1,ey);
-    sz = std::max(SubPartSafe.min[2],sz); ez = std::min(SubPartSafe.max[2]-1,ez);
+    sx = std::max(ScanBox.min[0],sx); ex = std::min(ScanBox.max[0]-1,ex);
+    sy = std::max(ScanBox.min[1],sy); ey = std::min(ScanBox.max[1]-1,ey);
+    sz = std::max(ScanBox.min[2],sz); ez = std::min(ScanBox.max[2]-1,ez);
 
     if(fabs(norm[0]) > fabs(norm[1]) && fabs(norm[0])>fabs(norm[2])) RasterFace<0>(sy,ey,sz,ez,dist,norm,quality,v0,v1,v2,d10,d21,d02);
     else if(fabs(norm[1]) > fabs(norm[0]) && fabs(norm[1])>fabs(norm[2])) RasterFace<1>(sz,ez,sx,ex,dist,norm,quality,v0,v1,v2,d10,d21,d02);
@@ -783,9 +897,9 @@ bool ScanFace( const Point3x & v0, const Point3x & v1, const Point3x & v2,
 
 
     // Clamping dei valori di rasterizzazione al subbox corrente
-    sx = std::max(SubPartSafe.min[0],sx); ex = std::min(SubPartSafe.max[0]-1,ex);
-    sy = std::max(SubPartSafe.min[1],sy); ey = std::min(SubPartSafe.max[1]-1,ey);
-    sz = std::max(SubPartSafe.min[2],sz); ez = std::min(SubPartSafe.max[2]-1,ez);
+    sx = std::max(ScanBox.min[0],sx); ex = std::min(ScanBox.max[0]-1,ex);
+    sy = std::max(ScanBox.min[1],sy); ey = std::min(ScanBox.max[1]-1,ey);
+    sz = std::max(ScanBox.min[2],sz); ez = std::min(ScanBox.max[2]-1,ez);
 
         // Rasterizzazione xy
 
@@ -853,7 +967,7 @@ void AddXYInt( const int x, const int y, const double z, const double sgn, const
     double dist=z-floor(z);  // sempre positivo e compreso tra zero e uno
     int  zint = floor(z);
     for(int k=WN;k<=WP;k++)
-        if(zint+k >= SubPartSafe.min[2] && zint+k < SubPartSafe.max[2])
+        if(zint+k >= ScanBox.min[2] && zint+k < ScanBox.max[2])
         {
             VOX_TYPE &VV=V(x,y,zint+k);
             double nvv= esgn*( k-dist);
@@ -867,7 +981,7 @@ void AddYZInt( const int y, const int z, const double x, const double sgn, const
     double dist=x-floor(x);  // sempre positivo e compreso tra zero e uno
     int  xint = int(floor(x));
     for(int k=WN;k<=WP;k++)
-        if(xint+k >= SubPartSafe.min[0] && xint+k < SubPartSafe.max[0])
+        if(xint+k >= ScanBox.min[0] && xint+k < ScanBox.max[0])
         {
             VOX_TYPE &VV=V(xint+k,y,z);
             double nvv= esgn*( k-dist);
@@ -881,7 +995,7 @@ void AddXZInt( const int x, const int z, const double y, const double sgn, const
     double dist=y-scalar(floor(y));  // sempre positivo e compreso tra zero e uno
     int  yint = floor(y);
     for(int k=WN;k<=WP;k++)
-        if(yint+k >= SubPartSafe.min[1] && yint+k < SubPartSafe.max[1])
+        if(yint+k >= ScanBox.min[1] && yint+k < ScanBox.max[1])
         {
             VOX_TYPE &VV=V(x,yint+k,z);
             double nvv= esgn*( k-dist);
@@ -948,6 +1062,7 @@ si evita il problema che l'espansione e' legata all'acquisizione iniziale
 void Expand(scalar AngleThrRad)
 {
  int i;
+ SortBlocks(); // the sums on the new voxels depend on the visiting order
  VolumeIterator< Volume > vi(*this);
 
  float CosThr=math::Cos(AngleThrRad);
@@ -995,6 +1110,7 @@ void Expand(scalar AngleThrRad)
 void Refill(const int thr,float maxdistance = std::numeric_limits<float>::max() )
 {
  int lcnt=0;
+ SortBlocks(); // the sums on the new voxels depend on the visiting order
  VolumeIterator< Volume > vi(*this);
  vi.Restart();
  vi.FirstNotEmpty();
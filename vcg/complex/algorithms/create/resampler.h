@@ -27,6 +27,7 @@
 #include <vcg/complex/algorithms/update/bounding.h>
 #include <vcg/complex/algorithms/update/component_ep.h>
 #include <vcg/complex/algorithms/create/marching_cubes.h>
+#include <vcg/complex/algorithms/create/mc_trivial_walker.h>
 //#include <vcg/space/index/grid_static_ptr.h>
 //#include <vcg/complex/algorithms/closest.h>
 #include <vcg/space/index/kdtree/kdtree_face.h>
@@ -90,7 +91,15 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
 
     NewMeshType	*_newM;
     OldMeshType	*_oldM;
-    GridType _g;
+    GridType _ownG;
+    GridType *_g; // the walkers of the slabs share the one of the main walker
+
+    // Narrow band: the blocks of BandBlockSide^3 voxels that can be closer than max_dim to the mesh.
+    // For each row of blocks along y, the (x,z) coords of its blocks sorted by x and then by z.
+    static const int BandBlockSide = 8;
+    typedef std::vector< std::vector<Point2i> > BandType;
+    BandType _ownBand;
+    const BandType *_band; // NULL if the distance is computed on the whole volume
 
   public:
     NewScalarType max_dim; // the limit value of the search (that takes into account of the offset)
@@ -98,6 +107,7 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
     bool DiscretizeFlag; // if the extracted surface should be discretized or not.
     bool MultiSampleFlag;
     bool AbsDistFlag; // if true the Distance Field computed is no more a signed one.
+    bool NarrowBandFlag; // if true the distance is computed only on the voxels near to the mesh (same result).
     Walker(const Box3<NewScalarType> &_bbox, Point3i _siz )
     {
       this->bbox= _bbox;
@@ -110,6 +120,7 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
       DiscretizeFlag=false;
       MultiSampleFlag=false;
       AbsDistFlag=false;
+      NarrowBandFlag=false;
 
       _x_cs = new VertexIndex[ SliceSize ];
       _y_cs = new VertexIndex[ SliceSize ];
@@ -120,10 +131,16 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
       _v_cs= new field_value[(this->siz.X()+1)*(this->siz.Z()+1)];
       _v_ns= new field_value[(this->siz.X()+1)*(this->siz.Z()+1)];
 
+      _g = &_ownG;
+      _band = NULL;
     };
 
     ~Walker()
-    {}
+    {
+      delete [] _x_cs; delete [] _y_cs; delete [] _z_cs;
+      delete [] _x_ns; delete [] _z_ns;
+      delete [] _v_cs; delete [] _v_ns;
+    }
 
 
     NewScalarType V(const Point3i &p)
@@ -161,7 +178,7 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
 
       OldCoordType closestPt;
       DISTFUNCTOR PDistFunct;
-      OldFaceType *f = _g.GetClosest(PDistFunct,markerFunctor,testPt,max_dist,dist,closestPt);
+      OldFaceType *f = _g->GetClosest(PDistFunct,markerFunctor,testPt,max_dist,dist,closestPt);
                  
       if (f==NULL) return field_value(false,0);
       if(AbsDistFlag) return field_value(true,dist);
@@ -234,6 +251,11 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
     /// the distance of the bb
     void ComputeSliceValues(int slice,field_value *slice_values)
     {
+      if(_band)
+      {
+        ComputeBandSliceValues(slice,slice_values);
+        return;
+      }
 #pragma omp parallel for schedule(dynamic, 10)
       for (int i=0; i<=this->siz.X(); i++)
       {
@@ -248,6 +270,101 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
       //ComputeConsensus(slice,slice_values);
     }
 
+    /// same of above but only the voxels of the narrow band are computed, the others are not valid.
+    /// Each block is a batch of spatially coherent queries.
+    void ComputeBandSliceValues(int slice,field_value *slice_values)
+    {
+      std::fill(slice_values, slice_values+SliceSize, field_value(false,0));
+      if(slice/BandBlockSide >= int(_band->size())) return;
+      const std::vector<Point2i> &row = (*_band)[slice/BandBlockSide];
+#pragma omp parallel for schedule(dynamic, 1)
+      for (int b=0; b<int(row.size()); b++)
+      {
+        const int ie = std::min(row[b][0]*BandBlockSide+BandBlockSide, this->siz.X()+1);
+        const int ke = std::min(row[b][1]*BandBlockSide+BandBlockSide, this->siz.Z()+1);
+        for (int i=row[b][0]*BandBlockSide; i<ie; i++)
+          for (int k=row[b][1]*BandBlockSide; k<ke; k++)
+          {
+            int index=GetSliceIndex(i,k);
+            OldCoordType pp(i,slice,k);
+            if(this->MultiSampleFlag) slice_values[index] = MultiDistanceFromMesh(pp);
+            else	slice_values[index] = DistanceFromMesh(pp);
+          }
+      }
+    }
+
+    /// Builds the narrow band: the voxel bbox of each face, enlarged by max_dim (and by a voxel for the
+    /// multisampling), is rasterized in blocks; then the blocks that have no face within max_dim are discarded.
+    /// The slices visited by the walkers go from 0 to siz.Y()+2.
+    void BuildNarrowBand()
+    {
+      const int B = BandBlockSide;
+      const Point3i bsz(this->siz.X()/B+1, (this->siz.Y()+2)/B+1, this->siz.Z()/B+1);
+      const Point3i vmax(this->siz.X(), this->siz.Y()+2, this->siz.Z());
+      const OldScalarType margin = OldScalarType(max_dim) + OldScalarType(this->voxel.Norm());
+      std::vector<long long> key;
+#pragma omp parallel
+      {
+        std::vector<long long> loc;
+#pragma omp for schedule(static)
+        for (int fi=0; fi<int(_oldM->face.size()); ++fi)
+        {
+          const OldFaceType &f = _oldM->face[fi];
+          if(f.IsD()) continue;
+          Point3i b0, b1;
+          bool empty=false;
+          for(int d=0;d<3;++d)
+          {
+            OldScalarType lo = std::min(f.cP(0)[d],std::min(f.cP(1)[d],f.cP(2)[d])) - margin;
+            OldScalarType hi = std::max(f.cP(0)[d],std::max(f.cP(1)[d],f.cP(2)[d])) + margin;
+            const int v0 = std::max(0,       int(floor((lo - this->bbox.min[d])/this->voxel[d])));
+            const int v1 = std::min(vmax[d], int(ceil ((hi - this->bbox.min[d])/this->voxel[d])));
+            if(v0>v1) empty=true;
+            b0[d]=v0/B; b1[d]=v1/B;
+          }
+          if(empty) continue;
+          for(int by=b0[1];by<=b1[1];++by)
+            for(int bx=b0[0];bx<=b1[0];++bx)
+              for(int bz=b0[2];bz<=b1[2];++bz)
+                loc.push_back((((long long)(by))*bsz[0]+bx)*bsz[2]+bz);
+        }
+        std::sort(loc.begin(),loc.end());
+        loc.erase(std::unique(loc.begin(),loc.end()),loc.end());
+#pragma omp critical
+        key.insert(key.end(),loc.begin(),loc.end());
+      }
+      std::sort(key.begin(),key.end());
+      key.erase(std::unique(key.begin(),key.end()),key.end());
+
+      // a block is kept if there is a face closer than max_dim to a sphere that contains its voxels
+      const OldScalarType blockRadius = OldScalarType(this->voxel.Norm()) * (B/2+1);
+      std::vector<char> keep(key.size(),0);
+#pragma omp parallel for schedule(dynamic, 64)
+      for (int i=0; i<int(key.size()); ++i)
+      {
+        const int bz = int(key[i] % bsz[2]);
+        const int bx = int((key[i] / bsz[2]) % bsz[0]);
+        const int by = int(key[i] / ((long long)(bsz[0])*bsz[2]));
+        OldCoordType c;
+        this->IPfToPf(OldCoordType(bx*B+(B-1)/OldScalarType(2), by*B+(B-1)/OldScalarType(2), bz*B+(B-1)/OldScalarType(2)),c);
+        DISTFUNCTOR PDistFunct;
+        MarkerFace mf;
+        mf.SetMesh(_oldM);
+        OldScalarType dist;
+        OldCoordType closestPt;
+        keep[i] = (_g->GetClosest(PDistFunct,mf,c,OldScalarType(max_dim)+blockRadius,dist,closestPt) != NULL);
+      }
+
+      BandType(bsz[1]).swap(_ownBand);
+      for (size_t i=0; i<key.size(); ++i)
+        if(keep[i])
+        {
+          const int by = int(key[i] / ((long long)(bsz[0])*bsz[2]));
+          _ownBand[by].push_back(Point2i(int((key[i] / bsz[2]) % bsz[0]), int(key[i] % bsz[2])));
+        }
+      _band = &_ownBand;
+    }
+
     /*
             For some reasons it can happens that the sign of the computed distance could not correct.
             this function tries to correct these issues by flipping the isolated voxels with discordant sign
@@ -303,6 +420,11 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
     template<class EXTRACTOR_TYPE>
     void ProcessSlice(EXTRACTOR_TYPE &extractor)
     {
+      if(_band)
+      {
+        ProcessBandSlice<EXTRACTOR_TYPE>(extractor);
+        return;
+      }
       for (int i=0; i<this->siz.X(); i++)
       {
         for (int k=0; k<this->siz.Z(); k++)
@@ -321,6 +443,40 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
     }
 
 
+    /// same of above visiting only the cells whose first corner is in the narrow band,
+    /// in the same order (the other cells have non valid corners)
+    template<class EXTRACTOR_TYPE>
+    void ProcessBandSlice(EXTRACTOR_TYPE &extractor)
+    {
+      if(CurrentSlice/BandBlockSide >= int(_band->size())) return;
+      const std::vector<Point2i> &row = (*_band)[CurrentSlice/BandBlockSide];
+      for (size_t b0=0; b0<row.size(); )
+      {
+        size_t b1=b0;
+        while(b1<row.size() && row[b1][0]==row[b0][0]) ++b1;
+        const int ie = std::min(row[b0][0]*BandBlockSide+BandBlockSide, this->siz.X());
+        for (int i=row[b0][0]*BandBlockSide; i<ie; i++)
+          for (size_t b=b0; b<b1; ++b)
+          {
+            const int ke = std::min(row[b][1]*BandBlockSide+BandBlockSide, this->siz.Z());
+            for (int k=row[b][1]*BandBlockSide; k<ke; k++)
+            {
+              bool goodCell=true;
+              Point3i p1(i,CurrentSlice,k);
+              Point3i p2=p1+Point3i(1,1,1);
+              for(int ii=0;ii<2;++ii)
+                for(int jj=0;jj<2;++jj)
+                  for(int kk=0;kk<2;++kk)
+                    goodCell &= VV(p1[0]+ii,p1[1]+jj,p1[2]+kk).first;
+
+              if(goodCell) extractor.ProcessCell(p1, p2);
+            }
+          }
+        b0=b1;
+      }
+    }
+
+
     template<class EXTRACTOR_TYPE>
     void BuildMesh(OldMeshType &old_mesh,NewMeshType &new_mesh,EXTRACTOR_TYPE &extractor,vcg::CallBackPos *cb)
     {
@@ -332,8 +488,10 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
       tri::UpdateNormal<OldMeshType>::PerVertexAngleWeighted(old_mesh);
       int _size=(int)old_mesh.fn*100;
 
-      _g.Set(_oldM->face.begin(),_oldM->face.end(),_size);
+      _ownG.Set(_oldM->face.begin(),_oldM->face.end(),_size);
       markerFunctor.SetMesh(&old_mesh);
+      _band = NULL;
+      if(NarrowBandFlag) BuildNarrowBand();
 
       _newM->Clear();
 
@@ -353,6 +511,84 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
         }
     }
 
+    /// Multithreaded version of BuildMesh: the slabs of slices are extracted by different walkers
+    /// and joined (see MCSlabs); the resulting mesh is the same of BuildMesh.
+    void BuildMeshParallel(OldMeshType &old_mesh,NewMeshType &new_mesh,vcg::CallBackPos *cb)
+    {
+      _newM=&new_mesh;
+      _oldM=&old_mesh;
+
+      tri::UpdateNormal<OldMeshType>::PerFaceNormalized(old_mesh);
+      tri::UpdateNormal<OldMeshType>::PerVertexAngleWeighted(old_mesh);
+      int _size=(int)old_mesh.fn*100;
+
+      _ownG.Set(_oldM->face.begin(),_oldM->face.end(),_size);
+      markerFunctor.SetMesh(&old_mesh);
+      _band = NULL;
+      if(NarrowBandFlag) BuildNarrowBand();
+
+      _newM->Clear();
+
+      // the same slices visited by BuildMesh
+      MCSlabs<NewMeshType> slabs;
+      slabs.Init(0, this->siz.Y()+1, 0);
+      if (cb) cb(0,"Marching ");
+#pragma omp parallel
+      {
+        Walker w(this->bbox, this->siz);
+        w.max_dim = max_dim;
+        w.offset = offset;
+        w.DiscretizeFlag = DiscretizeFlag;
+        w.MultiSampleFlag = MultiSampleFlag;
+        w.AbsDistFlag = AbsDistFlag;
+        w._oldM = _oldM;
+        w._g = _g;
+        w._band = _band;
+        w.markerFunctor.SetMesh(&old_mesh);
+#pragma omp for schedule(dynamic,1)
+        for (int s=0; s<slabs.SlabNum(); ++s)
+        {
+          MyMarchingCubes extractor(slabs.slab[s].mesh, w);
+          w.ExtractSlab(extractor, slabs.Start(s), slabs.End(s), slabs.slab[s]);
+        }
+      }
+      if (cb) cb(90,"Joining slabs");
+      slabs.Join(new_mesh);
+#pragma omp parallel for schedule(static)
+      for(int i=0; i<int(new_mesh.vert.size()); ++i)
+        this->IPfToPf(new_mesh.vert[i].cP(),new_mesh.vert[i].P());
+    }
+
+    /// Extracts the slices [y0,y1) in the mesh of the slab, re-running before the slice y0-1 (see MCSlabs).
+    template<class EXTRACTOR_TYPE>
+    void ExtractSlab(EXTRACTOR_TYPE &extractor, int y0, int y1, typename MCSlabs<NewMeshType>::Slab &slab)
+    {
+      _newM=&slab.mesh;
+      extractor.Initialize();
+      const bool preRoll = (y0 > 0);
+      Begin(preRoll ? y0-1 : y0);
+      if (preRoll)
+      {
+        ProcessSlice<EXTRACTOR_TYPE>(extractor);
+        NextSlice();
+        MCSlabs<NewMeshType>::Capture(_x_cs, _z_cs, SliceSize, slab.first);
+      }
+      slab.preVertNum = slab.mesh.vert.size();
+      slab.preFaceNum = slab.mesh.face.size();
+      for (int j=y0; j<y1; j++)
+      {
+        ProcessSlice<EXTRACTOR_TYPE>(extractor);
+        if (j==y1-1)
+        {
+          MCSlabs<NewMeshType>::Capture(_x_ns, _z_ns, SliceSize, slab.last);
+          break;
+        }
+        NextSlice();
+      }
+      extractor.Finalize();
+      _newM=NULL;
+    }
+
     //return the index of a vertex in slide as it was stored
     int GetSliceIndex(int x,int z)
     {
@@ -380,10 +616,10 @@ class Resampler : public BasicGrid<typename NewMeshType::ScalarType>
     }
 
     //initialize data strucures , the initial value of distance fields ids set as double of bbox of space
-    void Begin()
+    void Begin(int slice=0)
     {
 
-      CurrentSlice = 0;
+      CurrentSlice = slice;
 
       memset(_x_cs, -1, SliceSize*sizeof(VertexIndex));
       memset(_y_cs, -1, SliceSize*sizeof(VertexIndex));
@@ -617,6 +853,39 @@ public:
     walker.BuildMesh(old_mesh,new_mesh,mc,cb);
   }
 
+  /// Multithreaded version of Resample, with the same result.
+  static void ResampleParallel(OldMeshType &old_mesh, NewMeshType &new_mesh,  NewBoxType volumeBox, vcg::Point3<int> accuracy,float max_dist, float thr=0, bool DiscretizeFlag=false, bool MultiSampleFlag=false, bool AbsDistFlag=false, vcg::CallBackPos *cb=0 )
+  {
+    vcg::tri::UpdateBounding<OldMeshType>::Box(old_mesh);
+
+    MyWalker	walker(volumeBox,accuracy);
+
+    walker.max_dim=max_dist+fabs(thr);
+    walker.offset = - thr;
+    walker.DiscretizeFlag = DiscretizeFlag;
+    walker.MultiSampleFlag = MultiSampleFlag;
+    walker.AbsDistFlag = AbsDistFlag;
+    walker.BuildMeshParallel(old_mesh,new_mesh,cb);
+  }
+
+  /// Same of ResampleParallel, but the distance field is computed only in a narrow band around the mesh
+  /// (the voxels that can be closer than max_dist+|thr|) and marching cubes visits only the cells of the band.
+  /// The result is the same; time and work depend on the area of the mesh instead of on the volume.
+  static void ResampleNarrowBand(OldMeshType &old_mesh, NewMeshType &new_mesh,  NewBoxType volumeBox, vcg::Point3<int> accuracy,float max_dist, float thr=0, bool DiscretizeFlag=false, bool MultiSampleFlag=false, bool AbsDistFlag=false, vcg::CallBackPos *cb=0 )
+  {
+    vcg::tri::UpdateBounding<OldMeshType>::Box(old_mesh);
+
+    MyWalker	walker(volumeBox,accuracy);
+
+    walker.max_dim=max_dist+fabs(thr);
+    walker.offset = - thr;
+    walker.DiscretizeFlag = DiscretizeFlag;
+    walker.MultiSampleFlag = MultiSampleFlag;
+    walker.AbsDistFlag = AbsDistFlag;
+    walker.NarrowBandFlag = true;
+    walker.BuildMeshParallel(old_mesh,new_mesh,cb);
+  }
+
 
 };//end class resampler
 
@@ -0,0 +1,330 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *   
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __VCGLIB_DIFFERENTIAL_OPERATORS
+#define __VCGLIB_DIFFERENTIAL_OPERATORS
+
+#include <vcg/complex/complex.h>
+#include <Eigen/Sparse>
+
+namespace vcg {
+namespace tri {
+
+/** \brief Cached differential operators of a triangle mesh.
+ *
+ * Keeps, in compressed sparse form:
+ * - the cotangent Laplacian L (VN x VN): L(i,j) = -(cot(a_ij)+cot(b_ij))/2 for each edge, L(i,i) = -sum_j L(i,j);
+ *   the weights are the ones of Harmonic::CotangentWeight, border edges have only one angle;
+ * - the lumped mass matrix M (VN x VN): one third of the area of the incident faces on the diagonal;
+ * - the gradient G (3FN x VN): rows 3f..3f+2 give the gradient on face f of a per-vertex scalar field.
+ *
+ * Update() compares the mesh with the one of the last call: the sparsity pattern of L is rebuilt only when
+ * the connectivity changes, its values only when the geometry changes, otherwise nothing is done.
+ * M and G are built on their first access after an update that changed something.
+ * Everything is computed in parallel, one column per vertex, and summed in face order,
+ * so the result does not depend on the number of threads and L is exactly symmetric.
+ * The mesh must be compact and made only of triangles; no adjacency is needed.
+ */
+template <class MeshType, typename Scalar = double>
+class DifferentialOperators
+{
+public:
+    typedef typename MeshType::VertexType VertexType;
+    typedef typename MeshType::FaceType   FaceType;
+    typedef typename MeshType::CoordType  CoordType;
+    typedef Eigen::SparseMatrix<Scalar>   SparseMatrix;
+    typedef Point3<Scalar>                PointType;
+
+    DifferentialOperators() : valid(false), massValid(false), gradValid(false) {}
+
+    /// Brings the operators up to date with the mesh; returns true if something was recomputed.
+    bool Update(MeshType &m)
+    {
+        RequireCompactness(m);
+        MeshAssert<MeshType>::OnlyTriFace(m);
+        const bool sameConnectivity = valid && SameConnectivity(m);
+        if (sameConnectivity && SameGeometry(m))
+            return false;
+        if (!sameConnectivity)
+            BuildPattern(m);
+        ComputeValues(m);
+        valid = true;
+        massValid = gradValid = false;
+        return true;
+    }
+
+    /// Forces the recomputation at the next Update().
+    void Invalidate() { valid = false; }
+
+    bool IsValid() const { return valid; }
+
+    const SparseMatrix &CotLaplacian() const { return L; }
+
+    /// Built here on its first access after an update.
+    const SparseMatrix &Mass()
+    {
+        if (valid && !massValid) BuildMass();
+        return M;
+    }
+
+    /// Built here on its first access after an update.
+    const SparseMatrix &Gradient()
+    {
+        if (valid && !gradValid) BuildGradient();
+        return G;
+    }
+
+    /// For each non zero of CotLaplacian(), the number of faces sharing the corresponding edge (0 on the diagonal).
+    const std::vector<int> &EdgeFaceNum() const { return edgeFaceNum; }
+
+    /// Cotangent weight of the edge (i,j), i.e. -L(i,j); 0 if the vertices are not adjacent.
+    Scalar Weight(int i, int j) const
+    {
+        const int *b = L.innerIndexPtr() + L.outerIndexPtr()[j];
+        const int *e = L.innerIndexPtr() + L.outerIndexPtr()[j+1];
+        const int *p = std::lower_bound(b, e, i);
+        if (p == e || *p != i) return 0;
+        return -L.valuePtr()[p - L.innerIndexPtr()];
+    }
+
+private:
+    bool SameConnectivity(const MeshType &m) const
+    {
+        if (pos.size() != m.vert.size() || faceVert.size() != m.face.size()*3)
+            return false;
+        int diff = 0;
+#pragma omp parallel for schedule(static) reduction(+: diff)
+        for (int f = 0; f < int(m.face.size()); ++f)
+            for (int k = 0; k < 3; ++k)
+                if (faceVert[f*3+k] != int(tri::Index(m, m.face[f].cV(k)))) ++diff;
+        return diff == 0;
+    }
+
+    bool SameGeometry(const MeshType &m) const
+    {
+        int diff = 0;
+#pragma omp parallel for schedule(static) reduction(+: diff)
+        for (int i = 0; i < int(m.vert.size()); ++i)
+            if (pos[i] != m.vert[i].cP()) ++diff;
+        return diff == 0;
+    }
+
+    static void InitPattern(SparseMatrix &A, int rows, int cols, const std::vector<int> &outer, const std::vector<int> &inner)
+    {
+        A.resize(rows, cols);
+        A.resizeNonZeros(Eigen::Index(inner.size()));
+        std::copy(outer.begin(), outer.end(), A.outerIndexPtr());
+        std::copy(inner.begin(), inner.end(), A.innerIndexPtr());
+    }
+
+    void BuildPattern(const MeshType &m)
+    {
+        const int vn = int(m.vert.size());
+        const int fn = int(m.face.size());
+
+        faceVert.resize(size_t(fn)*3);
+        for (int f = 0; f < fn; ++f)
+            for (int k = 0; k < 3; ++k)
+                faceVert[f*3+k] = int(tri::Index(m, m.face[f].cV(k)));
+
+        // vertex -> incident corners, in face order
+        vfStart.assign(vn+1, 0);
+        for (size_t c = 0; c < faceVert.size(); ++c) ++vfStart[faceVert[c]+1];
+        for (int i = 0; i < vn; ++i) vfStart[i+1] += vfStart[i];
+        vfCorner.resize(faceVert.size());
+        std::vector<int> fill(vfStart.begin(), vfStart.end()-1);
+        for (size_t c = 0; c < faceVert.size(); ++c) vfCorner[fill[faceVert[c]]++] = int(c);
+
+        // columns of L: the vertex itself and its neighbours, sorted
+        std::vector<int> colNum(vn+1, 0);
+#pragma omp parallel
+        {
+            std::vector<int> nb;
+#pragma omp for schedule(dynamic, 1024)
+            for (int i = 0; i < vn; ++i)
+            {
+                Neighbours(i, nb);
+                colNum[i+1] = int(std::unique(nb.begin(), nb.end()) - nb.begin());
+            }
+        }
+        for (int i = 0; i < vn; ++i) colNum[i+1] += colNum[i];
+        std::vector<int> inner(colNum[vn]);
+        edgeFaceNum.assign(colNum[vn], 0);
+#pragma omp parallel
+        {
+            std::vector<int> nb;
+#pragma omp for schedule(dynamic, 1024)
+            for (int i = 0; i < vn; ++i)
+            {
+                Neighbours(i, nb);
+                int k = colNum[i] - 1;
+                for (size_t t = 0; t < nb.size(); ++t)
+                {
+                    if (t == 0 || nb[t] != nb[t-1]) inner[++k] = nb[t];
+                    if (nb[t] != i) ++edgeFaceNum[k];
+                }
+            }
+        }
+        InitPattern(L, vn, vn, colNum, inner);
+    }
+
+    /// Sorted list of the vertex i and of the other vertices of its faces, one entry for each face.
+    void Neighbours(int i, std::vector<int> &nb) const
+    {
+        nb.clear();
+        nb.push_back(i);
+        for (int c = vfStart[i]; c < vfStart[i+1]; ++c)
+        {
+            const int f = vfCorner[c]/3, k = vfCorner[c]%3;
+            nb.push_back(faceVert[f*3+(k+1)%3]);
+            nb.push_back(faceVert[f*3+(k+2)%3]);
+        }
+        std::sort(nb.begin(), nb.end());
+    }
+
+    /// Positions of the vertices of the face f at the last update, its doubled area and its normal scaled by it.
+    Scalar FacePoints(int f, PointType p[3], PointType &N) const
+    {
+        for (int k = 0; k < 3; ++k) p[k].Import(pos[faceVert[f*3+k]]);
+        N = (p[1]-p[0]) ^ (p[2]-p[0]);
+        return N.Norm();
+    }
+
+    void ComputeValues(const MeshType &m)
+    {
+        const int vn = int(m.vert.size());
+        const int fn = int(m.face.size());
+
+        pos.resize(vn);
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < vn; ++i)
+            pos[i] = m.vert[i].cP();
+
+        // per face: half cotangent of the angle of each corner
+        std::vector<Scalar> halfCot(size_t(fn)*3);
+#pragma omp parallel for schedule(static)
+        for (int f = 0; f < fn; ++f)
+        {
+            PointType p[3], N;
+            FacePoints(f, p, N);
+            for (int k = 0; k < 3; ++k)
+            {
+                const PointType &a = p[(k+1)%3], &b = p[k], &c = p[(k+2)%3];
+                const Scalar angle = vcg::Angle(a-b, c-b);
+                halfCot[f*3+k] = vcg::math::Cos(angle) / vcg::math::Sin(angle) / 2;
+            }
+        }
+
+        Scalar *lv = L.valuePtr();
+        const int *li = L.innerIndexPtr();
+        const int *lo = L.outerIndexPtr();
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int i = 0; i < vn; ++i)
+        {
+            const int *b = li + lo[i], *e = li + lo[i+1];
+            for (int t = lo[i]; t < lo[i+1]; ++t) lv[t] = 0;
+            for (int c = vfStart[i]; c < vfStart[i+1]; ++c)
+            {
+                const int f = vfCorner[c]/3, k = vfCorner[c]%3;
+                // the edge (i,j) is opposite to the corner k+2, the edge (i,h) to the corner k+1
+                const int j = faceVert[f*3+(k+1)%3], h = faceVert[f*3+(k+2)%3];
+                lv[std::lower_bound(b, e, j) - li] -= halfCot[f*3+(k+2)%3];
+                lv[std::lower_bound(b, e, h) - li] -= halfCot[f*3+(k+1)%3];
+            }
+            Scalar diag = 0;
+            for (int t = lo[i]; t < lo[i+1]; ++t) diag -= lv[t];
+            lv[std::lower_bound(b, e, i) - li] = diag;
+        }
+    }
+
+    /// The mass matrix is diagonal: one third of the area of the incident faces.
+    void BuildMass()
+    {
+        const int vn = int(pos.size());
+        const int fn = int(faceVert.size()/3);
+        std::vector<int> diagOuter(vn+1), diagInner(vn);
+        for (int i = 0; i <= vn; ++i) diagOuter[i] = i;
+        for (int i = 0; i < vn; ++i) diagInner[i] = i;
+        InitPattern(M, vn, vn, diagOuter, diagInner);
+
+        std::vector<Scalar> area(fn);
+#pragma omp parallel for schedule(static)
+        for (int f = 0; f < fn; ++f)
+        {
+            PointType p[3], N;
+            area[f] = FacePoints(f, p, N)/2;
+        }
+        Scalar *mv = M.valuePtr();
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int i = 0; i < vn; ++i)
+        {
+            Scalar a = 0;
+            for (int c = vfStart[i]; c < vfStart[i+1]; ++c)
+                a += area[vfCorner[c]/3];
+            mv[i] = a/3;
+        }
+        massValid = true;
+    }
+
+    /// Column i of G: three rows for each incident face, faces in increasing order,
+    /// holding the gradient of the hat function of i on the face.
+    void BuildGradient()
+    {
+        const int vn = int(pos.size());
+        const int fn = int(faceVert.size()/3);
+        std::vector<int> gOuter(vn+1), gInner(size_t(fn)*9);
+        for (int i = 0; i <= vn; ++i) gOuter[i] = vfStart[i]*3;
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int i = 0; i < vn; ++i)
+            for (int c = vfStart[i]; c < vfStart[i+1]; ++c)
+                for (int d = 0; d < 3; ++d)
+                    gInner[size_t(c)*3+d] = (vfCorner[c]/3)*3 + d;
+        InitPattern(G, fn*3, vn, gOuter, gInner);
+
+        Scalar *gv = G.valuePtr();
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int i = 0; i < vn; ++i)
+            for (int c = vfStart[i]; c < vfStart[i+1]; ++c)
+            {
+                const int f = vfCorner[c]/3, k = vfCorner[c]%3;
+                PointType p[3], N;
+                const Scalar dblA = FacePoints(f, p, N);
+                const PointType g = (N ^ (p[(k+2)%3]-p[(k+1)%3])) / (dblA*dblA);
+                for (int d = 0; d < 3; ++d)
+                    gv[size_t(c)*3+d] = g[d];
+            }
+        gradValid = true;
+    }
+
+    bool valid, massValid, gradValid;
+    std::vector<CoordType> pos;     // positions of the last update
+    std::vector<int> faceVert;      // vertex indexes of the faces at the last update
+    std::vector<int> vfStart;       // per vertex, first incident corner in vfCorner (size VN+1)
+    std::vector<int> vfCorner;      // incident corners (face*3+wedge), in face order
+    std::vector<int> edgeFaceNum;
+    SparseMatrix L, M, G;
+};
+
+} // end namespace tri
+} // end namespace vcg
+#endif // __VCGLIB_DIFFERENTIAL_OPERATORS
@@ -24,6 +24,7 @@
 #define __VCGLIB_HARMONIC_FIELD
 
 #include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/differential_operators.h>
 #include <Eigen/Sparse>
 
 namespace vcg {
@@ -43,6 +44,7 @@ public:
     typedef typename std::pair<VertexType *, Scalar> Constraint;
     typedef typename std::vector<Constraint>         ConstraintVec;
     typedef typename ConstraintVec::const_iterator   ConstraintIt;
+    typedef DifferentialOperators<MeshType, CoeffScalar> OperatorsType;
 
     /**
      * @brief ComputeScalarField
@@ -56,9 +58,20 @@ public:
      */
     template <typename ACCESSOR>
     static bool ComputeScalarField(MeshType & m, const ConstraintVec & constraints, ACCESSOR field, bool biharmonic = false)
+    {
+        OperatorsType ops;
+        return ComputeScalarField(m, constraints, field, ops, biharmonic);
+    }
+
+    /**
+     * @brief ComputeScalarField
+     * Same as above, but the cotangent Laplacian is taken from ops, that is updated only if the mesh changed
+     * since its last use: repeated solves with different constraints on the same mesh skip the assembly.
+     */
+    template <typename ACCESSOR>
+    static bool ComputeScalarField(MeshType & m, const ConstraintVec & constraints, ACCESSOR field, OperatorsType & ops, bool biharmonic = false)
     {
         typedef Eigen::SparseMatrix<CoeffScalar> SpMat;  // sparse matrix type
-        typedef Eigen::Triplet<CoeffScalar>      Triple; // triplet type to fill the matrix
 
         RequirePerVertexFlags(m);
         RequireCompactness(m);
@@ -71,49 +84,9 @@ public:
 
         int n  = m.VN();
 
-        // Generate coefficients
-        std::vector<Triple>          coeffs;   // coefficients of the system
-        std::map<size_t,CoeffScalar> sums;     // row sum of the coefficient matrix
-
-        vcg::tri::UpdateFlags<MeshType>::FaceClearV(m);
-        for (size_t i = 0; i < m.face.size(); ++i)
-        {
-            FaceType & f = m.face[i];
-            assert(!f.IsV());
-
-            f.SetV();
-
-            // Generate coefficients for each edge
-            for (int edge = 0; edge < 3; ++edge)
-            {
-                CoeffScalar weight;
-                WeightInfo res = CotangentWeightIfNotVisited(f, edge, weight);
-
-                if (res == EdgeAlreadyVisited) continue;
-                assert(res == Success);
-
-                // Add the weight to the coefficients vector for both the vertices of the considered edge
-                size_t v0_idx = vcg::tri::Index(m, f.V0(edge));
-                size_t v1_idx = vcg::tri::Index(m, f.V1(edge));
-
-                coeffs.push_back(Triple(v0_idx, v1_idx, -weight));
-                coeffs.push_back(Triple(v1_idx, v0_idx, -weight));
-
-                // Add the weight to the row sum
-                sums[v0_idx] += weight;
-                sums[v1_idx] += weight;
-            }
-        }
-
         // Setup the system matrix
-        SpMat laplaceMat;        // the system to be solved
-        laplaceMat.resize(n, n); // eigen initializes it to zero
-        laplaceMat.reserve(coeffs.size());
-        for (std::map<size_t,CoeffScalar>::const_iterator it = sums.begin(); it != sums.end(); ++it)
-        {
-            coeffs.push_back(Triple(it->first, it->first, it->second));
-        }
-        laplaceMat.setFromTriplets(coeffs.begin(), coeffs.end());
+        ops.Update(m);
+        SpMat laplaceMat = ops.CotLaplacian(); // the system to be solved
 
         if (biharmonic)
         {
@@ -27,6 +27,8 @@
 #include <vcg/complex/algorithms/mesh_to_matrix.h>
 #include <vcg/complex/algorithms/update/quality.h>
 #include <vcg/complex/algorithms/smooth.h>
+#include <vcg/math/sparse_solver_cache.h>
+#include <vcg/complex/algorithms/differential_operators.h>
 
 #define PENALTY 10000
 
@@ -245,8 +247,28 @@ private:
 
 public:
 
+    typedef SparseSolverCache<ScalarType> SolverCache;
+    typedef tri::DifferentialOperators<MeshType> OperatorsType;
 
     static void Compute(MeshType &mesh, Parameter &SParam)
+    {
+        SolverCache cache;
+        Compute(mesh,SParam,cache);
+    }
+
+    /// Same as above, but the factorization of the system is kept in the cache between calls:
+    /// if the connectivity and the parameters do not change the symbolic analysis is reused,
+    /// and if the system matrix does not change either (e.g. uniform weights without the mass matrix)
+    /// the call costs only the back-substitution. The cache checks the system matrix, so it is safe to reuse it on any mesh.
+    static void Compute(MeshType &mesh, Parameter &SParam, SolverCache &cache)
+    {
+        OperatorsType ops;
+        Compute(mesh,SParam,cache,ops);
+    }
+
+    /// Same as above, also keeping the cotangent weights in ops, that are recomputed only if the mesh changed
+    /// (e.g. when smoothing the quality, SmoothQ, of the same mesh many times).
+    static void Compute(MeshType &mesh, Parameter &SParam, SolverCache &cache, OperatorsType &ops)
     {
         //calculate the size of the system
         int matr_size=mesh.vert.size()+SParam.ConstrainedF.size();
@@ -310,16 +332,17 @@ public:
         else
             InitSparse(IndexB,ValuesB,matr_size,matr_size,B);
 
-        //get the entries for laplacian matrix
-        std::vector<std::pair<int,int> > IndexL;
-        std::vector<ScalarType> ValuesL;
-        MeshToMatrix<MeshType>::GetLaplacianMatrix(mesh,IndexL,ValuesL,SParam.useCotWeight,SParam.lapWeight,!SParam.SmoothQ);
-
-        //initialize sparse laplacian matrix
-        if (!SParam.SmoothQ)
-            InitSparse(IndexL,ValuesL,matr_size*3,matr_size*3,L);
+        //build the sparse laplacian matrix, from the cached operators for compact triangle meshes
+        int L_size=(!SParam.SmoothQ)?(matr_size*3):matr_size;
+        if (!FaceType::HasPolyInfo() && mesh.vn==int(mesh.vert.size()) && mesh.fn==int(mesh.face.size()))
+            MeshToMatrix<MeshType>::GetLaplacianMatrix(mesh,ops,L,L_size,SParam.useCotWeight,SParam.lapWeight,!SParam.SmoothQ);
         else
-            InitSparse(IndexL,ValuesL,matr_size,matr_size,L);
+        {
+            std::vector<std::pair<int,int> > IndexL;
+            std::vector<ScalarType> ValuesL;
+            MeshToMatrix<MeshType>::GetLaplacianMatrix(mesh,IndexL,ValuesL,SParam.useCotWeight,SParam.lapWeight,!SParam.SmoothQ);
+            InitSparse(IndexL,ValuesL,L_size,L_size,L);
+        }
 
         for (int i=0;i<(SParam.degree-1);i++)L=L*L;
 
@@ -327,8 +350,9 @@ public:
         Eigen::SparseMatrix<ScalarType> S = (M + B + SParam.lambda*L);
 
         //SimplicialLDLT
-        Eigen::SimplicialCholesky<Eigen::SparseMatrix<ScalarType > > solver(S);
-        assert(solver.info() == Eigen::Success);
+        bool factorized = cache.Factorize(S);
+        assert(factorized);
+        (void)factorized;
 
         MatrixXm V;
         if (!SParam.SmoothQ)
@@ -365,7 +389,7 @@ public:
         }
 
         //solve the system
-        V = solver.solve(M*V).eval();
+        V = cache.Solve(M*V);
 
         //then copy back values
         if (!SParam.SmoothQ)
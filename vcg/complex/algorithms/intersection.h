@@ -314,32 +314,16 @@ bool IntersectionRayMesh(
 	return hit;
 }
 
-/** 
-    Compute the intersection between a mesh and a ball. 
-		given a mesh return a new mesh made by a copy of all the faces entirely includeded in the ball plus
-		new faces created by refining the ones intersected by the ball border.
-		It works by recursively splitting the triangles that cross the border, as long as their area is greater than
-		a given value tol. If no value is provided, 1/10^5*2*pi*radius is used 
-		NOTE: the returned mesh is a triangle soup 
-*/
+/// Refine the triangle soup res, made of the faces that intersect the ball, splitting the faces that cross its
+/// border as long as their area is greater than tol, and removing the ones that end outside of it.
 template < typename  TriMeshType, class ScalarType>
-void IntersectionBallMesh(	 TriMeshType & m, const vcg::Sphere3<ScalarType> &ball, TriMeshType & res,
-													float tol = 0){
-
+void IntersectionBallMeshRefine(const vcg::Sphere3<ScalarType> &ball, TriMeshType & res, float tol)
+{
 	typename TriMeshType::VertexIterator v0,v1,v2;
 	typename TriMeshType::FaceIterator fi;
-	std::vector<typename TriMeshType:: FaceType*> closests;
 	vcg::Point3<ScalarType>	witness;
 	std::pair<ScalarType, ScalarType> info;
 
-	if(tol == 0) tol = M_PI * ball.Radius() * ball.Radius() / 100000;
-	tri::UpdateSelection<TriMeshType>::FaceClear(m);
-	for(fi = m.face.begin(); fi != m.face.end(); ++fi)
-	if(!(*fi).IsD() && IntersectionSphereTriangle<ScalarType>(ball  ,(*fi), witness , &info))
-	  (*fi).SetS();
-
-	res.Clear();
-	tri::Append<TriMeshType,TriMeshType>::Selected(res,m);
 	int i =0;
 	while(i<res.fn){
 		 bool allIn = ( ball.IsIn(res.face[i].P(0)) && ball.IsIn(res.face[i].P(1))&&ball.IsIn(res.face[i].P(2)));
@@ -385,72 +369,79 @@ void IntersectionBallMesh(	 TriMeshType & m, const vcg::Sphere3<ScalarType> &bal
 	}
 }
 
-
-template < typename  TriMeshType, class ScalarType, class IndexingType>
-void IntersectionBallMesh( IndexingType * grid,	 TriMeshType & m, const vcg::Sphere3<ScalarType> &ball, TriMeshType & res,
+/** 
+    Compute the intersection between a mesh and a ball. 
+		given a mesh return a new mesh made by a copy of all the faces entirely includeded in the ball plus
+		new faces created by refining the ones intersected by the ball border.
+		It works by recursively splitting the triangles that cross the border, as long as their area is greater than
+		a given value tol. If no value is provided, 1/10^5*2*pi*radius is used 
+		NOTE: the returned mesh is a triangle soup 
+*/
+template < typename  TriMeshType, class ScalarType>
+void IntersectionBallMesh(	 TriMeshType & m, const vcg::Sphere3<ScalarType> &ball, TriMeshType & res,
 													float tol = 0){
 
-	typename TriMeshType::VertexIterator v0,v1,v2;
-	typename std::vector<typename TriMeshType::FacePointer >::iterator  cfi;
 	typename TriMeshType::FaceIterator fi;
-	std::vector<typename TriMeshType:: FaceType*> closestsF,closests;
 	vcg::Point3<ScalarType>	witness;
-	std::vector<vcg::Point3<ScalarType> > witnesses;
-	std::vector<ScalarType>	distances;
 	std::pair<ScalarType, ScalarType> info;
 
 	if(tol == 0) tol = M_PI * ball.Radius() * ball.Radius() / 100000;
-
-	vcg::tri::GetInSphereFaceBase(m,*grid, ball.Center(), ball.Radius(),closestsF,distances,witnesses);
-	for(cfi =closestsF.begin(); cfi != closestsF.end(); ++cfi)
-	if(!(**cfi).IsD() && IntersectionSphereTriangle<ScalarType>(ball  ,(**cfi), witness , &info))
-		closests.push_back(&(**cfi));
+	tri::UpdateSelection<TriMeshType>::FaceClear(m);
+	for(fi = m.face.begin(); fi != m.face.end(); ++fi)
+	if(!(*fi).IsD() && IntersectionSphereTriangle<ScalarType>(ball  ,(*fi), witness , &info))
+	  (*fi).SetS();
 
 	res.Clear();
-	SubSet(res,closests);
-	int i =0;
-	while(i<res.fn){
-		 bool allIn = ( ball.IsIn(res.face[i].P(0)) && ball.IsIn(res.face[i].P(1))&&ball.IsIn(res.face[i].P(2)));
-		if( IntersectionSphereTriangle<ScalarType>(ball  ,res.face[i], witness , &info) && !allIn){
-				if(vcg::DoubleArea(res.face[i]) > tol)
-				{
-				// split the face res.face[i] in four, add the four new faces to the mesh and delete the face res.face[i]
-				v0 = vcg::tri::Allocator<TriMeshType>::AddVertices(res,3);	
-				fi = vcg::tri::Allocator<TriMeshType>::AddFaces(res,4);	
-				
-				v1 = v0; ++v1;
-				v2 = v1; ++v2;
-				(*v0).P() = (res.face[i].P(0) + res.face[i].P(1))*0.5;
-				(*v1).P() = (res.face[i].P(1) + res.face[i].P(2))*0.5;
-				(*v2).P() = (res.face[i].P(2) + res.face[i].P(0))*0.5;
+	tri::Append<TriMeshType,TriMeshType>::Selected(res,m);
+	IntersectionBallMeshRefine(ball,res,tol);
+}
 
-				(*fi).V(0) = res.face[i].V(0);
-				(*fi).V(1) = &(*v0);
-				(*fi).V(2) = &(*v2);	
-				++fi;
 
-				(*fi).V(0) = res.face[i].V(1);
-				(*fi).V(1) = &(*v1);
-				(*fi).V(2) = &(*v0);	
-				++fi;
+/**
+	Same as above, but only the given candidate faces of the mesh (e.g. the result of a spatial query, possibly with
+	duplicates) are tested. The faces are copied in res as a triangle soup; the mesh of the candidates
+	is not modified, so different threads can run it on the same mesh.
+*/
+template < typename  TriMeshType, class ScalarType>
+void IntersectionBallMesh(const std::vector<typename TriMeshType::FaceType*> &candidates, const vcg::Sphere3<ScalarType> &ball, TriMeshType & res,
+													float tol = 0){
+	std::vector<typename TriMeshType::FaceType*> closests;
+	vcg::Point3<ScalarType>	witness;
+	std::pair<ScalarType, ScalarType> info;
 
-				(*fi).V(0) = &(*v0);
-				(*fi).V(1) = &(*v1);
-				(*fi).V(2) = &(*v2);	
-				++fi;
+	if(tol == 0) tol = M_PI * ball.Radius() * ball.Radius() / 100000;
 
-				(*fi).V(0) = &(*v2);
-				(*fi).V(1) = &(*v1);
-				(*fi).V(2) = res.face[i].V(2) ;	
+	for(size_t k=0; k<candidates.size(); ++k)
+	if(!candidates[k]->IsD() && IntersectionSphereTriangle<ScalarType>(ball  ,*candidates[k], witness , &info))
+		closests.push_back(candidates[k]);
+	std::sort(closests.begin(),closests.end());
+	closests.erase(std::unique(closests.begin(),closests.end()),closests.end());
 
-				vcg::tri::Allocator<TriMeshType>::DeleteFace(res,res.face[i]);
-			}
-		}// there was no intersection with the boundary
+	res.Clear();
+	if(closests.empty()) return;
+	typename TriMeshType::VertexIterator vi = vcg::tri::Allocator<TriMeshType>::AddVertices(res,3*closests.size());
+	typename TriMeshType::FaceIterator fi = vcg::tri::Allocator<TriMeshType>::AddFaces(res,closests.size());
+	for(size_t k=0; k<closests.size(); ++k,++fi)
+		for(int j=0; j<3; ++j,++vi)
+		{
+			(*vi).P() = closests[k]->cP(j);
+			(*fi).V(j) = &*vi;
+		}
+	IntersectionBallMeshRefine(ball,res,tol);
+}
 
-	if(info.first > 0.0) // closest point - radius. If >0 is outside
-		vcg::tri::Allocator<TriMeshType>::DeleteFace(res,res.face[i]);
-	++i;
-	}
+template < typename  TriMeshType, class ScalarType, class IndexingType>
+void IntersectionBallMesh( IndexingType * grid,	 TriMeshType & m, const vcg::Sphere3<ScalarType> &ball, TriMeshType & res,
+													float tol = 0){
+
+	std::vector<typename TriMeshType:: FaceType*> closestsF;
+	std::vector<vcg::Point3<ScalarType> > witnesses;
+	std::vector<ScalarType>	distances;
+
+	if(tol == 0) tol = M_PI * ball.Radius() * ball.Radius() / 100000;
+
+	vcg::tri::GetInSphereFaceBase(m,*grid, ball.Center(), ball.Radius(),closestsF,distances,witnesses);
+	IntersectionBallMesh(closestsF,ball,res,tol);
 }
 
 /*@}*/
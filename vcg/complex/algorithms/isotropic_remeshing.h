@@ -93,6 +93,9 @@ public:
 		bool surfDistCheck = true;
 
 		bool adapt=false;
+		// when set, the swap and collapse passes test the candidate edges concurrently and apply
+		// them in rounds of non overlapping operations (see ImproveValenceParallel and ParallelCollapse)
+		bool parallelFlag=false;
 		int iter=1;
 		Stat stat;
 		void SetTargetLen(const ScalarType len)
@@ -115,6 +118,9 @@ public:
 	} Params;
 
 private:
+	// number of faces tested together by the parallel collapse sweeps
+	static int ParallelBlockSize() { return 1<<12; }
+
 	static void debug_crease (MeshType & toRemesh, std::string  prepend, int i)
 	{
 		ForEachVertex(toRemesh, [] (VertexType & v) {
@@ -377,13 +383,23 @@ private:
 		return (int)(std::ceil(angleSumRad / (M_PI/3.0f)));
 	}
 
-	static bool testHausdorff (MeshType & m, StaticGrid & grid, const std::vector<CoordType> & verts, const ScalarType maxD)
+	// Closest face query on the reference grid. It does not use the face marks of the
+	// reference mesh, so it can be issued concurrently by many threads.
+	static FaceType * closestFace(StaticGrid & grid, const CoordType & p, const ScalarType maxD, ScalarType & dist, CoordType & closest)
+	{
+		face::PointDistanceBaseFunctor<ScalarType> distFunct;
+		EmptyTMark<MeshType> noMark;
+		dist = maxD;
+		return grid.GetClosest(distFunct, noMark, p, maxD, dist, closest);
+	}
+
+	static bool testHausdorff (MeshType & /*m*/, StaticGrid & grid, const std::vector<CoordType> & verts, const ScalarType maxD)
 	{
 		for (CoordType v : verts)
 		{
 			CoordType closest;
 			ScalarType dist = 0;
-			FaceType* fp = GetClosestFaceBase(m, grid, v, maxD, dist, closest);
+			FaceType* fp = closestFace(grid, v, maxD, dist, closest);
 
 			if (fp == NULL)
 			{
@@ -607,54 +623,121 @@ private:
 		return pos == start;
 	}
 
+	// true if the i-th edge of f should be flipped; it only reads the mesh
+	static bool testValenceSwap(FaceType &f, const int i, Params &params)
+	{
+		if (&f <= f.cFFp(i))
+			return false;
+
+		PosType pi(&f, i);
+		CoordType swapEdgeMidPoint = (f.cP2(i) + f.cFFp(i)->cP2(f.cFFi(i))) / 2.;
+		std::vector<CoordType> toCheck(1, swapEdgeMidPoint);
+
+		return ((!params.selectedOnly) || (f.IsS() && f.cFFp(i)->IsS())) &&
+		       !face::IsBorder(f, i) &&
+		       face::IsManifold(f, i) && /*checkManifoldness(f, i) &&*/
+		       face::checkFlipEdgeNotManifold(f, i) &&
+		       testSwap(pi, params.creaseAngleCosThr) &&
+		       (!params.surfDistCheck || testHausdorff(*params.mProject, params.grid, toCheck, params.maxSurfDist)) &&
+		       face::CheckFlipEdgeNormal(f, i, vcg::math::ToRad(5.));
+	}
+
+	static void applyValenceSwap(FaceType &f, const int i, Params &params)
+	{
+		//When doing the swap we need to preserve and update the crease info accordingly
+		FaceType* g = f.cFFp(i);
+		int w = f.FFi(i);
+
+		bool creaseF = g->IsFaceEdgeS((w + 1) % 3);
+		bool creaseG = f.IsFaceEdgeS((i + 1) % 3);
+
+		face::FlipEdgeNotManifold(f, i);
+
+		f.ClearFaceEdgeS((i + 1) % 3);
+		g->ClearFaceEdgeS((w + 1) % 3);
+
+		if (creaseF)
+			f.SetFaceEdgeS(i);
+		if (creaseG)
+			g->SetFaceEdgeS(w);
+
+		++params.stat.flipNum;
+	}
+
 	// Edge swap step: edges are flipped in order to optimize valence and triangle quality across the mesh
 	static void ImproveValence(MeshType &m, Params &params)
 	{
-		static ScalarType foldCheckRad = math::ToRad(5.);
 		tri::UpdateTopology<MeshType>::FaceFace(m);
+		if (params.parallelFlag)
+		{
+			ImproveValenceParallel(m, params);
+			return;
+		}
 		tri::UpdateTopology<MeshType>::VertexFace(m);
 		ForEachFace(m, [&] (FaceType & f) {
 //			if (face::IsManifold(f, 0) && face::IsManifold(f, 1) && face::IsManifold(f, 2))
 				for (int i = 0; i < 3; ++i)
 				{
-					if (&f > f.cFFp(i))
+					if (testValenceSwap(f, i, params))
 					{
-						PosType pi(&f, i);
-						CoordType swapEdgeMidPoint = (f.cP2(i) + f.cFFp(i)->cP2(f.cFFi(i))) / 2.;
-						std::vector<CoordType> toCheck(1, swapEdgeMidPoint);
-
-
-						if(((!params.selectedOnly) || (f.IsS() && f.cFFp(i)->IsS())) &&
-						   !face::IsBorder(f, i) &&
-						   face::IsManifold(f, i) && /*checkManifoldness(f, i) &&*/
-						   face::checkFlipEdgeNotManifold(f, i) &&
-						   testSwap(pi, params.creaseAngleCosThr) &&
-						   (!params.surfDistCheck || testHausdorff(*params.mProject, params.grid, toCheck, params.maxSurfDist)) &&
-						   face::CheckFlipEdgeNormal(f, i, vcg::math::ToRad(5.)))
-						{
-							//When doing the swap we need to preserve and update the crease info accordingly
-							FaceType* g = f.cFFp(i);
-							int w = f.FFi(i);
-
-							bool creaseF = g->IsFaceEdgeS((w + 1) % 3);
-							bool creaseG = f.IsFaceEdgeS((i + 1) % 3);
-
-							face::FlipEdgeNotManifold(f, i);
+						applyValenceSwap(f, i, params);
+						break;
+					}
+				}
+		});
+	}
 
-							f.ClearFaceEdgeS((i + 1) % 3);
-							g->ClearFaceEdgeS((w + 1) % 3);
+	// Parallel version of the swap pass. Each round tests the edges of the active faces concurrently
+	// (every face proposes its first flippable edge, as in the sequential sweep), then the proposals
+	// are applied in face order skipping the ones that share a vertex with a flip already done
+	// in the same round: the outcome of a test depends only on the valence, position and
+	// adjacency of the four vertices of the flip, so vertex disjoint flips do not invalidate each other.
+	// Skipped faces are tested again in the next round. The result does not depend on the number of threads.
+	static void ImproveValenceParallel(MeshType &m, Params &params)
+	{
+		std::vector<int> active;
+		for (size_t i = 0; i < m.face.size(); ++i)
+			if (!m.face[i].IsD())
+				active.push_back(int(i));
 
-							if (creaseF)
-								f.SetFaceEdgeS(i);
-							if (creaseG)
-								g->SetFaceEdgeS(w);
+		std::vector<int> lock(m.vert.size(), -1);
+		for (int round = 0; !active.empty(); ++round)
+		{
+			tri::UpdateTopology<MeshType>::VertexFace(m);
 
-							++params.stat.flipNum;
-							break;
-						}
+			std::vector<signed char> edge(active.size(), -1);
+#pragma omp parallel for schedule(dynamic, 1024)
+			for (int k = 0; k < int(active.size()); ++k)
+			{
+				FaceType &f = m.face[active[k]];
+				for (int i = 0; i < 3; ++i)
+					if (testValenceSwap(f, i, params))
+					{
+						edge[k] = i;
+						break;
 					}
+			}
+
+			std::vector<int> deferred;
+			for (size_t k = 0; k < active.size(); ++k)
+			{
+				if (edge[k] < 0)
+					continue;
+				FaceType &f = m.face[active[k]];
+				const int i = edge[k];
+				const int vi[4] = { int(tri::Index(m, f.V0(i))), int(tri::Index(m, f.V1(i))),
+				                    int(tri::Index(m, f.V2(i))), int(tri::Index(m, f.FFp(i)->V2(f.FFi(i)))) };
+				if (lock[vi[0]] == round || lock[vi[1]] == round || lock[vi[2]] == round || lock[vi[3]] == round)
+				{
+					deferred.push_back(active[k]);
+					continue;
 				}
-		});
+				for (int j = 0; j < 4; ++j)
+					lock[vi[j]] = round;
+				applyValenceSwap(f, i, params);
+			}
+			active.swap(deferred);
+		}
 	}
 
 	// The predicate that defines which edges should be split
@@ -663,11 +746,15 @@ private:
 	public:
 		int count = 0;
 		ScalarType length, lengthThr, minQ, maxQ;
-		bool operator()(PosType &ep)
+		bool Test(const PosType &ep) const
 		{
 			ScalarType mult = math::ClampedLerp((ScalarType)0.5,(ScalarType)1.5, (((math::Abs(ep.V()->Q())+math::Abs(ep.VFlip()->Q()))/(ScalarType)2.0)/(maxQ-minQ)));
 			ScalarType dist = Distance(ep.V()->P(), ep.VFlip()->P());
-			if(dist > std::max(mult*length,lengthThr*2))
+			return dist > std::max(mult*length,lengthThr*2);
+		}
+		bool operator()(PosType &ep)
+		{
+			if(Test(ep))
 			{
 				++count;
 				return true;
@@ -682,9 +769,13 @@ private:
 	public:
 		int count = 0;
 		ScalarType squaredlengthThr;
+		bool Test(const PosType &ep) const
+		{
+			return SquaredDistance(ep.V()->P(), ep.VFlip()->P()) > squaredlengthThr;
+		}
 		bool operator()(PosType &ep)
 		{
-			if(SquaredDistance(ep.V()->P(), ep.VFlip()->P()) > squaredlengthThr)
+			if(Test(ep))
 			{
 				++count;
 				return true;
@@ -694,6 +785,17 @@ private:
 		}
 	};
 
+	// RefineEParallel evaluates the predicate concurrently on both sides of every edge:
+	// it gets only the (const) test, the splits are counted from the added vertices
+	template <class EdgePred>
+	class ConcurrentSplitPred
+	{
+	public:
+		const EdgePred &pred;
+		ConcurrentSplitPred(const EdgePred &p) : pred(p) {}
+		bool operator()(PosType &ep) const { return pred.Test(ep); }
+	};
+
 	//Split pass: This pass uses the tri::RefineE from the vcglib to implement
 	//the refinement step, using EdgeSplitPred as a predicate to decide whether to split or not
 	static void SplitLongEdges(MeshType &m, Params &params)
@@ -709,14 +811,34 @@ private:
 			ep.maxQ      = maxQ;
 			ep.length    = params.maxLength;
 			ep.lengthThr = params.lengthThr;
-			tri::RefineE(m,midFunctor,ep);
-			params.stat.splitNum+=ep.count;
+			if(params.parallelFlag)
+			{
+				ConcurrentSplitPred<EdgeSplitAdaptPred> cp(ep);
+				const int vn = m.vn;
+				tri::RefineEParallel(m,midFunctor,cp);
+				params.stat.splitNum+=m.vn-vn;
+			}
+			else
+			{
+				tri::RefineE(m,midFunctor,ep);
+				params.stat.splitNum+=ep.count;
+			}
 		}
 		else {
 			EdgeSplitLenPred ep;
 			ep.squaredlengthThr = params.maxLength*params.maxLength;
-			tri::RefineMidpoint(m, ep, params.selectedOnly);
-			params.stat.splitNum+=ep.count;
+			if(params.parallelFlag)
+			{
+				ConcurrentSplitPred<EdgeSplitLenPred> cp(ep);
+				const int vn = m.vn;
+				tri::RefineMidpointParallel(m, cp, params.selectedOnly);
+				params.stat.splitNum+=m.vn-vn;
+			}
+			else
+			{
+				tri::RefineMidpoint(m, ep, params.selectedOnly);
+				params.stat.splitNum+=ep.count;
+			}
 		}
 	}
 
@@ -916,6 +1038,13 @@ private:
 		SelectionStack<MeshType> ss(m);
 		ss.push();
 
+		if(params.parallelFlag)
+		{
+			tri::UpdateTopology<MeshType>::FaceFace(m);
+			Clean<MeshType>::CountNonManifoldVertexFF(m,true);
+			params.stat.collapseNum += ParallelCollapse(m, params, minQ, maxQ, false);
+		}
+		else
 		{
 			tri::UpdateTopology<MeshType>::FaceFace(m);
 			Clean<MeshType>::CountNonManifoldVertexFF(m,true);
@@ -1084,6 +1213,13 @@ private:
 		ss.push();
 
 
+		if(params.parallelFlag)
+		{
+			tri::UpdateTopology<MeshType>::FaceFace(m);
+			Clean<MeshType>::CountNonManifoldVertexFF(m,true);
+			params.stat.collapseNum += ParallelCollapse(m, params, 0, 0, true);
+		}
+		else
 		{
 			tri::UpdateTopology<MeshType>::FaceFace(m);
 			Clean<MeshType>::CountNonManifoldVertexFF(m,true);
@@ -1128,6 +1264,112 @@ private:
 		Allocator<MeshType>::CompactEveryVector(m);
 	}
 
+	// Parallel version of the collapse sweeps (crossOnly selects the CollapseCrosses one).
+	// The faces are swept in order in blocks of ParallelBlockSize(). The faces of a block are tested
+	// concurrently against the current mesh (each face proposes the first edge passing testCollapse1
+	// and the link conditions, as in the sequential sweep), then the proposals are applied in face order.
+	// A test reads only the faces incident on the two endpoints, so a proposal whose endpoint one-rings
+	// touch the one-rings of a collapse already applied in the same block is not applied and its face is
+	// moved to the next block, to be tested again. The result does not depend on the number of threads.
+	// VF adjacency must be up to date; it returns the number of collapses.
+	static int ParallelCollapse(MeshType &m, Params &params, ScalarType minQ, ScalarType maxQ, bool crossOnly)
+	{
+		int collapseNum = 0;
+		std::vector<int> faces;
+		for (size_t i = 0; i < m.face.size(); ++i)
+			if (!m.face[i].IsD() && (!params.selectedOnly || m.face[i].IsS()))
+				faces.push_back(int(i));
+
+		std::vector<int> lock(m.vert.size(), -1);
+		std::vector<int> block, deferred, ring;
+		std::vector<VertexPair> pairs;
+		std::vector<CoordType> mps;
+		std::vector<char> proposed;
+		size_t next = 0;
+		for (int round = 0; next < faces.size() || !block.empty(); ++round)
+		{
+			while (block.size() < size_t(ParallelBlockSize()) && next < faces.size())
+				block.push_back(faces[next++]);
+
+			pairs.resize(block.size());
+			mps.resize(block.size());
+			proposed.assign(block.size(), 0);
+#pragma omp parallel for schedule(dynamic, 64)
+			for (int k = 0; k < int(block.size()); ++k)
+			{
+				FaceType &f = m.face[block[k]];
+				// a face deferred by the previous block may have been removed by a later collapse
+				if (f.IsD())
+					continue;
+				for (int i = 0; i < 3; ++i)
+				{
+					PosType pi(&f, i);
+					if (crossOnly)
+					{
+						if (pi.V()->IsB())
+							continue;
+						int valence = 0;
+						for (face::VFIterator<FaceType> vfi(pi.V()); !vfi.End(); ++vfi)
+							++valence;
+						if (valence != 3 && valence != 4)
+							continue;
+					}
+					VertexPair bp = VertexPair(pi.V(), pi.VFlip());
+					Point3<ScalarType> mp = (pi.V()->P()+pi.VFlip()->P())/2.f;
+					if (testCollapse1(pi, mp, minQ, maxQ, params, crossOnly) && Collapser::LinkConditions(bp))
+					{
+						//collapsing on pi.V()
+						pairs[k] = VertexPair(pi.VFlip(), pi.V());
+						mps[k] = mp;
+						proposed[k] = 1;
+						break;
+					}
+				}
+			}
+
+			deferred.clear();
+			for (size_t k = 0; k < block.size(); ++k)
+			{
+				if (!proposed[k] || m.face[block[k]].IsD())
+					continue;
+
+				// a collapse that changes the faces around an endpoint locks the endpoint itself
+				VertexPair &bp = pairs[k];
+				if (lock[tri::Index(m, bp.V(0))] == round || lock[tri::Index(m, bp.V(1))] == round)
+				{
+					deferred.push_back(block[k]);
+					continue;
+				}
+
+				ring.clear();
+				for (int j = 0; j < 2; ++j)
+				{
+					ring.push_back(int(tri::Index(m, bp.V(j))));
+					for (face::VFIterator<FaceType> vfi(bp.V(j)); !vfi.End(); ++vfi)
+					{
+						ring.push_back(int(tri::Index(m, vfi.V1())));
+						ring.push_back(int(tri::Index(m, vfi.V2())));
+					}
+				}
+				bool free = true;
+				for (size_t j = 0; j < ring.size() && free; ++j)
+					free = lock[ring[j]] != round;
+				if (!free)
+				{
+					deferred.push_back(block[k]);
+					continue;
+				}
+				for (size_t j = 0; j < ring.size(); ++j)
+					lock[ring[j]] = round;
+
+				Collapser::Do(m, bp, mps[k], true);
+				++collapseNum;
+			}
+			block.swap(deferred);
+		}
+		return collapseNum;
+	}
+
 	// This function sets the selection bit on vertices that lie on creases
 	static int selectVertexFromCrease(MeshType &m, ScalarType creaseThr)
 	{
@@ -1208,37 +1450,67 @@ private:
 			TD.Init(lpz);
 			vcg::tri::Smooth<MeshType>::AccumulateLaplacianInfo(m, TD, false);
 
-			for (auto fi = m.face.begin(); fi != m.face.end(); ++fi)
-			{
-				std::vector<CoordType> newPos(4);
+			auto relaxedPos = [&] (FaceType &f, CoordType *newPos) -> bool {
 				bool moving = false;
-
 				for (int j = 0; j < 3; ++j)
 				{
-					newPos[j] = fi->cP(j);
-					if (!fi->V(j)->IsD() && TD[fi->V(j)].cnt > 0)
+					newPos[j] = f.cP(j);
+					if (!f.V(j)->IsD() && TD[f.V(j)].cnt > 0)
 					{
-						if (fi->V(j)->IsS())
+						if (f.V(j)->IsS())
 						{
-							newPos[j] = (fi->V(j)->P() + TD[fi->V(j)].sum) / (TD[fi->V(j)].cnt + 1);
+							newPos[j] = (f.V(j)->P() + TD[f.V(j)].sum) / (TD[f.V(j)].cnt + 1);
 							moving = true;
 						}
 					}
 				}
+				return moving;
+			};
 
-				if (moving)
+			if (!params.parallelFlag)
+			{
+				for (auto fi = m.face.begin(); fi != m.face.end(); ++fi)
 				{
-//					const CoordType oldN = vcg::NormalizedTriangleNormal(*fi);
-//					const CoordType newN = vcg::Normal(newPos[0], newPos[1], newPos[2]).Normalize();
+					std::vector<CoordType> newPos(4);
+					if (relaxedPos(*fi, &newPos[0]))
+					{
+//						const CoordType oldN = vcg::NormalizedTriangleNormal(*fi);
+//						const CoordType newN = vcg::Normal(newPos[0], newPos[1], newPos[2]).Normalize();
+
+						newPos[3] = (newPos[0] + newPos[1] + newPos[2]) / 3.;
+						if (/*(strict || oldN * newN > 0.99) &&*/ (!params.surfDistCheck || testHausdorff(*params.mProject, params.grid, newPos, maxDist)))
+						{
+							for (int j = 0; j < 3; ++j)
+								fi->V(j)->P() = newPos[j];
+						}
+					}
+				}
+				continue;
+			}
 
+			// Parallel mode: every face is tested against the positions at the start of the step
+			// and the tested positions are stored, then the accepted ones are applied in face order.
+			std::vector<CoordType> facePos(m.face.size() * 3);
+			std::vector<char> accepted(m.face.size(), 0);
+#pragma omp parallel for schedule(dynamic, 1024)
+			for (int k = 0; k < int(m.face.size()); ++k)
+			{
+				std::vector<CoordType> newPos(4);
+				if (relaxedPos(m.face[k], &newPos[0]))
+				{
 					newPos[3] = (newPos[0] + newPos[1] + newPos[2]) / 3.;
-					if (/*(strict || oldN * newN > 0.99) &&*/ (!params.surfDistCheck || testHausdorff(*params.mProject, params.grid, newPos, maxDist)))
+					if (!params.surfDistCheck || testHausdorff(*params.mProject, params.grid, newPos, maxDist))
 					{
-						for (int j = 0; j < 3; ++j)
-							fi->V(j)->P() = newPos[j];
+						accepted[k] = 1;
+						std::copy(newPos.begin(), newPos.begin() + 3, facePos.begin() + 3 * k);
 					}
 				}
 			}
+
+			for (size_t k = 0; k < m.face.size(); ++k)
+				if (accepted[k])
+					for (int j = 0; j < 3; ++j)
+						m.face[k].V(j)->P() = facePos[3 * k + j];
 		}
 	}
 
@@ -1286,13 +1558,17 @@ private:
 				}
 			}
 
-			for (auto vi = m.vert.begin(); vi != m.vert.end(); ++vi)
-				if (!(*vi).IsD() && TD[*vi].cnt > 0)
+#pragma omp parallel for schedule(dynamic, 1024)
+			for (int i = 0; i < int(m.vert.size()); ++i)
+			{
+				VertexType &v = m.vert[i];
+				if (!v.IsD() && TD[v].cnt > 0)
 				{
-					std::vector<CoordType> newPos(1, TD[*vi].sum);
-					if ((*vi).IsS() && testHausdorff(*params.mProject, params.grid, newPos, params.maxSurfDist))
-						(*vi).P() = (*vi).P() * (1-delta) + TD[*vi].sum * (delta);
+					std::vector<CoordType> newPos(1, TD[v].sum);
+					if (v.IsS() && testHausdorff(*params.mProject, params.grid, newPos, params.maxSurfDist))
+						v.P() = v.P() * (1-delta) + TD[v].sum * (delta);
 				}
+			}
 		} // end step
 	}
 
@@ -1341,20 +1617,38 @@ private:
 	*/
 	//TODO: improve crease reprojection:
 	//		crease verts should reproject only on creases.
+	//		The vertices are processed in parallel, sorted by grid cell so that each batch
+	//		of queries visits a compact region of the grid.
 	static void ProjectToSurface(MeshType &m, Params & params)
 	{
-		for(auto vi=m.vert.begin();vi!=m.vert.end();++vi)
-			if(!(*vi).IsD())
+		std::vector<std::pair<long long, int> > order;
+		order.reserve(m.vn);
+		const Point3i siz = params.grid.siz;
+		for (size_t i = 0; i < m.vert.size(); ++i)
+			if (!m.vert[i].IsD())
 			{
-				Point3<ScalarType> newP, normP, barP;
-				ScalarType maxDist = params.maxSurfDist * 1.5f, minDist = 0.f;
-				FaceType* fp = GetClosestFaceBase(*params.mProject, params.grid, vi->cP(), maxDist, minDist, newP, normP, barP);
+				Point3i ip;
+				params.grid.PToIP(m.vert[i].cP(), ip);
+				ip.X() = std::max(0, std::min(ip.X(), siz[0] - 1));
+				ip.Y() = std::max(0, std::min(ip.Y(), siz[1] - 1));
+				ip.Z() = std::max(0, std::min(ip.Z(), siz[2] - 1));
+				order.push_back(std::make_pair((long long)(ip[2] * siz[1] + ip[1]) * siz[0] + ip[0], int(i)));
+			}
+		std::sort(order.begin(), order.end());
 
-				if (fp != NULL)
-				{
-					vi->P() = newP;
-				}
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int k = 0; k < int(order.size()); ++k)
+		{
+			VertexType &v = m.vert[order[k].second];
+			Point3<ScalarType> newP;
+			ScalarType maxDist = params.maxSurfDist * 1.5f, minDist = 0.f;
+			FaceType* fp = closestFace(params.grid, v.cP(), maxDist, minDist, newP);
+
+			if (fp != NULL)
+			{
+				v.P() = newP;
 			}
+		}
 	}
 };
 } // end namespace tri
@@ -25,6 +25,7 @@
 #define __VCG_TRIMESHCOLLAPSE_QUADRIC__
 
 #include<vcg/math/quadric.h>
+#include<vcg/math/quadric_simd.h>
 #include<vcg/complex/algorithms/update/bounding.h>
 #include<vcg/complex/algorithms/local_optimization/tri_edge_collapse.h>
 #include<vcg/complex/algorithms/local_optimization.h>
@@ -133,7 +134,7 @@ public:
   
   // Pointer to the vector that store the Write flags. Used to preserve them if you ask to preserve for the boundaries.
   static std::vector<typename TriMeshType::VertexPointer>  & WV(){
-    static std::vector<typename TriMeshType::VertexPointer> _WV; return _WV;
+    static thread_local std::vector<typename TriMeshType::VertexPointer> _WV; return _WV;
   }
   
   inline TriEdgeCollapseQuadric(){}
@@ -557,45 +558,63 @@ public:
   {
     QParameter *pp=(QParameter *)_pp;
     QH::Init();
-    for(VertexIterator pv=m.vert.begin();pv!=m.vert.end();++pv)
-      if( ! (*pv).IsD() && (*pv).IsW())
-        QH::Qd(*pv).SetZero();    
     
-    for(FaceIterator fi=m.face.begin();fi!=m.face.end();++fi)
-      if( !(*fi).IsD() && (*fi).IsR() )
-        if((*fi).V(0)->IsR() &&(*fi).V(1)->IsR() &&(*fi).V(2)->IsR())
+    // Quadrics are accumulated in packed (SIMD) form. Face plane quadrics are computed
+    // in parallel one chunk of faces at a time and then scattered over the vertices
+    // serially and in face order, so the result does not depend on the number of threads.
+    const size_t FaceChunkSize = 4096;
+    std::vector<math::QuadricSIMD> vertQ(m.vert.size());
+    std::vector<math::QuadricSIMD> faceQ(FaceChunkSize);
+    std::vector<Plane3<ScalarType,false> > facePlane(FaceChunkSize);
+    std::vector<char> faceOk(FaceChunkSize);
+    
+    for(size_t chunkStart=0; chunkStart<m.face.size(); chunkStart+=FaceChunkSize)
+    {
+      const int chunkNum = int(std::min(FaceChunkSize, m.face.size()-chunkStart));
+#pragma omp parallel for schedule(static)
+      for(int k=0;k<chunkNum;++k)
+      {
+        FaceType &f = m.face[chunkStart+k];
+        faceOk[k] = !f.IsD() && f.IsR() && f.V(0)->IsR() && f.V(1)->IsR() && f.V(2)->IsR();
+        if(!faceOk[k]) continue;
+        facePlane[k].SetDirection( ( f.V(1)->cP() - f.V(0)->cP() ) ^  ( f.V(2)->cP() - f.V(0)->cP() ));
+        if(!pp->UseArea)
+          facePlane[k].Normalize();
+        facePlane[k].SetOffset( facePlane[k].Direction().dot(f.V(0)->cP()));
+        faceQ[k].ByPlane(facePlane[k]);
+      }
+      
+      for(int k=0;k<chunkNum;++k)
+        if(faceOk[k])
         {
-          Plane3<ScalarType,false> facePlane;
-          facePlane.SetDirection( ( (*fi).V(1)->cP() - (*fi).V(0)->cP() ) ^  ( (*fi).V(2)->cP() - (*fi).V(0)->cP() ));
-          if(!pp->UseArea)
-            facePlane.Normalize();
-          facePlane.SetOffset( facePlane.Direction().dot((*fi).V(0)->cP()));                   
-
-          QuadricType q;
-          q.ByPlane(facePlane);          
-          
+          FaceType &f = m.face[chunkStart+k];
           // The basic < add face quadric to each vertex > loop
           for(int j=0;j<3;++j)
-            if( (*fi).V(j)->IsW() )
-              QH::Qd((*fi).V(j)) += q;
+            if( f.V(j)->IsW() )
+              vertQ[tri::Index(m,f.V(j))] += faceQ[k];
           
           for(int j=0;j<3;++j)
-            if( (*fi).IsB(j) || pp->QualityQuadric )
+            if( f.IsB(j) || pp->QualityQuadric )
             {
               Plane3<ScalarType,false> borderPlane; 
-              QuadricType bq;
+              math::QuadricSIMD bq;
               // Border quadric record the squared distance from the plane orthogonal to the face and passing 
               // through the edge. 
-              borderPlane.SetDirection(facePlane.Direction() ^ (( (*fi).V1(j)->cP() - (*fi).V(j)->cP() ).normalized()));
-              if(  (*fi).IsB(j) ) borderPlane.SetDirection(borderPlane.Direction()* (ScalarType)(pp->BoundaryQuadricWeight ));        // amplify border planes
-              else                borderPlane.SetDirection(borderPlane.Direction()* (ScalarType)(pp->QualityQuadricWeight ));   // and consider much less quadric for quality
-              borderPlane.SetOffset(borderPlane.Direction().dot((*fi).V(j)->cP()));
+              borderPlane.SetDirection(facePlane[k].Direction() ^ (( f.V1(j)->cP() - f.V(j)->cP() ).normalized()));
+              if(  f.IsB(j) ) borderPlane.SetDirection(borderPlane.Direction()* (ScalarType)(pp->BoundaryQuadricWeight ));        // amplify border planes
+              else            borderPlane.SetDirection(borderPlane.Direction()* (ScalarType)(pp->QualityQuadricWeight ));   // and consider much less quadric for quality
+              borderPlane.SetOffset(borderPlane.Direction().dot(f.V(j)->cP()));
               bq.ByPlane(borderPlane);
               
-              if( (*fi).V (j)->IsW() )	QH::Qd((*fi).V (j)) += bq;
-              if( (*fi).V1(j)->IsW() )	QH::Qd((*fi).V1(j)) += bq;
+              if( f.V (j)->IsW() )	vertQ[tri::Index(m,f.V (j))] += bq;
+              if( f.V1(j)->IsW() )	vertQ[tri::Index(m,f.V1(j))] += bq;
             }
         }
+    }
+    
+    for(size_t i=0;i<m.vert.size();++i)
+      if( ! m.vert[i].IsD() && m.vert[i].IsW())
+        vertQ[i].Export(QH::Qd(m.vert[i]));
     
     if(pp->ScaleIndependent)
     {
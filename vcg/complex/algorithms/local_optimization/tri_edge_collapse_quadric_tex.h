@@ -31,6 +31,10 @@
 #include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric.h>
 #include <vcg/container/simple_temporary_data.h>
 #include <vcg/math/quadric5.h>
+#include <vcg/complex/algorithms/update/bounding.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 namespace vcg
 {
 namespace tri
@@ -162,6 +166,8 @@ class QuadricTexHelper
     static math::Quadric<double> &Qd3(VertexType &v) {return TD3()[v];}
 
     static std::vector<std::pair<vcg::TexCoord2f ,Quadric5<double> > > &Vd(VertexType *v){return (TD()[*v]);}
+    static size_t WedgeNum(VertexType *v) {return Vd(v).size();}
+    static void SetWedges(VertexType *v, const std::vector<std::pair<vcg::TexCoord2f ,Quadric5<double> > > &qv) {Vd(v)=qv;}
       static typename VertexType::ScalarType W(VertexType * /*v*/) {return 1.0;}
       static typename VertexType::ScalarType W(VertexType & /*v*/) {return 1.0;}
       static void Merge(VertexType & /*v_dest*/, VertexType const & /*v_del*/){}
@@ -171,6 +177,159 @@ class QuadricTexHelper
       static  QuadricTemp &TD3() {return *TDp3();}
     };
 
+// Same interface of QuadricTexHelper, but the texcoord+Quadric5D pairs of all the vertices
+// are kept in a single pool. Each vertex just stores the range of its entries (start, count and capacity);
+// when a vertex needs more room its entries are moved at the end of the pool and
+// the pool is compacted when the unused entries become more than the used ones.
+// This avoids a heap allocated std::vector for each vertex.
+//
+// All the temporary data are grouped in a PoolData object that must be set with TDp()
+// before starting a session. The pointer is per-thread, so different threads
+// can simplify different meshes at the same time (see QuadricTexPartitionedDecimation).
+template <class MeshType>
+class QuadricTexPoolHelper
+    {
+    public:
+  typedef typename MeshType::VertexType VertexType;
+  typedef std::pair<vcg::TexCoord2f ,Quadric5<double> > WedgeQuadric;
+
+  struct Slot
+  {
+    Slot():start(0),num(0),cap(0){}
+    size_t start;
+    unsigned short num;
+    unsigned short cap;
+  };
+
+  typedef	SimpleTempData<typename MeshType::VertContainer, Slot > SlotTemp;
+  typedef	SimpleTempData<typename MeshType::VertContainer, math::Quadric<double> > QuadricTemp;
+
+  class PoolData
+  {
+  public:
+    PoolData(MeshType &m):slot(m.vert),q3(m.vert,ZeroQuadric()),unused(0) {}
+    SlotTemp slot;
+    QuadricTemp q3;
+    std::vector<WedgeQuadric> pool;
+    size_t unused;
+  private:
+    static math::Quadric<double> ZeroQuadric() { math::Quadric<double> q; q.SetZero(); return q; }
+  };
+
+      QuadricTexPoolHelper(){}
+
+    static void Init(){}
+
+    // it allocs the std::pair for the vertex relativly to the texture coord parameter
+    static void Alloc(VertexType *v,vcg::TexCoord2f &coord)
+    {
+      Slot &sl = TD().slot[*v];
+      if(sl.num == sl.cap)
+        Relocate(v, sl.cap==0 ? 2 : sl.cap*2);
+      Slot &ns = TD().slot[*v];
+      WedgeQuadric &wq = TD().pool[ns.start+ns.num];
+      ++ns.num;
+      wq.first.u() = coord.u();
+      wq.first.v() = coord.v();
+      wq.second.Zero();
+      wq.second.Sum3(Qd3(v),coord.u(),coord.v());
+    }
+
+    static void SumAll(VertexType *v,vcg::TexCoord2f &coord, Quadric5<double>& q)
+    {
+      const Slot &sl = TD().slot[*v];
+      for(size_t i = sl.start; i < sl.start+sl.num; i++)
+      {
+        vcg::TexCoord2f &f = TD().pool[i].first;
+        if((f.u() == coord.u()) && (f.v() == coord.v()))
+          TD().pool[i].second += q;
+        else
+          TD().pool[i].second.Sum3(Qd3(v),f.u(),f.v());
+      }
+    }
+
+    static bool Contains(VertexType *v,vcg::TexCoord2f &coord)
+    {
+      const Slot &sl = TD().slot[*v];
+      for(size_t i = sl.start; i < sl.start+sl.num; i++)
+      {
+        const vcg::TexCoord2f &f = TD().pool[i].first;
+        if((f.u() == coord.u()) && (f.v() == coord.v()))
+          return true;
+      }
+      return false;
+    }
+
+    static Quadric5<double> &Qd(VertexType *v,const vcg::TexCoord2f &coord)
+    {
+      const Slot &sl = TD().slot[*v];
+      for(size_t i = sl.start; i < sl.start+sl.num; i++)
+      {
+        const vcg::TexCoord2f &f = TD().pool[i].first;
+        if((f.u() == coord.u()) && (f.v() == coord.v()))
+          return TD().pool[i].second;
+      }
+      assert(0);
+      return TD().pool[sl.start].second;
+    }
+
+    static size_t WedgeNum(VertexType *v) {return TD().slot[*v].num;}
+
+    static void SetWedges(VertexType *v, const std::vector<WedgeQuadric> &qv)
+    {
+      if(qv.size() > TD().slot[*v].cap)
+        Relocate(v, qv.size());
+      Slot &sl = TD().slot[*v];
+      std::copy(qv.begin(),qv.end(),TD().pool.begin()+sl.start);
+      sl.num = (unsigned short)(qv.size());
+      if(TD().unused > 1024 && TD().unused > TD().pool.size()/2)
+        Compact();
+    }
+
+    // Rebuild the pool keeping only the entries of the non deleted vertices.
+    static void Compact()
+    {
+      PoolData &td=TD();
+      std::vector<WedgeQuadric> newPool;
+      newPool.reserve(td.pool.size()-td.unused);
+      for(size_t i=0;i<td.slot.c.size();++i)
+      {
+        Slot &sl = td.slot[i];
+        if(td.slot.c[i].IsD()) { sl = Slot(); continue; }
+        const size_t newStart = newPool.size();
+        newPool.insert(newPool.end(),td.pool.begin()+sl.start,td.pool.begin()+sl.start+sl.num);
+        sl.start = newStart;
+        sl.cap = sl.num;
+      }
+      td.pool.swap(newPool);
+      td.unused = 0;
+    }
+
+    static math::Quadric<double> &Qd3(VertexType *v) {return TD().q3[*v];}
+    static math::Quadric<double> &Qd3(VertexType &v) {return TD().q3[v];}
+
+      static typename VertexType::ScalarType W(VertexType * /*v*/) {return 1.0;}
+      static typename VertexType::ScalarType W(VertexType & /*v*/) {return 1.0;}
+      static void Merge(VertexType & /*v_dest*/, VertexType const & /*v_del*/){}
+      static  PoolData* &TDp() {static thread_local PoolData *td=0; return td;}
+      static  PoolData &TD() {return *TDp();}
+
+    private:
+    // move the entries of the vertex at the end of the pool, with room for newCap entries
+    static void Relocate(VertexType *v, size_t newCap)
+    {
+      PoolData &td=TD();
+      Slot &sl = td.slot[*v];
+      assert(newCap < std::numeric_limits<unsigned short>::max());
+      const size_t newStart = td.pool.size();
+      td.pool.resize(newStart+newCap);
+      std::copy(td.pool.begin()+sl.start,td.pool.begin()+sl.start+sl.num,td.pool.begin()+newStart);
+      td.unused += sl.cap;
+      sl.start = newStart;
+      sl.cap = (unsigned short)(newCap);
+    }
+    };
+
 
 
 
@@ -202,12 +361,12 @@ class TriEdgeCollapseQuadricTex: public vcg::tri::TriEdgeCollapse< TriMeshType,
 
 // puntatori ai vertici che sono stati messi non-w per preservare il boundary
   static std::vector<VertexPointer>  & WV(){
-      static std::vector<VertexPointer> _WV; return _WV;
+      static thread_local std::vector<VertexPointer> _WV; return _WV;
     };
 
 
 
-  static TriEdgeCollapseQuadricTexParameter & Params(){static TriEdgeCollapseQuadricTexParameter p; return p;}
+  static TriEdgeCollapseQuadricTexParameter & Params(){static thread_local TriEdgeCollapseQuadricTexParameter p; return p;}
 
       // Final Clean up after the end of the simplification process
     static void Finalize(TriMeshType &m,HeapType & /*h_ret*/, BaseParameterClass *_pp)
@@ -430,7 +589,7 @@ class TriEdgeCollapseQuadricTex: public vcg::tri::TriEdgeCollapse< TriMeshType,
       priority1 = ComputeTexPriority(dest_1,qsum_1,pp);
 
       if(ncoords < 2)
-        return priority1*(1 + (pp->ExtraTCoordWeight)*(QH::Vd(this->pos.V(0)).size()+ QH::Vd(this->pos.V(1)).size() - 2));
+        return priority1*(1 + (pp->ExtraTCoordWeight)*(QH::WedgeNum(this->pos.V(0))+ QH::WedgeNum(this->pos.V(1)) - 2));
 
 
       tmp1[3] = tcoord0_2.u();
@@ -460,7 +619,7 @@ class TriEdgeCollapseQuadricTex: public vcg::tri::TriEdgeCollapse< TriMeshType,
       }
 
 
-      this->_priority = std::max(priority1, priority2)*(1 + (pp->ExtraTCoordWeight)*(QH::Vd(this->pos.V(0)).size()+QH::Vd(this->pos.V(1)).size() - 2));
+      this->_priority = std::max(priority1, priority2)*(1 + (pp->ExtraTCoordWeight)*(QH::WedgeNum(this->pos.V(0))+QH::WedgeNum(this->pos.V(1)) - 2));
 
       return this->_priority;
     }
@@ -789,7 +948,7 @@ class TriEdgeCollapseQuadricTex: public vcg::tri::TriEdgeCollapse< TriMeshType,
     ++vfi;
   }
   QH::Qd3(v[1]) = qsum3;
-  QH::Vd(v[1]) = qv;
+  QH::SetWedges(v[1],qv);
 
   }
 
@@ -797,6 +956,210 @@ class TriEdgeCollapseQuadricTex: public vcg::tri::TriEdgeCollapse< TriMeshType,
 
 
 
+/** Partitioned parallel texture aware quadric simplification.
+
+  The faces are split in PartitionNum slabs with about the same number of faces
+  along the longest side of the bounding box. Each slab is copied in a separate mesh and
+  simplified independently (and concurrently) keeping locked the vertices shared with other slabs,
+  then the slabs are merged back. The faces around the locked vertices are left out of the slab
+  budgets and simplified by a second parallel pass over slabs shifted by half a slab, so that every
+  seam falls inside a slab. A final serial pass over the whole mesh reaches the target number of faces.
+
+  MYTYPE must be a TriEdgeCollapseQuadricTex that uses QuadricTexPoolHelper<TriMeshType>.
+  During the process the mesh is kept twice in memory; unreferenced vertices are removed and
+  the mesh is returned compacted.
+*/
+template<class TriMeshType, class MYTYPE>
+class QuadricTexPartitionedDecimation
+{
+  typedef QuadricTexPoolHelper<TriMeshType> QH;
+  typedef typename TriMeshType::ScalarType ScalarType;
+  typedef typename TriMeshType::FaceType FaceType;
+
+public:
+  static void Do(TriMeshType &m, int TargetFaceNum, TriEdgeCollapseQuadricTexParameter &pp, int PartitionNum=0, bool FinalSerialPass=true)
+  {
+    if(PartitionNum<=0)
+    {
+      PartitionNum = 1;
+#ifdef _OPENMP
+      PartitionNum = 2*omp_get_max_threads();
+#endif
+    }
+    if(PartitionNum<=1 || m.fn<=TargetFaceNum || m.fn < 8*PartitionNum)
+    {
+      SerialDecimation(m,TargetFaceNum,pp);
+      return;
+    }
+
+    PartitionedPass(m,TargetFaceNum,pp,PartitionNum,false);
+    // the faces around the locked vertices are left at the input resolution:
+    // a second pass on slabs shifted by half a slab simplifies them in parallel
+    if(PartitionNum>2 && m.fn>TargetFaceNum)
+      PartitionedPass(m,TargetFaceNum,pp,PartitionNum,true);
+
+    if(FinalSerialPass && m.fn>TargetFaceNum)
+      SerialDecimation(m,TargetFaceNum,pp);
+  }
+
+  // Plain serial simplification of a whole mesh with the pooled helper
+  static void SerialDecimation(TriMeshType &m, int TargetFaceNum, TriEdgeCollapseQuadricTexParameter &pp)
+  {
+    typename QH::PoolData td(m);
+    QH::TDp()=&td;
+    vcg::LocalOptimization<TriMeshType> DeciSession(m,&pp);
+    DeciSession.template Init<MYTYPE>();
+    DeciSession.SetTargetSimplices(TargetFaceNum);
+    DeciSession.DoOptimization();
+    DeciSession.template Finalize<MYTYPE>();
+    QH::TDp()=0;
+  }
+
+private:
+  // Split the faces in slabs along the longest side of the bounding box and simplify each slab concurrently.
+  // With shifted=true the PartitionNum-1 slabs are centered on the seams of the unshifted split.
+  static void PartitionedPass(TriMeshType &m, int TargetFaceNum, TriEdgeCollapseQuadricTexParameter &pp, int PartitionNum, bool shifted)
+  {
+    tri::UpdateBounding<TriMeshType>::Box(m);
+    const int axis = m.bbox.MaxDim();
+    std::vector<std::pair<ScalarType,int> > faceKey;
+    faceKey.reserve(m.fn);
+    for(size_t i=0;i<m.face.size();++i)
+      if(!m.face[i].IsD())
+        faceKey.push_back(std::make_pair(Barycenter(m.face[i])[axis],int(i)));
+    std::sort(faceKey.begin(),faceKey.end());
+    const int slabNum = shifted ? PartitionNum-1 : PartitionNum;
+    std::vector<size_t> partStart(slabNum+1);
+    for(int p=0;p<=slabNum;++p)
+      partStart[p] = shifted ? faceKey.size()*(2*p+1)/(2*PartitionNum) : faceKey.size()*p/PartitionNum;
+    partStart[0] = 0;
+    partStart[slabNum] = faceKey.size();
+
+    // vertPart: -1 unreferenced, >=0 referenced by a single slab, -2 shared among slabs (locked)
+    std::vector<int> vertPart(m.vert.size(),-1);
+    for(int p=0;p<slabNum;++p)
+      for(size_t i=partStart[p];i<partStart[p+1];++i)
+        for(int j=0;j<3;++j)
+        {
+          int &vp = vertPart[tri::Index(m,m.face[faceKey[i].second].V(j))];
+          if(vp==-1) vp=p;
+          else if(vp!=p) vp=-2;
+        }
+    std::vector<char> sharedWritable(m.vert.size(),0);
+    for(size_t i=0;i<m.vert.size();++i)
+      if(vertPart[i]==-2) sharedWritable[i] = m.vert[i].IsW();
+
+    // the faces touching a locked vertex cannot be collapsed in the slab:
+    // they are left out of the slab budget, to be simplified by the next pass
+    std::vector<int> seamFaceNum(slabNum,0);
+    for(int p=0;p<slabNum;++p)
+      for(size_t i=partStart[p];i<partStart[p+1];++i)
+      {
+        const FaceType &f = m.face[faceKey[i].second];
+        if(vertPart[tri::Index(m,f.cV(0))]==-2 || vertPart[tri::Index(m,f.cV(1))]==-2 || vertPart[tri::Index(m,f.cV(2))]==-2)
+          ++seamFaceNum[p];
+      }
+
+    const double ratio = double(TargetFaceNum)/double(m.fn);
+    std::vector<TriMeshType> subMesh(slabNum);
+    std::vector<std::vector<int> > subToOrig(slabNum);
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int p=0;p<slabNum;++p)
+    {
+      TriEdgeCollapseQuadricTexParameter lpp = pp;
+      BuildPartition(m,faceKey,partStart[p],partStart[p+1],vertPart,subMesh[p],subToOrig[p]);
+      // a collapse removes one or two faces: aim a face above the slab share so that
+      // the merged mesh never ends below the target and the final pass can reach it
+      const int interiorFaceNum = subMesh[p].fn - seamFaceNum[p];
+      SerialDecimation(subMesh[p],int(std::ceil(ratio*interiorFaceNum))+seamFaceNum[p]+1,lpp);
+    }
+
+    Merge(m,subMesh,subToOrig,vertPart,sharedWritable);
+  }
+
+  static void BuildPartition(TriMeshType &m, const std::vector<std::pair<ScalarType,int> > &faceKey, size_t start, size_t end,
+                             const std::vector<int> &vertPart, TriMeshType &sub, std::vector<int> &subToOrig)
+  {
+    subToOrig.clear();
+    subToOrig.reserve((end-start)*3);
+    for(size_t i=start;i<end;++i)
+      for(int j=0;j<3;++j)
+        subToOrig.push_back(int(tri::Index(m,m.face[faceKey[i].second].V(j))));
+    std::sort(subToOrig.begin(),subToOrig.end());
+    subToOrig.erase(std::unique(subToOrig.begin(),subToOrig.end()),subToOrig.end());
+
+    tri::Allocator<TriMeshType>::AddVertices(sub,subToOrig.size());
+    for(size_t k=0;k<subToOrig.size();++k)
+    {
+      sub.vert[k].ImportData(m.vert[subToOrig[k]]);
+      if(vertPart[subToOrig[k]]==-2) sub.vert[k].ClearW();
+    }
+    tri::Allocator<TriMeshType>::AddFaces(sub,end-start);
+    for(size_t i=start;i<end;++i)
+    {
+      FaceType &f = m.face[faceKey[i].second];
+      FaceType &sf = sub.face[i-start];
+      sf.ImportData(f);
+      for(int j=0;j<3;++j)
+      {
+        const int gi = int(tri::Index(m,f.V(j)));
+        sf.V(j) = &sub.vert[std::lower_bound(subToOrig.begin(),subToOrig.end(),gi)-subToOrig.begin()];
+      }
+    }
+  }
+
+  static void Merge(TriMeshType &m, std::vector<TriMeshType> &subMesh, const std::vector<std::vector<int> > &subToOrig,
+                    const std::vector<int> &vertPart, const std::vector<char> &sharedWritable)
+  {
+    size_t vertNum=0, faceNum=0;
+    for(size_t i=0;i<vertPart.size();++i)
+      if(vertPart[i]==-2) ++vertNum;
+    for(size_t p=0;p<subMesh.size();++p)
+    {
+      faceNum += subMesh[p].fn;
+      for(size_t k=0;k<subMesh[p].vert.size();++k)
+        if(!subMesh[p].vert[k].IsD() && vertPart[subToOrig[p][k]]!=-2) ++vertNum;
+    }
+
+    std::vector<int> sharedNew(vertPart.size(),-1);
+    m.Clear();
+    tri::Allocator<TriMeshType>::AddVertices(m,vertNum);
+    tri::Allocator<TriMeshType>::AddFaces(m,faceNum);
+    size_t vi=0, fi=0;
+    for(size_t p=0;p<subMesh.size();++p)
+    {
+      TriMeshType &sub = subMesh[p];
+      std::vector<int> subNew(sub.vert.size(),-1);
+      for(size_t k=0;k<sub.vert.size();++k)
+        if(!sub.vert[k].IsD())
+        {
+          const int gi = subToOrig[p][k];
+          if(vertPart[gi]==-2 && sharedNew[gi]!=-1)
+          {
+            subNew[k]=sharedNew[gi];
+            continue;
+          }
+          m.vert[vi].ImportData(sub.vert[k]);
+          if(vertPart[gi]==-2)
+          {
+            if(sharedWritable[gi]) m.vert[vi].SetW();
+            sharedNew[gi]=int(vi);
+          }
+          subNew[k]=int(vi++);
+        }
+      for(size_t k=0;k<sub.face.size();++k)
+        if(!sub.face[k].IsD())
+        {
+          m.face[fi].ImportData(sub.face[k]);
+          for(int j=0;j<3;++j)
+            m.face[fi].V(j) = &m.vert[subNew[tri::Index(sub,sub.face[k].V(j))]];
+          ++fi;
+        }
+    }
+    assert(vi==vertNum && fi==faceNum);
+  }
+};
+
   } // namespace tri
     } // namespace vcg
 #endif
@@ -377,6 +377,54 @@ public:
             GetLaplacianEntry(mesh,mesh.face[i],index,entry,cotangent,weight,vertexCoord);
     }
 
+    /// Same matrix assembled from the entries of GetLaplacianMatrix (an edge shared by two faces is counted twice),
+    /// but built in parallel directly in compressed form, taking the cotangent weights from the cached operators ops
+    /// (updated here if the mesh changed). The matrix has size rows and columns, at least VN (3*VN if vertexCoord).
+    template <class OperatorsType>
+    static void GetLaplacianMatrix(MeshType &mesh,
+                                   OperatorsType &ops,
+                                   Eigen::SparseMatrix<ScalarType> &L,
+                                   int size,
+                                   bool cotangent,
+                                   ScalarType weight = 1,
+                                   bool vertexCoord=true)
+    {
+        ops.Update(mesh);
+        const typename OperatorsType::SparseMatrix &C = ops.CotLaplacian();
+        const std::vector<int> &faceNum = ops.EdgeFaceNum();
+        const int vn = int(C.cols());
+        const int dim = vertexCoord ? 3 : 1;
+        assert(size >= vn*dim);
+
+        std::vector<int> outer(size+1,0);
+        for (int c=0;c<size;c++)
+        {
+            const int i=c/dim;
+            outer[c+1]=outer[c]+((i<vn)?(C.outerIndexPtr()[i+1]-C.outerIndexPtr()[i]):0);
+        }
+        L.resize(size,size);
+        L.resizeNonZeros(outer[size]);
+        std::copy(outer.begin(),outer.end(),L.outerIndexPtr());
+
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (int c=0;c<vn*dim;c++)
+        {
+            const int i=c/dim, d=c%dim;
+            int k=outer[c], diagK=-1;
+            ScalarType diag=0;
+            for (int t=C.outerIndexPtr()[i];t<C.outerIndexPtr()[i+1];t++,k++)
+            {
+                const int j=C.innerIndexPtr()[t];
+                L.innerIndexPtr()[k]=(j*dim)+d;
+                if (j==i) { diagK=k; continue; }
+                const ScalarType w=faceNum[t]*(cotangent ? ScalarType(-C.valuePtr()[t]) : weight);
+                L.valuePtr()[k]=-w;
+                diag+=w;
+            }
+            L.valuePtr()[diagK]=diag;
+        }
+    }
+
 
 
 };
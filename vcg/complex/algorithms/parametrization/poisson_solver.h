@@ -25,6 +25,7 @@
 #define VCG_POISSON_SOLVER
 
 #include <Eigen/Sparse>
+#include <vcg/math/sparse_solver_cache.h>
 
 #include <vcg/complex/algorithms/clean.h>
 #include <vcg/complex/algorithms/parametrization/distortion.h>
@@ -50,6 +51,8 @@ class PoissonSolver
     std::vector<VertexType *> to_fix;
     Eigen::SparseMatrix<double> A; // A
     Eigen::VectorXd b,x;// x and b
+    ///factorization kept across successive solves on the same mesh
+    SparseSolverCache<double> solverCache;
 
     //number of variables
     unsigned int n_vert_vars;
@@ -416,9 +419,10 @@ class PoissonSolver
         Eigen::SparseMatrix<double> As=Eigen::SparseMatrix<double>(A);
         As.finalize();
 
-        Eigen::SimplicialCholesky<Eigen::SparseMatrix<double> > solver(As);
-        x = solver.solve(b);
-        return (solver.info()==Eigen::Success);
+        if (!solverCache.Factorize(As))
+            return false;
+        x = solverCache.Solve(b);
+        return (solverCache.Info()==Eigen::Success);
     }
 
 
@@ -586,6 +590,7 @@ public:
         }
     }
     ///intialize parameters and setup fixed vertices vector
+    ///the factorization of the previous solve is reused for the parts of the system that did not change
     void Init(bool _use_direction_field=false,
               bool _correct_fixed=true,
               ScalarType _fieldScale=1.0)
@@ -670,6 +675,12 @@ public:
         return true;
     }
 
+    ///drop the factorization kept from the previous solves, to free its memory
+    void ClearSolverCache()
+    {
+        solverCache.Clear();
+    }
+
     PoissonSolver(MeshType &_mesh):mesh(_mesh)
     {
         assert(mesh.vert.size()>=3);
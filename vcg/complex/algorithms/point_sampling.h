@@ -1047,26 +1047,101 @@ static CoordType RandomPointInTriangle(const FaceType &f)
     return f.cP(0)*u[0] + f.cP(1)*u[1] + f.cP(2)*u[2];
 }
 
-static void StratifiedMontecarlo(MeshType & m, VertexSampler &ps,int sampleNum)
+/// Generate sampleNum samples with gen(i, rnd, fp, bary) and pass them to ps in order.
+/// The samples are computed in parallel, chunk by chunk; only the calls to ps are serial.
+/// Each sample has its own counter-based random stream: rnd is positioned at the block i
+/// (four numbers) of a stream whose key is drawn from SamplingRandomGenerator(), so for a
+/// given seed of SamplingRandomGenerator() the result does not depend on the number of threads.
+template <class FaceSampleGenerator>
+static void ParallelFaceSamples(VertexSampler &ps, size_t sampleNum, FaceSampleGenerator gen)
+{
+  const unsigned int key = SamplingRandomGenerator().generate();
+  const size_t chunkSize = 1<<16;
+  std::vector<FacePointer> fv;
+  std::vector<CoordType> bv;
+  for(size_t c0=0; c0<sampleNum; c0+=chunkSize)
+  {
+    const int cn = int(std::min(chunkSize, sampleNum-c0));
+    fv.resize(cn);
+    bv.resize(cn);
+#pragma omp parallel for schedule(static)
+    for(int k=0; k<cn; ++k)
+    {
+      math::PhiloxRNG rnd(key);
+      rnd.setCounter(c0+k);
+      gen(c0+k, rnd, fv[k], bv[k]);
+    }
+    for(int k=0; k<cn; ++k)
+      ps.AddFace(*fv[k], bv[k]);
+  }
+}
+
+/// In place inclusive prefix sum of v, computed in parallel; returns the total.
+/// The vector is split in blocks of fixed size, so the round off does not depend on the number of threads.
+template <class ValueType>
+static ValueType ParallelPrefixSum(std::vector<ValueType> &v)
 {
-    ScalarType area = Stat<MeshType>::ComputeMeshArea(m);
-    ScalarType samplePerAreaUnit = sampleNum/area;
-    // Montecarlo sampling.
-    double  floatSampleNum = 0.0;
+  const int blockSize = 1<<14;
+  const int blockNum = int((v.size()+blockSize-1)/blockSize);
+  std::vector<ValueType> blockSum(blockNum+1, ValueType(0));
+#pragma omp parallel for schedule(static)
+  for(int b=0; b<blockNum; ++b)
+  {
+    const size_t end = std::min(v.size(), size_t(b+1)*blockSize);
+    for(size_t i=size_t(b)*blockSize+1; i<end; ++i)
+      v[i] += v[i-1];
+    blockSum[b+1] = v[end-1];
+  }
+  for(int b=0; b<blockNum; ++b)
+    blockSum[b+1] += blockSum[b];
+#pragma omp parallel for schedule(static)
+  for(int b=1; b<blockNum; ++b)
+  {
+    const size_t end = std::min(v.size(), size_t(b+1)*blockSize);
+    for(size_t i=size_t(b)*blockSize; i<end; ++i)
+      v[i] += blockSum[b];
+  }
+  return blockSum[blockNum];
+}
 
-    FaceIterator fi;
-    for(fi=m.face.begin(); fi != m.face.end(); fi++)
-        if(!(*fi).IsD())
-        {
-            // compute # samples in the current face (taking into account of the remainders)
-            floatSampleNum += 0.5*DoubleArea(*fi) * samplePerAreaUnit;
-            int faceSampleNum   = (int) floatSampleNum;
-
-            // for every sample p_i in T...
-            for(int i=0; i < faceSampleNum; i++)
-                    ps.AddFace(*fi,RandomBarycentric());
-            floatSampleNum -= (double) faceSampleNum;
-        }
+/// Parallel computation of the area of all the faces (zero for the deleted ones)
+static void FaceAreaVector(MeshType &m, std::vector<double> &areaVec)
+{
+  areaVec.resize(m.face.size());
+#pragma omp parallel for schedule(static)
+  for(int i=0; i<int(m.face.size()); ++i)
+    areaVec[i] = m.face[i].IsD() ? 0.0 : 0.5*double(DoubleArea(m.face[i]));
+}
+
+/// Parallel sampling of the faces with a number of samples proportional to the per face weights,
+/// taking into account of the remainders: the first sample of the face i is floor(sampleNum*Sum_{j<i}(w_j)/Sum(w)),
+/// so the (inclusive) prefix sum of the weights gives the samples of all the faces at once.
+/// The samples are uniformly distributed over each face.
+static void ParallelFaceUniformSamples(MeshType &m, VertexSampler &ps, std::vector<double> &faceWeight, int sampleNum)
+{
+  const double totalWeight = ParallelPrefixSum(faceWeight);
+  if(totalWeight <= 0) return;
+  const double samplePerUnit = sampleNum/totalWeight;
+  std::vector<size_t> firstSample(faceWeight.size()+1);
+  firstSample[0] = 0;
+#pragma omp parallel for schedule(static)
+  for(int i=0; i<int(faceWeight.size()); ++i)
+    firstSample[i+1] = size_t(faceWeight[i]*samplePerUnit);
+  ParallelFaceSamples(ps, firstSample.back(), [&](size_t i, math::PhiloxRNG &rnd, FacePointer &fp, CoordType &bary)
+  {
+    // the last face whose first sample is not after i
+    const size_t fi = std::upper_bound(firstSample.begin(), firstSample.end(), i) - firstSample.begin() - 1;
+    fp = &m.face[fi];
+    bary = math::GenerateBarycentricUniform<ScalarType>(rnd);
+  });
+}
+
+static void StratifiedMontecarlo(MeshType & m, VertexSampler &ps,int sampleNum)
+{
+    std::vector<double> areaVec;
+    FaceAreaVector(m, areaVec);
+    // Montecarlo sampling: the number of samples of each face is proportional to its area.
+    ParallelFaceUniformSamples(m, ps, areaVec, sampleNum);
 }
 
 /**
@@ -1129,19 +1204,21 @@ static void EdgeMontecarlo(MeshType & m, VertexSampler &ps, int sampleNum, bool
     ++i;
   }
 
-  // Second Loop get a point on the line 0...Sum(edgeLen) to pick a point;
+  // Second Loop get a point on the line 0...Sum(edgeLen) to pick a point (in parallel);
   ScalarType edgeSum = intervals.back().first;
-  for(i=0;i<sampleNum;++i)
+  ParallelFaceSamples(ps, sampleNum, [&](size_t, math::PhiloxRNG &rnd, FacePointer &fp, CoordType &bary)
   {
-    ScalarType val = edgeSum * RandomDouble01();
-    // lower_bound returns the furthermost iterator i in [first, last) such that, for every iterator j in [first, i), *j < value.
-    // E.g. An iterator pointing to the first element "not less than" val, or end() if every element is less than val.
-    typename std::vector<IntervalType>::iterator it = lower_bound(intervals.begin(),intervals.end(),std::make_pair(val,(SimpleEdge*)(0)) );
-    assert(it != intervals.end() && it != intervals.begin());
-    assert( ( (*(it-1)).first < val ) && ((*(it)).first >= val) );
+    ScalarType val = edgeSum * rnd.generate01();
+    // upper_bound returns the first interval whose end is greater than val (never the first, that ends at 0);
+    // the product can round up to edgeSum, and then it falls on the last interval
+    typename std::vector<IntervalType>::const_iterator it =
+        std::upper_bound(intervals.begin(),intervals.end(),val,[](ScalarType v, const IntervalType &iv) { return v < iv.first; });
+    if(it == intervals.end()) it = std::prev(intervals.end());
+    assert(it != intervals.begin());
     SimpleEdge * ep=(*it).second;
-    ps.AddFace( *(ep->f), ep->EdgeBarycentricToFaceBarycentric(RandomDouble01()) );
-  }
+    fp = ep->f;
+    bary = ep->EdgeBarycentricToFaceBarycentric(rnd.generate01());
+  });
 }
 
 /**
@@ -1152,31 +1229,19 @@ static void EdgeMontecarlo(MeshType & m, VertexSampler &ps, int sampleNum, bool
 
 static void Montecarlo(MeshType & m, VertexSampler &ps,int sampleNum)
 {
-    typedef  std::pair<ScalarType, FacePointer> IntervalType;
-    std::vector< IntervalType > intervals (m.fn+1);
-    FaceIterator fi;
-    int i=0;
-    intervals[i]=std::make_pair(0,FacePointer(0));
-    // First loop: build a sequence of consecutive segments proportional to the triangle areas.
-    for(fi=m.face.begin(); fi != m.face.end(); fi++)
-        if(!(*fi).IsD())
-        {
-            intervals[i+1]=std::make_pair(intervals[i].first+0.5*DoubleArea(*fi), &*fi);
-            ++i;
-        }
-    ScalarType meshArea = intervals.back().first;
-    for(i=0;i<sampleNum;++i)
-        {
-            ScalarType val = meshArea * RandomDouble01();
-            // lower_bound returns the furthermost iterator i in [first, last) such that, for every iterator j in [first, i), *j < value.
-            // E.g. An iterator pointing to the first element "not less than" val, or end() if every element is less than val.
-            typename std::vector<IntervalType>::iterator it = lower_bound(intervals.begin(),intervals.end(),std::make_pair(val,FacePointer(0)) );
-            assert(it != intervals.end());
-            assert(it != intervals.begin());
-            assert( (*(it-1)).first <val );
-            assert( (*(it)).first >= val);
-            ps.AddFace( *(*it).second, RandomBarycentric() );
-        }
+    // The areas of the triangles are computed in parallel and stored in an alias table
+    // that picks a face with probability proportional to its area in constant time.
+    std::vector<double> areaVec;
+    FaceAreaVector(m, areaVec);
+    math::AliasTable faceTable(areaVec);
+    if(faceTable.Total() <= 0) return;
+    // the samples are generated in parallel
+    ParallelFaceSamples(ps, sampleNum, [&](size_t, math::PhiloxRNG &rnd, FacePointer &fp, CoordType &bary)
+    {
+        fp = &m.face[faceTable.Sample(rnd)];
+        assert(!fp->IsD());
+        bary = math::GenerateBarycentricUniform<ScalarType>(rnd);
+    });
 }
 
 static ScalarType WeightedArea(FaceType &f, PerVertexFloatAttribute &wH)
@@ -1200,25 +1265,13 @@ static void WeightedMontecarlo(MeshType & m, VertexSampler &ps,int sampleNum, fl
   PerVertexFloatAttribute rH = tri::Allocator<MeshType>:: template GetPerVertexAttribute<float> (m,"radius");
   InitRadiusHandleFromQuality(m, rH, 1.0, variance, true);
 
-  ScalarType weightedArea = 0;
-  for(FaceIterator fi = m.face.begin(); fi != m.face.end(); ++fi)
-      weightedArea += WeightedArea(*fi,rH);
+  std::vector<double> weightVec(m.face.size());
+#pragma omp parallel for schedule(static)
+  for(int i=0; i<int(m.face.size()); ++i)
+    weightVec[i] = WeightedArea(m.face[i],rH);
 
-  ScalarType samplePerAreaUnit = sampleNum/weightedArea;
   // Montecarlo sampling.
-  double  floatSampleNum = 0.0;
-  for(FaceIterator fi=m.face.begin(); fi != m.face.end(); fi++)
-    {
-      // compute # samples in the current face (taking into account of the remainders)
-      floatSampleNum += WeightedArea(*fi,rH) * samplePerAreaUnit;
-      int faceSampleNum   = (int) floatSampleNum;
-
-      // for every sample p_i in T...
-      for(int i=0; i < faceSampleNum; i++)
-        ps.AddFace(*fi,RandomBarycentric());
-
-      floatSampleNum -= (double) faceSampleNum;
-    }
+  ParallelFaceUniformSamples(m, ps, weightVec, sampleNum);
 }
 
 
@@ -1988,6 +2041,249 @@ static void PoissonDiskPruning(VertexSampler &ps, MeshType &montecarloMesh,
     pp.pds.pruneTime = t2-t1;
 }
 
+/// Uniform grid used by PoissonDiskPruningParallel.
+/// The samples are sorted by cell (and randomly inside each cell) and each cell is a range of
+/// the sorted vector; removed samples are just marked as dead.
+struct PoissonPruningGrid
+{
+  struct SortElem
+  {
+    long long key;
+    unsigned int rnd;
+    int vi;
+    bool operator < (const SortElem &o) const { return key!=o.key ? key<o.key : (rnd!=o.rnd ? rnd<o.rnd : vi<o.vi); }
+  };
+
+  BoxType bb;
+  ScalarType cellSize;
+  Point3i gridSize;
+  std::vector<VertexPointer> sv;    // the samples sorted by cell
+  std::vector<char> alive;          // per sorted sample
+  std::vector<long long> cellKey;   // sorted keys of the non empty cells
+  std::vector<int> cellBegin;       // cellKey.size()+1 ranges over sv
+  std::vector<int> cursor;          // per cell, first sample that could be alive
+
+  void Init(MeshType &m, ScalarType _cellSize)
+  {
+    bb = m.bbox;
+    assert(!bb.IsNull());
+    cellSize = _cellSize;
+    gridSize = Point3i(std::max(1, int(bb.DimX()/cellSize)+1),
+                       std::max(1, int(bb.DimY()/cellSize)+1),
+                       std::max(1, int(bb.DimZ()/cellSize)+1));
+    const int vn = int(m.vert.size());
+    std::vector<SortElem> se(vn);
+    for(int i=0; i<vn; ++i)
+    {
+      se[i].key = Key(CellOf(m.vert[i].cP()));
+      se[i].rnd = SamplingRandomGenerator().generate();
+      se[i].vi = i;
+    }
+    std::sort(se.begin(), se.end());
+    sv.resize(vn);
+    cellKey.clear();
+    cellBegin.clear();
+    for(int i=0; i<vn; ++i)
+    {
+      sv[i] = &m.vert[se[i].vi];
+      if(i==0 || se[i].key != se[i-1].key)
+      {
+        cellKey.push_back(se[i].key);
+        cellBegin.push_back(i);
+      }
+    }
+    cellBegin.push_back(vn);
+    cursor.assign(cellBegin.begin(), cellBegin.end()-1);
+    alive.assign(vn, 1);
+  }
+
+  Point3i CellOf(const CoordType &p) const
+  {
+    Point3i c;
+    for(int k=0; k<3; ++k)
+      c[k] = std::max(0, std::min(gridSize[k]-1, int((p[k]-bb.min[k])/cellSize)));
+    return c;
+  }
+  long long Key(const Point3i &c) const { return (long long)(c[0]*(long long)gridSize[1]+c[1])*gridSize[2]+c[2]; }
+  Point3i CellIndex(int ci) const
+  {
+    const long long k = cellKey[ci];
+    return Point3i(int(k/((long long)gridSize[1]*gridSize[2])), int((k/gridSize[2])%gridSize[1]), int(k%gridSize[2]));
+  }
+  int FindCell(const Point3i &c) const
+  {
+    for(int k=0; k<3; ++k)
+      if(c[k]<0 || c[k]>=gridSize[k]) return -1;
+    const long long key = Key(c);
+    typename std::vector<long long>::const_iterator it = std::lower_bound(cellKey.begin(), cellKey.end(), key);
+    if(it==cellKey.end() || *it!=key) return -1;
+    return int(it-cellKey.begin());
+  }
+
+  /// first alive sample of a cell, -1 if it is empty
+  int FirstAlive(int ci)
+  {
+    while(cursor[ci]<cellBegin[ci+1] && !alive[cursor[ci]]) ++cursor[ci];
+    return cursor[ci]<cellBegin[ci+1] ? cursor[ci] : -1;
+  }
+
+  /// Count (and remove if doRemove) the alive samples in the sphere; it only looks at the 3x3x3 cells around p.
+  int ProcessSphere(const CoordType &p, const CoordType &n, ScalarType radius, bool geodesic, bool doRemove)
+  {
+    vertex::ApproximateGeodesicDistanceFunctor<VertexType> GDF;
+    const ScalarType r2 = radius*radius;
+    const Point3i c = CellOf(p);
+    int cnt=0;
+    for(int i=-1; i<=1; ++i)
+      for(int j=-1; j<=1; ++j)
+        for(int k=-1; k<=1; ++k)
+        {
+          const int ci = FindCell(Point3i(c[0]+i, c[1]+j, c[2]+k));
+          if(ci<0) continue;
+          for(int si=cursor[ci]; si<cellBegin[ci+1]; ++si)
+            if(alive[si])
+            {
+              const bool in = geodesic ? (GDF(p,n,sv[si]->cP(),sv[si]->cN()) <= radius)
+                                       : (SquaredDistance(p,sv[si]->cP()) <= r2);
+              if(in)
+              {
+                cnt++;
+                if(doRemove) alive[si]=0;
+              }
+            }
+        }
+    return cnt;
+  }
+};
+
+/// Parallel version of PoissonDiskPruning.
+/// The samples are bucketed in a uniform grid whose cells are not smaller than the largest disk radius,
+/// so that choosing a sample can only remove samples of the 3x3x3 cells around its own.
+/// The cells are split in 27 phase groups according to their indexes modulo 3: two cells of the same group
+/// are at least two cells apart and their neighborhoods are disjoint, so all the cells of a group can
+/// choose a sample and prune their neighborhood concurrently. The groups are processed in turn until no
+/// sample is left. As in the serial version every chosen sample removes all the samples closer than its
+/// radius, so the same radius guarantee holds. The chosen samples are passed to ps serially and in a
+/// fixed order: for a given random seed the result does not depend on the number of threads
+/// (but it is not the same of PoissonDiskPruning).
+static void PoissonDiskPruningParallel(VertexSampler &ps, MeshType &montecarloMesh,
+                                       ScalarType diskRadius, PoissonDiskParam &pp)
+{
+  tri::RequireCompactness(montecarloMesh);
+  if(pp.randomSeed) SamplingRandomGenerator().initialize(pp.randomSeed);
+  if(pp.adaptiveRadiusFlag)
+    tri::RequirePerVertexQuality(montecarloMesh);
+  if(pp.geodesicDistanceFlag)
+    tri::RequirePerVertexNormal(montecarloMesh);
+  int t0 = clock();
+
+  PerVertexFloatAttribute rH = tri::Allocator<MeshType>:: template GetPerVertexAttribute<float> (montecarloMesh,"radius");
+  ScalarType maxRadius = diskRadius;
+  if(pp.adaptiveRadiusFlag)
+  {
+    InitRadiusHandleFromQuality(montecarloMesh, rH, diskRadius, pp.radiusVariance, pp.invertQuality);
+    for(VertexIterator vi=montecarloMesh.vert.begin(); vi!=montecarloMesh.vert.end(); ++vi)
+      maxRadius = std::max(maxRadius, ScalarType(rH[*vi]));
+  }
+
+  PoissonPruningGrid grid;
+  grid.Init(montecarloMesh, maxRadius);
+  const int cellNum = int(grid.cellKey.size());
+
+  // the 27 phase groups
+  std::vector<int> group[27];
+  for(int ci=0; ci<cellNum; ++ci)
+  {
+    const Point3i c = grid.CellIndex(ci);
+    group[(c[0]%3)*9 + (c[1]%3)*3 + c[2]%3].push_back(ci);
+  }
+  int t1 = clock();
+  pp.pds.montecarloSampleNum = montecarloMesh.vn;
+  pp.pds.gridSize = grid.gridSize;
+  pp.pds.gridCellNum = cellNum;
+  pp.pds.sampleNum = 0;
+
+  // Initial pass for pruning the grid with the an eventual pre initialized set of samples
+  if(pp.preGenFlag)
+  {
+    if(pp.preGenMesh==0)
+    {
+      typename MeshType::template PerVertexAttributeHandle<bool> fixed;
+      fixed = tri::Allocator<MeshType>:: template GetPerVertexAttribute<bool> (montecarloMesh,"fixed");
+      for(VertexIterator vi=montecarloMesh.vert.begin();vi!=montecarloMesh.vert.end();++vi)
+        if(fixed[*vi]) {
+          pp.pds.sampleNum++;
+          ps.AddVert(*vi);
+          grid.ProcessSphere(vi->cP(), vi->cN(), diskRadius, false, true);
+        }
+    }
+    else
+    {
+      for(VertexIterator vi =pp.preGenMesh->vert.begin(); vi!=pp.preGenMesh->vert.end();++vi)
+      {
+        ps.AddVert(*vi);
+        pp.pds.sampleNum++;
+        grid.ProcessSphere(vi->cP(), vi->cN(), diskRadius, false, true);
+      }
+    }
+  }
+
+  std::vector<int> pick;
+  bool active = true;
+  while(active)
+  {
+    active = false;
+    for(int g=0; g<27; ++g)
+    {
+      std::vector<int> &cells = group[g];
+      pick.assign(cells.size(), -1);
+#pragma omp parallel for schedule(dynamic, 256)
+      for(int k=0; k<int(cells.size()); ++k)
+      {
+        const int ci = cells[k];
+        int si = grid.FirstAlive(ci);
+        if(si<0) continue;
+        if(pp.bestSampleChoiceFlag)
+        {
+          // choose the sample that removes the minimum number of other samples
+          int minRemoveCnt = std::numeric_limits<int>::max();
+          int cnt=0;
+          for(int sj=si; sj<grid.cellBegin[ci+1] && cnt<pp.bestSamplePoolSize; ++sj)
+            if(grid.alive[sj])
+            {
+              cnt++;
+              const ScalarType r = pp.adaptiveRadiusFlag ? ScalarType(rH[grid.sv[sj]]) : diskRadius;
+              const int removeCnt = grid.ProcessSphere(grid.sv[sj]->cP(), grid.sv[sj]->cN(), r, pp.geodesicDistanceFlag, false);
+              if(removeCnt < minRemoveCnt)
+              {
+                minRemoveCnt = removeCnt;
+                si = sj;
+              }
+            }
+        }
+        const ScalarType r = pp.adaptiveRadiusFlag ? ScalarType(rH[grid.sv[si]]) : diskRadius;
+        grid.ProcessSphere(grid.sv[si]->cP(), grid.sv[si]->cN(), r, pp.geodesicDistanceFlag, true);
+        pick[k] = si;
+      }
+
+      // collect the chosen samples and drop the exhausted cells
+      size_t w=0;
+      for(size_t k=0; k<cells.size(); ++k)
+        if(pick[k]>=0)
+        {
+          ps.AddVert(*grid.sv[pick[k]]);
+          pp.pds.sampleNum++;
+          cells[w++] = cells[k];
+        }
+      cells.resize(w);
+      if(w>0) active = true;
+    }
+  }
+  int t2 = clock();
+  pp.pds.gridTime = t1-t0;
+  pp.pds.pruneTime = t2-t1;
+}
+
 /** Compute a Poisson-disk sampling of the surface.
  *  The radius of the disk is computed according to the estimated sampling density.
  *
@@ -57,31 +57,43 @@ public:
     bool operator< (const WArc &a) const {return w<a.w;}
   };
 
+  /// Number of points processed between two calls of the callback in the parallel loops.
+  static int BatchSize() { return 1<<16; }
+
+  /// Fits a plane to the nn nearest points of each vertex. The kNN queries of the tree are thread safe,
+  /// so the points are processed in parallel, batch by batch; the result does not depend on the number of threads.
   static void ComputeUndirectedNormal(MeshType &m, int nn, ScalarType maxDist, KdTree<ScalarType> &tree,vcg::CallBackPos * cb=0)
   {
 //    tree.setMaxNofNeighbors(nn);
     const ScalarType maxDistSquared = maxDist*maxDist;
-    int cnt=0;
-	int step = max(m.vn, int(m.vn / 100));
-    typename KdTree<ScalarType>::PriorityQueue nq;
-    for (VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+    const int vn = int(m.vert.size());
+    for(int b0=0; b0<vn; b0+=BatchSize())
     {
-        tree.doQueryK(vi->cP(),nn,nq);
-        if(cb && (++cnt%step)==0) cb(cnt/step,"Fitting planes");
-
-//        int neighbours = tree.getNofFoundNeighbors();
-        int neighbours = nq.getNofElements();
+      if(cb) cb(int(100.0f * float(b0) / float(vn)),"Fitting planes");
+      const int b1 = std::min(vn, b0+BatchSize());
+#pragma omp parallel
+      {
+        typename KdTree<ScalarType>::PriorityQueue nq;
         std::vector<CoordType> ptVec;
-        for (int i = 0; i < neighbours; i++)
+#pragma omp for schedule(dynamic, 256)
+        for (int vInd = b0; vInd < b1; ++vInd)
         {
-//            int neightId = tree.getNeighborId(i);
+          VertexType &v = m.vert[vInd];
+          tree.doQueryK(v.cP(),nn,nq);
+
+          int neighbours = nq.getNofElements();
+          ptVec.clear();
+          for (int i = 0; i < neighbours; i++)
+          {
             int neightId = nq.getIndex(i);
             if(nq.getWeight(i) <maxDistSquared)
               ptVec.push_back(m.vert[neightId].cP());
+          }
+          Plane3<ScalarType> plane;
+          FitPlaneToPointSet(ptVec,plane);
+          v.N()=plane.Direction();
         }
-        Plane3<ScalarType> plane;
-        FitPlaneToPointSet(ptVec,plane);
-        vi->N()=plane.Direction();
+      }
     }
   }
 
@@ -110,6 +122,153 @@ public:
     }
     //std::push_heap(heap.begin(),heap.end());
   }
+
+  /// Consistently orients the normals of the point cloud.
+  /**
+  The Riemannian graph connects each point to its nn nearest points, weighting an arc by |n_i * n_j|;
+  arcs with weight less than 0.3 are discarded, as in the heap based propagation (AddNeighboursToHeap).
+  The maximum spanning forest of the graph is built with Kruskal's algorithm, using first the arcs between
+  mutual neighbours and then the other ones to join the remaining trees; the orientation is
+  propagated along its trees, starting from the vertex of lowest index of each tree, whose normal is kept.
+  The kNN queries and the weighting are done in parallel; the result does not depend on the number of threads.
+  */
+  static void OrientNormalsMST(MeshType &m, int nn, KdTree<ScalarType> &tree, vcg::CallBackPos * cb=0)
+  {
+    const int vn = int(m.vert.size());
+    if(vn==0 || nn<=0) return;
+    const size_t slotNum = size_t(vn)*nn;
+
+    // 1) the kNN graph, nn slots per vertex (-1 for the unused ones)
+    std::vector<int> knn(slotNum,-1);
+    for(int b0=0; b0<vn; b0+=BatchSize())
+    {
+      if(cb) cb(int(50.0f * float(b0) / float(vn)),"Building Riemannian graph");
+      const int b1 = std::min(vn, b0+BatchSize());
+#pragma omp parallel
+      {
+        typename KdTree<ScalarType>::PriorityQueue nq;
+#pragma omp for schedule(dynamic, 256)
+        for(int i=b0; i<b1; ++i)
+        {
+          tree.doQueryK(m.vert[i].cP(),nn,nq);
+          int *slot = &knn[size_t(i)*nn];
+          int cnt=0;
+          for(int k=0; k<nq.getNofElements(); ++k)
+          {
+            int j = nq.getIndex(k);
+            if(j!=i && j<vn) slot[cnt++]=j;
+          }
+        }
+      }
+    }
+
+    // 2) the sorting key of each arc, 16 bits per slot (noArc for the discarded ones): the arcs between
+    // mutual neighbours come first, then the other ones; both groups by decreasing weight, quantized in
+    // bucketNum steps. An arc found from both of its ends is kept only once.
+    const int bucketNum = 0x7fff;
+    const int keyNum = 2*bucketNum;
+    const unsigned short noArc = 0xffff;
+    std::vector<unsigned short> key(slotNum,noArc);
+#pragma omp parallel for schedule(dynamic, 1024)
+    for(int i=0; i<vn; ++i)
+    {
+      const int *slot = &knn[size_t(i)*nn];
+      for(int k=0; k<nn && slot[k]!=-1; ++k)
+      {
+        const int j = slot[k];
+        const int *back = &knn[size_t(j)*nn];
+        const bool mutual = std::find(back,back+nn,i)!=back+nn;
+        if(mutual && j<i) continue;
+        const float w = fabs(m.vert[i].cN()*m.vert[j].cN());
+        if(w < 0.3f) continue;
+        key[size_t(i)*nn+k] = (unsigned short)((mutual ? 0 : bucketNum) + std::min(bucketNum-1, int((1.0f-w)*bucketNum)));
+      }
+    }
+
+    // 3) stable counting sort of the arcs, so that the order does not depend on the threads,
+    // and Kruskal on the sorted arcs. A point is a neighbour of a point on the other side of a
+    // thin part much more often than vice versa, so mutual arcs are used first.
+    // To save memory a bucket stores only the source vertices of its arcs, once each;
+    // the arcs of a source are then taken from its slots in slot order.
+    if(cb) cb(60,"Computing spanning forest");
+    std::vector<size_t> bucketEnd(keyNum+1,0);
+    for(int i=0; i<vn; ++i)
+    {
+      const unsigned short *ks = &key[size_t(i)*nn];
+      for(int k=0; k<nn; ++k)
+        if(ks[k]!=noArc && std::find(ks,ks+k,ks[k])==ks+k) ++bucketEnd[ks[k]+1];
+    }
+    for(int b=0; b<keyNum; ++b) bucketEnd[b+1]+=bucketEnd[b];
+    std::vector<int> sorted(bucketEnd.back());
+    for(int i=0; i<vn; ++i)
+    {
+      const unsigned short *ks = &key[size_t(i)*nn];
+      for(int k=0; k<nn; ++k)
+        if(ks[k]!=noArc && std::find(ks,ks+k,ks[k])==ks+k) sorted[bucketEnd[ks[k]]++]=i;
+    }
+
+    std::vector<int> parent(vn);
+    for(int i=0; i<vn; ++i) parent[i]=i;
+    std::vector<std::pair<int,int> > treeArcs;
+    treeArcs.reserve(vn);
+    for(size_t e=0, b=0; b<size_t(keyNum); ++b)
+      for(; e<bucketEnd[b]; ++e)
+      {
+        const int s = sorted[e];
+        for(int k=0; k<nn; ++k)
+        {
+          if(key[size_t(s)*nn+k]!=b) continue;
+          const int t = knn[size_t(s)*nn+k];
+          int rs = s, rt = t;
+          while(parent[rs]!=rs) rs = parent[rs] = parent[parent[rs]];
+          while(parent[rt]!=rt) rt = parent[rt] = parent[parent[rt]];
+          if(rs==rt) continue;
+          parent[std::max(rs,rt)] = std::min(rs,rt);
+          treeArcs.push_back(std::make_pair(s,t));
+        }
+      }
+    std::vector<int>().swap(sorted);
+    std::vector<unsigned short>().swap(key);
+    std::vector<int>().swap(knn);
+
+    // 4) the forest in compressed adjacency form, then the propagation from the roots
+    std::vector<int> degree(vn+1,0);
+    for(size_t k=0; k<treeArcs.size(); ++k) { ++degree[treeArcs[k].first+1]; ++degree[treeArcs[k].second+1]; }
+    for(int i=0; i<vn; ++i) degree[i+1]+=degree[i];
+    std::vector<int> adj(degree[vn]);
+    std::vector<int> fill(degree.begin(),degree.end()-1);
+    for(size_t k=0; k<treeArcs.size(); ++k)
+    {
+      adj[fill[treeArcs[k].first]++]=treeArcs[k].second;
+      adj[fill[treeArcs[k].second]++]=treeArcs[k].first;
+    }
+    std::vector<std::pair<int,int> >().swap(treeArcs);
+
+    if(cb) cb(90,"Orienting normals");
+    std::vector<bool> visited(vn,false);
+    std::vector<int> stack;
+    for(int r=0; r<vn; ++r)
+    {
+      if(visited[r]) continue;
+      visited[r]=true;
+      stack.push_back(r);
+      while(!stack.empty())
+      {
+        const int i = stack.back();
+        stack.pop_back();
+        for(int k=degree[i]; k<degree[i+1]; ++k)
+        {
+          const int j = adj[k];
+          if(visited[j]) continue;
+          visited[j]=true;
+          if(m.vert[i].cN()*m.vert[j].cN()<0.0f)
+            m.vert[j].N()=-m.vert[j].N();
+          stack.push_back(j);
+        }
+      }
+    }
+  }
+
   /*! \brief parameters for the normal generation
    */
   struct Param
@@ -145,14 +304,23 @@ public:
 
     if(p.useViewPoint) // Simple case use the viewpoint position to determine the right orientation of each point
     {
-      for(VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
+#pragma omp parallel for schedule(static)
+      for(int i=0;i<int(m.vert.size());++i)
       {
-        if ( vi->N().dot(p.viewPoint- vi->P())<0.0f)
-            vi->N()=-(*vi).N();
+        VertexType &v = m.vert[i];
+        if ( v.N().dot(p.viewPoint- v.P())<0.0f)
+            v.N()=-v.N();
       }
       return;
     }
 
+    OrientNormalsMST(m,p.coherentAdjNum,tree,cb);
+  }
+
+  /// The original serial orientation pass: a heap based propagation that starts from the first
+  /// unvisited vertex and always follows the arc with the most coherent normals.
+  static void OrientNormalsHeap(MeshType &m, int coherentAdjNum, KdTree<ScalarType> &tree)
+  {
     tri::UpdateFlags<MeshType>::VertexClearV(m);
     std::vector<WArc> heap;
     VertexIterator vi=m.vert.begin();
@@ -165,7 +333,7 @@ public:
       if(vi==m.vert.end()) return;
 
       vi->SetV();
-      AddNeighboursToHeap(m,&*vi,p.coherentAdjNum,tree,heap);
+      AddNeighboursToHeap(m,&*vi,coherentAdjNum,tree,heap);
 
       while(!heap.empty())
       {
@@ -177,12 +345,10 @@ public:
           a.trg->SetV();
           if(a.src->cN()*a.trg->cN()<0.0f)
               a.trg->N()=-a.trg->N();
-          AddNeighboursToHeap(m,a.trg,p.coherentAdjNum,tree,heap);
+          AddNeighboursToHeap(m,a.trg,coherentAdjNum,tree,heap);
         }
       }
     }
-
-    return;
   }
 
 };
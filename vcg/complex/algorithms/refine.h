@@ -1277,6 +1277,316 @@ bool RefineMidpoint(MESH_TYPE &m, EDGEPRED &ep, bool RefineSelected=false, CallB
 	return true;
 }
 
+/*********************************************************
+
+Parallel version of RefineE.
+
+It produces the same vertices and faces, in the same order, of RefineE (and of RefineMidpoint
+when the edges are not manifold), but the edges to split are enumerated, the new vertices are
+computed and the faces are split concurrently, in a single allocation of vertices and faces.
+The FF adjacency of the refined mesh is derived from the one of the original mesh instead of
+being rebuilt from scratch (around non manifold edges the order of the faces may differ from
+the one given by UpdateTopology::FaceFace).
+
+The edge predicate is shared by all the threads and it must be safe to call it concurrently
+(e.g. EdgeLen); the midpoint functor is copied once per thread.
+Unlike RefineE the visited flag of the faces is not touched.
+
+Requirement: FF Adjacency
+
+**********************************************************/
+template<class MESH_TYPE,class MIDPOINT, class EDGEPRED>
+bool RefineEParallel(MESH_TYPE &m, MIDPOINT &mid, EDGEPRED &ep, bool RefineSelected=false, CallBackPos *cb = 0)
+{
+	typedef typename MESH_TYPE::VertexPointer VertexPointer;
+	typedef typename MESH_TYPE::FacePointer FacePointer;
+	typedef typename MESH_TYPE::FaceType FaceType;
+	typedef typename MESH_TYPE::FaceType::TexCoordType TexCoordType;
+	typedef face::Pos<FaceType>  PosType;
+
+	assert(tri::HasFFAdjacency(m));
+	tri::UpdateFlags<MESH_TYPE>::FaceBorderFromFF(m);
+
+	const int fn = int(m.face.size());
+	// the side j of f can be split / can own the new vertex (same rules of RefineE)
+	auto active = [&] (const FaceType &f, int j) -> bool {
+		return !f.IsD() && (!RefineSelected || (f.IsS() && f.cFFp(j)->IsS()));
+	};
+
+	// First Loop: the predicate is evaluated on every side of every edge,
+	// an edge is split if any of the faces around it asks for it
+	if(cb) (*cb)(0,"Refining...");
+	std::vector<char> want(3*fn, 0), split(3*fn, 0);
+#pragma omp parallel for schedule(static)
+	for(int fi=0; fi<fn; ++fi)
+		for(int j=0; j<3; ++j)
+			if(active(m.face[fi], j))
+			{
+				PosType edgeCur(&m.face[fi], j);
+				want[3*fi+j] = ep(edgeCur) ? 1 : 0;
+			}
+
+	// owner[3*fi+j] is the side (3*face+edge) that creates the vertex of the edge:
+	// the first one, in face order, that can own it
+	std::vector<int> owner(3*fn, -1);
+	std::vector<int> ownedNum(fn+1, 0);
+#pragma omp parallel for schedule(static)
+	for(int fi=0; fi<fn; ++fi)
+	{
+		if(m.face[fi].IsD()) continue;
+		for(int j=0; j<3; ++j)
+		{
+			PosType edgeCur(&m.face[fi], j), start = edgeCur;
+			char s = 0;
+			int own = -1;
+			do {
+				const int side = 3*int(tri::Index(m, edgeCur.F())) + edgeCur.E();
+				s |= want[side];
+				if(active(*edgeCur.F(), edgeCur.E()) && (own == -1 || side < own)) own = side;
+				edgeCur.NextF();
+			} while(edgeCur != start);
+			if(s)
+			{
+				split[3*fi+j] = 1;
+				owner[3*fi+j] = own;
+				if(own == 3*fi+j) ++ownedNum[fi+1];
+			}
+		}
+	}
+
+	for(int fi=0; fi<fn; ++fi) ownedNum[fi+1] += ownedNum[fi];
+	const int NewVertNum = ownedNum[fn];
+	if(NewVertNum == 0) return false;
+
+	// Second loop: the new vertices are numbered in face order, as in RefineE
+	if(cb) (*cb)(33,"Refining...");
+	const size_t firstNewVert = m.vert.size();
+	tri::Allocator<MESH_TYPE>::AddVertices(m, NewVertNum);
+	std::vector<int> vid(3*fn, -1);
+#pragma omp parallel
+	{
+		MIDPOINT localMid(mid);
+#pragma omp for schedule(static)
+		for(int fi=0; fi<fn; ++fi)
+		{
+			int k = ownedNum[fi];
+			for(int j=0; j<3; ++j)
+				if(owner[3*fi+j] == 3*fi+j)
+				{
+					vid[3*fi+j] = k;
+					localMid(m.vert[firstNewVert+k], PosType(&m.face[fi], j));
+					++k;
+				}
+		}
+	}
+
+	// Third loop: the faces are split, the new faces are numbered in face order, as in RefineE
+	std::vector<int> newFaceBase(fn+1, 0);
+#pragma omp parallel for schedule(static)
+	for(int fi=0; fi<fn; ++fi)
+		if(!m.face[fi].IsD())
+		{
+			const int ind = int(split[3*fi+0]) + 2*int(split[3*fi+1]) + 4*int(split[3*fi+2]);
+			newFaceBase[fi+1] = SplitTab[ind].TriNum - 1;
+		}
+	for(int fi=0; fi<fn; ++fi) newFaceBase[fi+1] += newFaceBase[fi];
+	const int NewFaceNum = newFaceBase[fn];
+
+	if(cb) (*cb)(66,"Refining...");
+	tri::Allocator<MESH_TYPE>::AddFaces(m, NewFaceNum);
+
+	// the original vertices and FF adjacency, needed to link the new faces across the old edges
+	std::vector<VertexPointer> oldV(3*fn);
+	std::vector<int> oldFF(3*fn);
+	std::vector<char> oldFFi(3*fn);
+	// sideFace/sideEdge[2*(3*fi+e)+s]: the new face (and its edge) that covers the half of
+	// the old edge e of fi incident on the old vertex V(e) (s=0) or V(e+1) (s=1)
+	std::vector<int> sideFace(6*fn, -1);
+	std::vector<char> sideEdge(6*fn, 0);
+#pragma omp parallel for schedule(static)
+	for(int fi=0; fi<fn; ++fi)
+		if(!m.face[fi].IsD())
+			for(int j=0; j<3; ++j)
+			{
+				oldV[3*fi+j] = m.face[fi].V(j);
+				oldFF[3*fi+j] = int(tri::Index(m, m.face[fi].FFp(j)));
+				oldFFi[3*fi+j] = char(m.face[fi].FFi(j));
+			}
+
+	const int firstNewFace = fn;
+#pragma omp parallel
+	{
+		MIDPOINT localMid(mid);
+#pragma omp for schedule(static)
+		for(int fi=0; fi<fn; ++fi)
+		{
+			if(m.face[fi].IsD()) continue;
+			FaceType &f = m.face[fi];
+
+			VertexPointer vv[6];
+			vv[0] = f.V(0);
+			vv[1] = f.V(1);
+			vv[2] = f.V(2);
+			for(int j=0; j<3; ++j)
+				vv[3+j] = split[3*fi+j] ? &m.vert[firstNewVert + vid[owner[3*fi+j]]] : 0;
+
+			const int ind = ((vv[3] != NULL) ? 1 : 0) + ((vv[4] != NULL) ? 2 : 0) + ((vv[5] != NULL) ? 4 : 0);
+
+			FacePointer nf[4];
+			nf[0] = &f;
+			for(int i=1; i<SplitTab[ind].TriNum; ++i)
+			{
+				nf[i] = &m.face[firstNewFace + newFaceBase[fi] + i-1];
+				if(RefineSelected || f.IsS()) (*nf[i]).SetS();
+				nf[i]->ImportData(f);
+			}
+
+			TexCoordType wtt[6];
+			if(tri::HasPerWedgeTexCoord(m))
+				for(int i=0; i<3; ++i)
+				{
+					wtt[i] = f.WT(i);
+					wtt[3+i] = localMid.WedgeInterp(f.WT(i), f.WT((i+1)%3));
+				}
+
+			const int orgflag = f.Flags();
+			for(int i=0; i<SplitTab[ind].TriNum; ++i)
+				for(int j=0; j<3; ++j)
+				{
+					(*nf[i]).V(j) = &*vv[SplitTab[ind].TV[i][j]];
+
+					if(tri::HasPerWedgeTexCoord(m))
+						(*nf[i]).WT(j) = wtt[SplitTab[ind].TV[i][j]];
+
+					if(SplitTab[ind].TE[i][j] != 3)
+					{
+						if(orgflag & (MESH_TYPE::FaceType::BORDER0<<(SplitTab[ind].TE[i][j])))
+							(*nf[i]).SetB(j);
+						else
+							(*nf[i]).ClearB(j);
+
+						if(orgflag & (MESH_TYPE::FaceType::FACEEDGESEL0<<(SplitTab[ind].TE[i][j])))
+							(*nf[i]).SetFaceEdgeS(j);
+						else
+							(*nf[i]).ClearFaceEdgeS(j);
+					}
+					else
+					{
+						(*nf[i]).ClearB(j);
+						(*nf[i]).ClearFaceEdgeS(j);
+					}
+				}
+
+			if(SplitTab[ind].TriNum==3 &&
+			   SquaredDistance(vv[SplitTab[ind].swap[0][0]]->P(),vv[SplitTab[ind].swap[0][1]]->P()) <
+			   SquaredDistance(vv[SplitTab[ind].swap[1][0]]->P(),vv[SplitTab[ind].swap[1][1]]->P()) )
+			{ // swap the last two triangles
+				(*nf[2]).V(1) = (*nf[1]).V(0);
+				(*nf[1]).V(1) = (*nf[2]).V(0);
+				if(tri::HasPerWedgeTexCoord(m)){ //swap also textures coordinates
+					(*nf[2]).WT(1) = (*nf[1]).WT(0);
+					(*nf[1]).WT(1) = (*nf[2]).WT(0);
+				}
+
+				if((*nf[1]).IsB(0)) (*nf[2]).SetB(1); else (*nf[2]).ClearB(1);
+				if((*nf[2]).IsB(0)) (*nf[1]).SetB(1); else (*nf[1]).ClearB(1);
+				(*nf[1]).ClearB(0);
+				(*nf[2]).ClearB(0);
+
+				if((*nf[1]).IsFaceEdgeS(0)) (*nf[2]).SetFaceEdgeS(1); else (*nf[2]).ClearFaceEdgeS(1);
+				if((*nf[2]).IsFaceEdgeS(0)) (*nf[1]).SetFaceEdgeS(1); else (*nf[1]).ClearFaceEdgeS(1);
+				(*nf[1]).ClearFaceEdgeS(0);
+				(*nf[2]).ClearFaceEdgeS(0);
+			}
+
+			// classify the edges of the new faces: the internal ones are linked here,
+			// the ones lying on an old edge are recorded in the side tables
+			for(int i=0; i<SplitTab[ind].TriNum; ++i)
+				for(int j=0; j<3; ++j)
+				{
+					int a = 0, b = 0;
+					while(vv[a] != (*nf[i]).V(j)) ++a;
+					while(vv[b] != (*nf[i]).V1(j)) ++b;
+					int e = -1;
+					if(a<3 && b<3)
+						e = ((a+1)%3 == b) ? a : b;
+					else if(a<3 && (a == b-3 || a == (b-3+1)%3))
+						e = b-3;
+					else if(b<3 && (b == a-3 || b == (a-3+1)%3))
+						e = a-3;
+
+					if(e == -1)
+					{
+						for(int i2=0; i2<SplitTab[ind].TriNum; ++i2)
+							for(int j2=0; j2<3; ++j2)
+								if((*nf[i2]).V(j2) == (*nf[i]).V1(j) && (*nf[i2]).V1(j2) == (*nf[i]).V(j))
+								{
+									(*nf[i]).FFp(j) = nf[i2];
+									(*nf[i]).FFi(j) = j2;
+								}
+					}
+					else
+					{
+						const int fid = int(tri::Index(m, nf[i]));
+						for(int s=0; s<2; ++s)
+						{
+							const int o = (s==0) ? e : (e+1)%3;
+							if(a == o || b == o)
+							{
+								sideFace[2*(3*fi+e)+s] = fid;
+								sideEdge[2*(3*fi+e)+s] = char(j);
+							}
+						}
+					}
+				}
+		}
+	}
+
+	// Fourth loop: the new faces lying on an old edge are linked to the ones on the same half
+	// of the edge in the next old face around it
+#pragma omp parallel for schedule(static)
+	for(int fi=0; fi<fn; ++fi)
+	{
+		if(m.face[fi].IsD()) continue;
+		for(int e=0; e<3; ++e)
+		{
+			const int g = oldFF[3*fi+e], w = oldFFi[3*fi+e];
+			for(int s=0; s<2; ++s)
+			{
+				FaceType &nf = m.face[sideFace[2*(3*fi+e)+s]];
+				const int nj = sideEdge[2*(3*fi+e)+s];
+				if(g == fi && w == e)
+				{
+					nf.FFp(nj) = &nf;
+					nf.FFi(nj) = nj;
+					continue;
+				}
+				VertexPointer vs = (s==0) ? oldV[3*fi+e] : oldV[3*fi+(e+1)%3];
+				const int gs = (oldV[3*g+w] == vs) ? 0 : 1;
+				nf.FFp(nj) = &m.face[sideFace[2*(3*g+w)+gs]];
+				nf.FFi(nj) = sideEdge[2*(3*g+w)+gs];
+			}
+		}
+	}
+
+	if(cb) (*cb)(100,"Refining...");
+	return true;
+}
+
+template<class MESH_TYPE,class MIDPOINT>
+bool RefineParallel(MESH_TYPE &m, MIDPOINT mid, typename MESH_TYPE::ScalarType thr=0,bool RefineSelected=false, CallBackPos *cb = 0)
+{
+	EdgeLen <MESH_TYPE, typename MESH_TYPE::ScalarType> ep(thr);
+	return RefineEParallel(m,mid,ep,RefineSelected,cb);
+}
+
+template<class MESH_TYPE, class EDGEPRED>
+bool RefineMidpointParallel(MESH_TYPE &m, EDGEPRED &ep, bool RefineSelected=false, CallBackPos *cb = 0)
+{
+	MidPoint<MESH_TYPE> mid(&m);
+	return RefineEParallel(m,mid,ep,RefineSelected,cb);
+}
+
 } // namespace tri
 } // namespace vcg
 
@@ -620,6 +620,82 @@ bool RefineOddEvenE(MESH_TYPE &m, ODD_VERT odd, EVEN_VERT even, PREDICATE edgePr
     return true;
 }
 
+/*!
+ * \brief Parallel version of RefineOddEven, see RefineOddEvenEParallel.
+ */
+template<class MESH_TYPE, class ODD_VERT, class EVEN_VERT>
+bool RefineOddEvenParallel(MESH_TYPE &m, ODD_VERT odd, EVEN_VERT even,float length,
+                           bool RefineSelected=false, CallBackPos *cbOdd = 0, CallBackPos *cbEven = 0)
+{
+  EdgeLen <MESH_TYPE, typename MESH_TYPE::ScalarType> ep(length);
+  return RefineOddEvenEParallel(m, odd, even, ep, RefineSelected, cbOdd, cbEven);
+}
+
+/*!
+ * \brief Parallel version of RefineOddEvenE.
+ *
+ * The even vertices are computed concurrently (each from the same face used by RefineOddEvenE)
+ * and the odd ones are created by RefineEParallel, so the result is the same of RefineOddEvenE.
+ * The odd and even functors are copied once per thread; the predicate must be safe to call concurrently.
+ */
+template<class MESH_TYPE, class ODD_VERT, class EVEN_VERT, class PREDICATE>
+bool RefineOddEvenEParallel(MESH_TYPE &m, ODD_VERT odd, EVEN_VERT even, PREDICATE edgePred,
+                            bool RefineSelected=false, CallBackPos *cbOdd = 0, CallBackPos *cbEven = 0)
+{
+    typedef typename MESH_TYPE::template PerVertexAttributeHandle<int> ValenceAttr;
+
+    cbEven = cbOdd;
+
+    ValenceAttr valence = vcg::tri::Allocator<MESH_TYPE>:: template AddPerVertexAttribute<int>(m);
+    odd.setValenceAttr(&valence);
+    even.setValenceAttr(&valence);
+
+    // the first face (and wedge) of each vertex, the colors are interpolated in the same order of RefineOddEvenE
+    std::vector<int> firstFace(m.vn, -1);
+    std::vector<char> firstWedge(m.vn, 0);
+    for (size_t fi = 0; fi < m.face.size(); ++fi) {
+        typename MESH_TYPE::FaceType &f = m.face[fi];
+        if (f.IsD() || (RefineSelected && !f.IsS())) continue;
+        for (int i = 0; i < 3; i++) {
+            int index = tri::Index(m, f.V(i));
+            if (firstFace[index] == -1 && !f.V(i)->IsD()) {
+                firstFace[index] = int(fi);
+                firstWedge[index] = char(i);
+                if( tri::HasPerVertexColor(m) ) {
+                    f.V(i)->C().lerp(f.V0(i)->C() , f.V1(i)->C(),0.5f);
+                }
+            }
+        }
+    }
+    if (cbEven) (*cbEven)(0,"Refining");
+
+    std::vector<std::pair<typename MESH_TYPE::CoordType, typename MESH_TYPE::CoordType> > newEven(m.vn);
+#pragma omp parallel
+    {
+        EVEN_VERT localEven(even);
+#pragma omp for schedule(static)
+        for (int i = 0; i < int(newEven.size()); ++i)
+            if (firstFace[i] != -1)
+                localEven(newEven[i], face::Pos<typename MESH_TYPE::FaceType>(&m.face[firstFace[i]], firstWedge[i]));
+    }
+
+    RefineEParallel< MESH_TYPE, ODD_VERT > (m, odd, edgePred, RefineSelected, cbOdd);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < int(newEven.size()); ++i) {
+        if (firstFace[i] != -1) {
+            m.vert[i].P()=newEven[i].first;
+            m.vert[i].N()=newEven[i].second;
+        }
+    }
+
+    odd.setValenceAttr(0);
+    even.setValenceAttr(0);
+
+    vcg::tri::Allocator<MESH_TYPE>::DeletePerVertexAttribute(m, valence);
+
+    return true;
+}
+
 } // namespace tri
 } // namespace vcg
 
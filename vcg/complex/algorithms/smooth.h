@@ -29,6 +29,7 @@
 #include <vcg/complex/algorithms/update/halfedge_topology.h>
 #include <vcg/complex/algorithms/closest.h>
 #include <vcg/space/index/kdtree/kdtree.h>
+#include <vcg/complex/algorithms/differential_operators.h>
 
 namespace vcg
 {
@@ -613,6 +614,235 @@ So if
         } // end for step
     };
 
+    /*
+  Multithreaded versions of the Laplacian, Taubin and HC smoothing of triangle meshes.
+
+  The neighbourhood of each vertex is stored once in a LaplacianStencil, a compressed (CSR) list of
+  (neighbour, weight) pairs plus a weight for the vertex itself, and reused by all the iterations.
+  Each iteration is a Jacobi step: the new positions are gathered in parallel from a packed copy of
+  the old ones into a second buffer, and the two buffers are swapped; the mesh is written only at the end.
+  The results are the same of the serial versions up to the round off (the multiple contributions of a
+  neighbour are merged into a single weight), and do not depend on the number of threads.
+  Like the serial versions, they need the face border flags to be up to date.
+  */
+    class LaplacianStencil
+    {
+      public:
+        std::vector<int> start;             // per vertex, first neighbour (size vert.size()+1)
+        std::vector<int> adj;               // neighbour indexes
+        std::vector<ScalarType> weight;     // neighbour weights
+        std::vector<ScalarType> selfWeight; // weight of the vertex itself
+        std::vector<ScalarType> cnt;        // selfWeight + sum of the neighbour weights
+
+        /// Build the stencil of AccumulateLaplacianInfo (uniform weights), or, if hcFlag, the one of VertexCoordLaplacianHC.
+        void Build(MeshType &m, bool hcFlag = false)
+        {
+            const size_t vn = m.vert.size();
+            std::vector<char> border(vn, 0);
+            if (!hcFlag)
+                for (size_t i = 0; i < m.face.size(); ++i)
+                    if (!m.face[i].IsD())
+                        for (int j = 0; j < 3; ++j)
+                            if (m.face[i].IsB(j))
+                                border[tri::Index(m, m.face[i].V0(j))] = border[tri::Index(m, m.face[i].V1(j))] = 1;
+
+            // the border vertices are averaged only with themselves and the adjacent border vertices
+            std::vector<std::pair<int, int> > edges;
+            for (size_t i = 0; i < m.face.size(); ++i)
+                if (!m.face[i].IsD())
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        const int i0 = int(tri::Index(m, m.face[i].V0(j)));
+                        const int i1 = int(tri::Index(m, m.face[i].V1(j)));
+                        const int rep = (hcFlag && m.face[i].IsB(j)) ? 2 : 1;
+                        for (int r = 0; r < rep; ++r)
+                        {
+                            if (hcFlag || m.face[i].IsB(j) || !border[i0]) edges.push_back(std::make_pair(i0, i1));
+                            if (hcFlag || m.face[i].IsB(j) || !border[i1]) edges.push_back(std::make_pair(i1, i0));
+                        }
+                    }
+            std::sort(edges.begin(), edges.end());
+
+            start.assign(vn + 1, 0);
+            adj.clear();
+            weight.clear();
+            selfWeight.resize(vn);
+            cnt.resize(vn);
+            for (size_t i = 0; i < vn; ++i)
+            {
+                selfWeight[i] = border[i] ? 1 : 0;
+                cnt[i] = selfWeight[i];
+            }
+            for (size_t k = 0; k < edges.size(); ++k)
+            {
+                if (k == 0 || edges[k] != edges[k - 1])
+                {
+                    adj.push_back(edges[k].second);
+                    weight.push_back(0);
+                    start[edges[k].first + 1] = int(adj.size());
+                }
+                weight.back() += 1;
+                cnt[edges[k].first] += 1;
+            }
+            for (size_t i = 0; i < vn; ++i)
+                start[i + 1] = std::max(start[i + 1], start[i]);
+        }
+
+        /// Replace the weights of the inner vertices with the cotangent ones of AccumulateLaplacianInfo,
+        /// cot(a_ij)+cot(b_ij) for each edge, taken from the operators of the current positions.
+        /// The border vertices keep the uniform weights, as in AccumulateLaplacianInfo.
+        template <class OperatorsType>
+        void SetCotangentWeights(const OperatorsType &ops)
+        {
+#pragma omp parallel for schedule(static)
+            for (int i = 0; i < int(cnt.size()); ++i)
+            {
+                if (selfWeight[i] != 0 || start[i] == start[i + 1])
+                    continue;
+                ScalarType c = 0;
+                for (int k = start[i]; k < start[i + 1]; ++k)
+                {
+                    weight[k] = ScalarType(2 * ops.Weight(i, adj[k]));
+                    c += weight[k];
+                }
+                cnt[i] = c;
+            }
+        }
+
+        /// Weighted sum of the positions of the neighbours of the vertex i (and of itself)
+        inline CoordType Sum(const std::vector<CoordType> &pos, int i) const
+        {
+            CoordType s = pos[i] * selfWeight[i];
+            for (int k = start[i]; k < start[i + 1]; ++k)
+                s += pos[adj[k]] * weight[k];
+            return s;
+        }
+    };
+
+    /// Packed copy of the vertex positions and the mask of the vertices that can be moved.
+    static void InitSmoothBuffers(MeshType &m, const LaplacianStencil &ls, bool SmoothSelected, std::vector<CoordType> &pos, std::vector<char> &movable)
+    {
+        pos.resize(m.vert.size());
+        movable.resize(m.vert.size());
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < int(m.vert.size()); ++i)
+        {
+            pos[i] = m.vert[i].cP();
+            movable[i] = !m.vert[i].IsD() && ls.cnt[i] > 0 && (!SmoothSelected || m.vert[i].IsS());
+        }
+    }
+
+    static void WriteSmoothBuffers(MeshType &m, const std::vector<CoordType> &pos, const std::vector<char> &movable)
+    {
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < int(m.vert.size()); ++i)
+            if (movable[i])
+                m.vert[i].P() = pos[i];
+    }
+
+    /// Multithreaded version of VertexCoordLaplacian.
+    /// The cotangent weights are recomputed at each step from the current positions, as in the serial version;
+    /// they need a compact triangle mesh, otherwise the serial version is used.
+    static void VertexCoordLaplacianParallel(MeshType &m, int step, bool SmoothSelected = false, bool cotangentWeight = false, vcg::CallBackPos *cb = 0)
+    {
+        if (cotangentWeight && (FaceType::HasPolyInfo() || m.vn != int(m.vert.size()) || m.fn != int(m.face.size())))
+        {
+            VertexCoordLaplacian(m, step, SmoothSelected, true, cb);
+            return;
+        }
+        LaplacianStencil ls;
+        ls.Build(m);
+        std::vector<CoordType> pos, newPos(m.vert.size());
+        std::vector<char> movable;
+        InitSmoothBuffers(m, ls, SmoothSelected, pos, movable);
+        DifferentialOperators<MeshType> ops;
+        for (int i = 0; i < step; ++i)
+        {
+            if (cb)
+                cb(100 * i / step, "Classic Laplacian Smoothing");
+            if (cotangentWeight)
+            {
+                if (i > 0)
+                    WriteSmoothBuffers(m, pos, movable);
+                ops.Update(m);
+                ls.SetCotangentWeights(ops);
+            }
+#pragma omp parallel for schedule(static)
+            for (int vi = 0; vi < int(pos.size()); ++vi)
+                newPos[vi] = (movable[vi] && ls.cnt[vi] > 0) ? (pos[vi] + ls.Sum(pos, vi)) / (ls.cnt[vi] + 1) : pos[vi];
+            pos.swap(newPos);
+        }
+        WriteSmoothBuffers(m, pos, movable);
+    }
+
+    /// Multithreaded version of VertexCoordTaubin.
+    static void VertexCoordTaubinParallel(MeshType &m, int step, float lambda, float mu, bool SmoothSelected = false, vcg::CallBackPos *cb = 0)
+    {
+        LaplacianStencil ls;
+        ls.Build(m);
+        std::vector<CoordType> pos, newPos(m.vert.size());
+        std::vector<char> movable;
+        InitSmoothBuffers(m, ls, SmoothSelected, pos, movable);
+        for (int i = 0; i < step; ++i)
+        {
+            if (cb)
+                cb(100 * i / step, "Taubin Smoothing");
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                const ScalarType scale = (pass == 0) ? lambda : mu;
+#pragma omp parallel for schedule(static)
+                for (int vi = 0; vi < int(pos.size()); ++vi)
+                {
+                    if (movable[vi])
+                    {
+                        CoordType Delta = ls.Sum(pos, vi) / ls.cnt[vi] - pos[vi];
+                        newPos[vi] = pos[vi] + Delta * scale;
+                    }
+                    else
+                        newPos[vi] = pos[vi];
+                }
+                pos.swap(newPos);
+            }
+        }
+        WriteSmoothBuffers(m, pos, movable);
+    }
+
+    /// Multithreaded version of VertexCoordLaplacianHC.
+    static void VertexCoordLaplacianHCParallel(MeshType &m, int step, bool SmoothSelected = false)
+    {
+        const ScalarType beta = 0.5;
+        LaplacianStencil ls;
+        ls.Build(m, true);
+        std::vector<CoordType> pos, avg(m.vert.size()), newPos(m.vert.size());
+        std::vector<char> movable;
+        InitSmoothBuffers(m, ls, SmoothSelected, pos, movable);
+        for (int i = 0; i < step; ++i)
+        {
+            // First pass: compute the laplacian
+#pragma omp parallel for schedule(static)
+            for (int vi = 0; vi < int(pos.size()); ++vi)
+                avg[vi] = (ls.cnt[vi] > 0) ? ls.Sum(pos, vi) / ls.cnt[vi] : pos[vi];
+
+            // Second pass: compute average difference
+#pragma omp parallel for schedule(static)
+            for (int vi = 0; vi < int(pos.size()); ++vi)
+            {
+                if (movable[vi])
+                {
+                    CoordType dif(0, 0, 0);
+                    for (int k = ls.start[vi]; k < ls.start[vi + 1]; ++k)
+                        dif += (avg[ls.adj[k]] - pos[ls.adj[k]]) * ls.weight[k];
+                    dif /= ls.cnt[vi];
+                    newPos[vi] = avg[vi] - (avg[vi] - pos[vi]) * beta + dif * (1 - beta);
+                }
+                else
+                    newPos[vi] = pos[vi];
+            }
+            pos.swap(newPos);
+        }
+        WriteSmoothBuffers(m, pos, movable);
+    }
+
     // Laplacian smooth of the quality.
 
     class ColorSmoothInfo
@@ -1355,22 +1585,28 @@ A(...) (2-2nm)   =
             tree = new KdTree<ScalarType>(ww);
         else
             tree = tp;
-        typename KdTree<ScalarType>::PriorityQueue nq;
 
         //  tree->setMaxNofNeighbors(neighborNum);
         for (int ii = 0; ii < iterNum; ++ii)
         {
-            for (VertexIterator vi = m.vert.begin(); vi != m.vert.end(); ++vi)
+            // every vertex writes only its own accumulator, the kNN queries are thread safe
+#pragma omp parallel
             {
-                tree->doQueryK(vi->cP(), neighborNum, nq);
-                int neighbours = nq.getNofElements();
-                for (int i = 0; i < neighbours; i++)
+                typename KdTree<ScalarType>::PriorityQueue nq;
+#pragma omp for schedule(dynamic, 256)
+                for (int vInd = 0; vInd < int(m.vert.size()); ++vInd)
                 {
-                    int neightId = nq.getIndex(i);
-                    if (m.vert[neightId].cN() * vi->cN() > 0)
-                        TD[vi] += m.vert[neightId].cN();
-                    else
-                        TD[vi] -= m.vert[neightId].cN();
+                    VertexIterator vi = m.vert.begin() + vInd;
+                    tree->doQueryK(vi->cP(), neighborNum, nq);
+                    int neighbours = nq.getNofElements();
+                    for (int i = 0; i < neighbours; i++)
+                    {
+                        int neightId = nq.getIndex(i);
+                        if (m.vert[neightId].cN() * vi->cN() > 0)
+                            TD[vi] += m.vert[neightId].cN();
+                        else
+                            TD[vi] -= m.vert[neightId].cN();
+                    }
                 }
             }
             for (VertexIterator vi = m.vert.begin(); vi != m.vert.end(); ++vi)
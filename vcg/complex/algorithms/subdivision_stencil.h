@@ -0,0 +1,225 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef __VCGLIB_SUBDIVISION_STENCIL
+#define __VCGLIB_SUBDIVISION_STENCIL
+
+#include <vcg/complex/complex.h>
+#include <vcg/complex/algorithms/refine_loop.h>
+#include <vcg/complex/algorithms/update/normal.h>
+#include <Eigen/Sparse>
+
+namespace vcg {
+namespace tri {
+
+/*!
+ * \brief Centroid projection that also records the weighted vertices it has been given.
+ */
+template<class MESH_TYPE>
+struct StencilCentroid : public Centroid<MESH_TYPE>
+{
+    typedef typename MESH_TYPE::VertexType VertexType;
+    typedef typename Centroid<MESH_TYPE>::LScalar LScalar;
+
+    std::vector<std::pair<const VertexType *, LScalar> > entries;
+
+    inline void reset() {
+        Centroid<MESH_TYPE>::reset();
+        entries.clear();
+    }
+    inline void addVertex(const VertexType &v, LScalar w) {
+        Centroid<MESH_TYPE>::addVertex(v, w);
+        entries.push_back(std::make_pair(&v, w));
+    }
+};
+
+/*!
+ * \brief Loop subdivision recorded as a sparse stencil matrix.
+ *
+ * Build() subdivides a control mesh (cage) a given number of times with the Loop rules
+ * (OddPointLoopGeneric/EvenPointLoopGeneric with the given weights) and records, for each vertex
+ * of the fine mesh, its position as a weighted sum of the cage vertices: P_fine = S * P_cage.
+ * When only the positions of the cage change (animation, shape optimization) Apply() updates the
+ * fine mesh with a parallel sparse product and recomputes its normals, without any topology work.
+ *
+ * Only linear schemes can be recorded, so LS3Projection is not supported.
+ * Colors and texture coordinates are interpolated by Build() only.
+ */
+template <class MeshType, class WeightType = LoopWeight<typename MeshType::ScalarType>, typename Scalar = double>
+class SubdivisionStencil
+{
+public:
+    typedef typename MeshType::VertexType VertexType;
+    typedef typename MeshType::FaceType   FaceType;
+    typedef typename MeshType::CoordType  CoordType;
+    typedef typename MeshType::template PerVertexAttributeHandle<int> ValenceAttr;
+    typedef face::Pos<FaceType> PosType;
+    typedef Eigen::SparseMatrix<Scalar, Eigen::RowMajor> SparseMatrix;
+    typedef Eigen::Triplet<Scalar> Triplet;
+    typedef std::vector<std::pair<int, Scalar> > Row;
+    typedef OddPointLoopGeneric<MeshType, StencilCentroid<MeshType>, WeightType> OddType;
+    typedef EvenPointLoopGeneric<MeshType, StencilCentroid<MeshType>, WeightType> EvenType;
+
+    SubdivisionStencil() : levels(0) {}
+
+    /// Copies the cage into fine, subdivides it levels times and records the stencil matrix.
+    /// The cage must be compact and made of triangles; fine must have FF adjacency.
+    void Build(MeshType &cage, MeshType &fine, int levels, CallBackPos *cb = 0)
+    {
+        RequireCompactness(cage);
+        RequireFFAdjacency(fine);
+        fine.Clear();
+        Append<MeshType, MeshType>::MeshCopy(fine, cage);
+        UpdateTopology<MeshType>::FaceFace(fine);
+
+        this->levels = levels;
+        S.resize(fine.vn, fine.vn);
+        S.setIdentity();
+        for (int l = 0; l < levels; ++l)
+        {
+            if (cb) (*cb)(100*l/levels, "Building subdivision stencil");
+            const int oldVN = fine.vn;
+            std::vector<Row> rows(size_t(oldVN) + 3*size_t(fine.fn));
+            auto splitAll = [](const PosType &) { return true; };
+            RefineOddEvenEParallel(fine, RecordOdd(fine, rows, OddType(fine)), RecordEven(fine, rows, EvenType()), splitAll);
+            rows.resize(fine.vn);
+
+            // S_l maps the vertices of level l to the ones of level l+1; even vertices that have
+            // not been moved (unreferenced) are kept as they are
+            std::vector<Triplet> triplets;
+            triplets.reserve(size_t(fine.vn) * 7);
+            for (int i = 0; i < fine.vn; ++i)
+            {
+                if (rows[i].empty() && i < oldVN)
+                    triplets.push_back(Triplet(i, i, Scalar(1)));
+                for (size_t k = 0; k < rows[i].size(); ++k)
+                    triplets.push_back(Triplet(i, rows[i][k].first, rows[i][k].second));
+            }
+            SparseMatrix Sl(fine.vn, oldVN);
+            Sl.setFromTriplets(triplets.begin(), triplets.end());
+            S = SparseMatrix(Sl * S);
+        }
+        S.makeCompressed();
+
+        if (HasPerVertexNormal(fine))
+        {
+            vfi.Build(fine);
+            UpdateNormals(fine);
+        }
+        if (cb) (*cb)(100, "Building subdivision stencil");
+    }
+
+    /// Moves the vertices of fine to the subdivision of the current cage positions and updates
+    /// the vertex normals; cage and fine must have the same vertices (and fine the same faces) of Build().
+    void Apply(const MeshType &cage, MeshType &fine, bool updateNormals = true) const
+    {
+        assert(int(cage.vert.size()) == S.cols() && int(fine.vert.size()) == S.rows());
+        std::vector<Point3<Scalar> > cp(cage.vert.size());
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < int(cp.size()); ++i)
+            cp[i].Import(cage.vert[i].cP());
+
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < int(S.rows()); ++i)
+        {
+            Point3<Scalar> p(0, 0, 0);
+            for (typename SparseMatrix::InnerIterator it(S, i); it; ++it)
+                p += cp[it.col()] * it.value();
+            fine.vert[i].P().Import(p);
+        }
+
+        if (updateNormals && HasPerVertexNormal(fine))
+            UpdateNormals(fine);
+    }
+
+    /// The stencil matrix (fine VN x cage VN); each row sums to one.
+    const SparseMatrix &Matrix() const { return S; }
+
+    int Levels() const { return levels; }
+
+private:
+    // odd rule that stores, for the new vertex, the vertices and weights given to the projection
+    struct RecordOdd
+    {
+        MeshType *m;
+        std::vector<Row> *rows;
+        OddType odd;
+
+        RecordOdd(MeshType &m, std::vector<Row> &rows, const OddType &odd) : m(&m), rows(&rows), odd(odd) {}
+
+        void operator()(VertexType &nv, PosType ep)
+        {
+            odd(nv, ep);
+            Record((*rows)[tri::Index(*m, nv)], *m, odd.proj);
+        }
+        template<class ATTR_TYPE>
+        ATTR_TYPE WedgeInterp(ATTR_TYPE &t0, ATTR_TYPE &t1) { return odd.WedgeInterp(t0, t1); }
+        inline void setValenceAttr(ValenceAttr *valence) { odd.setValenceAttr(valence); }
+    };
+
+    // even rule that stores, for the moved vertex, the vertices and weights given to the projection
+    struct RecordEven
+    {
+        MeshType *m;
+        std::vector<Row> *rows;
+        EvenType even;
+
+        RecordEven(MeshType &m, std::vector<Row> &rows, const EvenType &even) : m(&m), rows(&rows), even(even) {}
+
+        void operator()(std::pair<CoordType, CoordType> &nv, PosType ep)
+        {
+            even(nv, ep);
+            Record((*rows)[tri::Index(*m, ep.f->V(ep.z))], *m, even.proj);
+        }
+        template<class ATTR_TYPE>
+        ATTR_TYPE WedgeInterp(ATTR_TYPE &t0, ATTR_TYPE &t1) { return even.WedgeInterp(t0, t1); }
+        inline void setValenceAttr(ValenceAttr *valence) { even.setValenceAttr(valence); }
+    };
+
+    static void Record(Row &row, const MeshType &m, const StencilCentroid<MeshType> &proj)
+    {
+        Scalar sumW = 0;
+        for (size_t k = 0; k < proj.entries.size(); ++k)
+            sumW += proj.entries[k].second;
+        row.resize(proj.entries.size());
+        for (size_t k = 0; k < proj.entries.size(); ++k)
+            row[k] = std::make_pair(int(tri::Index(m, proj.entries[k].first)), Scalar(proj.entries[k].second) / sumW);
+    }
+
+    void UpdateNormals(MeshType &fine) const
+    {
+        UpdateNormal<MeshType>::PerVertexParallel(fine, vfi);
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < int(fine.vert.size()); ++i)
+            fine.vert[i].N().Normalize();
+    }
+
+    SparseMatrix S;
+    int levels;
+    typename UpdateNormal<MeshType>::VertexFaceIndex vfi;
+};
+
+} // namespace tri
+} // namespace vcg
+
+#endif // __VCGLIB_SUBDIVISION_STENCIL
@@ -1,20 +1,353 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
 #ifndef VCG_TETFUSECOLLAPSE_H
 #define VCG_TETFUSECOLLAPSE_H
 
+#include <queue>
+#include <vcg/space/tetra3.h>
+#include <vcg/simplex/tetrahedron/pos.h>
+#include <vcg/complex/algorithms/update/topology.h>
+#include <vcg/complex/algorithms/update/flag.h>
+
 namespace vcg {
 namespace tetra {
 
+/** Simplification of tetrahedral meshes by vertex fusion (half edge collapse).
+
+  An interior vertex v is fused onto one of its neighbours u: the tetras sharing
+  the edge v-u are deleted and in all the other tetras of the VT star of v the
+  vertex v is replaced by u. Since v is interior its star is a ball, and the
+  collapse is valid if all the re-connected tetras keep their orientation;
+  moreover the quality of the new tetras must not drop below QualityThr
+  (or below the worst tetra of the star, if it was already worse).
+  Border vertices are never removed, so the boundary surface is preserved exactly.
+  The candidate collapse of each vertex is the shortest valid one.
+
+  Two drivers are provided:
+  - FuseSerial() performs one collapse at a time, always choosing the globally shortest one;
+  - FuseParallel() works in rounds: all the candidates are evaluated concurrently,
+    then a set of non conflicting collapses (no two removed vertices share a tetra,
+    i.e. their VT stars are disjoint) is selected by taking the candidates that are the
+    shortest among their neighbours, and they are all performed concurrently.
+    The result does not depend on the number of threads.
+
+  The mesh needs per vertex VT adjacency and flags, and per tetra VT and TT adjacency;
+  both the drivers leave the adjacency updated (removed elements are only flagged as deleted).
+*/
 template < class TetraMesh >
 class TetFuser {
     typedef typename TetraMesh::VertexType VertexType;
+    typedef typename TetraMesh::VertexPointer VertexPointer;
     typedef typename TetraMesh::TetraType   TetraType;
+    typedef typename TetraMesh::TetraPointer TetraPointer;
     typedef typename TetraMesh::CoordType   CoordType;
     typedef typename TetraMesh::ScalarType ScalarType;
 
-    
+public:
+    class Param
+    {
+    public:
+      int    TargetVertexNum = 0;  // stop when the mesh has this number of vertices
+      double QualityThr      = 0.1;// minimum admitted quality (1 for the regular tetra) of the new tetras
+      int    MaxRounds       = 1000; // maximum number of rounds of the parallel driver
+    };
+
+    /// Quality of a tetra: 6*sqrt(2)*Volume / (rms edge length)^3; it is 1 for the regular tetra,
+    /// 0 for a flat one and it has the sign of the volume.
+    static ScalarType Quality(const CoordType &p0, const CoordType &p1, const CoordType &p2, const CoordType &p3)
+    {
+      const ScalarType vol = ((p2 - p0) ^ (p1 - p0)) * (p3 - p0) / ScalarType(6.0);
+      const ScalarType l2 = ( SquaredDistance(p0,p1) + SquaredDistance(p0,p2) + SquaredDistance(p0,p3) +
+                              SquaredDistance(p1,p2) + SquaredDistance(p1,p3) + SquaredDistance(p2,p3) ) / ScalarType(6.0);
+      if(l2 == 0) return 0;
+      return ScalarType(6.0*M_SQRT2) * vol / (l2 * std::sqrt(l2));
+    }
+
+    /// Return true if v can be fused onto u; star/ind is the VT star of v.
+    static bool CheckCollapse(VertexPointer v, VertexPointer u, const std::vector<TetraPointer> &star, const std::vector<int> &ind, ScalarType qualityThr)
+    {
+      ScalarType minOldQ = std::numeric_limits<ScalarType>::max();
+      ScalarType minNewQ = std::numeric_limits<ScalarType>::max();
+      for(size_t k=0;k<star.size();++k)
+      {
+        TetraType *t = star[k];
+        if(t->V(0)==u || t->V(1)==u || t->V(2)==u || t->V(3)==u) continue; // it will be deleted
+        CoordType p[4];
+        for(int i=0;i<4;++i) p[i]=t->cP(i);
+        const ScalarType oldQ = Quality(p[0],p[1],p[2],p[3]);
+        p[ind[k]] = u->cP();
+        const ScalarType newQ = Quality(p[0],p[1],p[2],p[3]);
+        if(oldQ*newQ <= 0) return false; // flipped or flat
+        minOldQ = std::min(minOldQ, std::abs(oldQ));
+        minNewQ = std::min(minNewQ, std::abs(newQ));
+      }
+      return minNewQ >= std::min(minOldQ, qualityThr);
+    }
+
+    /// Find the shortest valid collapse of v; return the target vertex or 0 if there is none.
+    static VertexPointer BestCollapse(VertexPointer v, ScalarType &cost, const Param &pp,
+                                      std::vector<TetraPointer> &star, std::vector<int> &ind, std::vector<VertexPointer> &ring)
+    {
+      cost = std::numeric_limits<ScalarType>::max();
+      if(v->IsD() || v->IsB() || !v->IsW()) return 0;
+      VTStarVT<TetraType>(v,star,ind);
+      if(star.empty()) return 0;
+      VVStarVT<TetraType>(v,ring);
+      std::vector<std::pair<ScalarType,VertexPointer> > candVec;
+      for(size_t i=0;i<ring.size();++i)
+        if(ring[i]!=v)
+          candVec.push_back(std::make_pair(SquaredDistance(v->cP(),ring[i]->cP()),ring[i]));
+      std::sort(candVec.begin(),candVec.end());
+      for(size_t i=0;i<candVec.size();++i)
+        if(CheckCollapse(v,candVec[i].second,star,ind,ScalarType(pp.QualityThr)))
+        {
+          cost = candVec[i].first;
+          return candVec[i].second;
+        }
+      return 0;
+    }
+
+    /// Fuse v onto u. Tetras and vertex are only flagged as deleted (the mesh counters are not updated).
+    /// If updateVT is true the VT adjacency is kept consistent, otherwise it must be rebuilt afterwards.
+    /// Return the number of deleted tetras.
+    static int DoCollapse(VertexPointer v, VertexPointer u, const std::vector<TetraPointer> &star, const std::vector<int> &ind, bool updateVT)
+    {
+      int delNum=0;
+      for(size_t k=0;k<star.size();++k)
+      {
+        TetraType *t = star[k];
+        if(t->V(0)==u || t->V(1)==u || t->V(2)==u || t->V(3)==u)
+        {
+          if(updateVT)
+            for(int i=0;i<4;++i)
+              if(i!=ind[k]) VTDetach(t,i);
+          t->SetD();
+          ++delNum;
+        }
+        else
+        {
+          const int i = ind[k];
+          t->V(i) = u;
+          if(updateVT)
+          {
+            t->VTp(i) = u->VTp();
+            t->VTi(i) = u->VTi();
+            u->VTp() = t;
+            u->VTi() = i;
+          }
+        }
+      }
+      v->SetD();
+      return delNum;
+    }
+
+    /// Compute topology and border flags needed by the fusion.
+    static void Init(TetraMesh &m)
+    {
+      tri::RequireVTAdjacency(m);
+      tri::RequireTTAdjacency(m);
+      tri::UpdateTopology<TetraMesh>::TetraTetra(m);
+      tri::UpdateTopology<TetraMesh>::VertexTetra(m);
+      tri::UpdateFlags<TetraMesh>::VertexBorderFromTT(m);
+    }
+
+    /// Serial greedy simplification: always perform the globally shortest valid collapse.
+    /// Return the number of performed collapses.
+    static int FuseSerial(TetraMesh &m, const Param &pp)
+    {
+      Init(m);
+      std::vector<int> mark(m.vert.size(),0);
+      std::priority_queue<Candidate> heap;
+      std::vector<TetraPointer> star;
+      std::vector<int> ind;
+      std::vector<VertexPointer> ring;
+
+      for(size_t i=0;i<m.vert.size();++i)
+        PushCandidate(m,&m.vert[i],mark,heap,pp,star,ind,ring);
+
+      int collapseNum=0;
+      while(!heap.empty() && m.vn > pp.TargetVertexNum)
+      {
+        Candidate c = heap.top();
+        heap.pop();
+        VertexPointer v = &m.vert[c.v];
+        VertexPointer u = &m.vert[c.u];
+        if(v->IsD() || u->IsD() || mark[c.v]!=c.mark) continue;
+        VTStarVT<TetraType>(v,star,ind);
+        std::vector<VertexPointer> touched;
+        VVStarVT<TetraType>(v,touched);
+        m.tn -= DoCollapse(v,u,star,ind,true);
+        --m.vn;
+        ++collapseNum;
+        for(size_t i=0;i<touched.size();++i)
+        {
+          ++mark[tri::Index(m,touched[i])];
+          PushCandidate(m,touched[i],mark,heap,pp,star,ind,ring);
+        }
+      }
+      tri::UpdateTopology<TetraMesh>::TetraTetra(m);
+      return collapseNum;
+    }
+
+    /// Parallel simplification by rounds of independent collapses.
+    /// Return the number of performed collapses.
+    static int FuseParallel(TetraMesh &m, const Param &pp)
+    {
+      Init(m);
+      const int vertNum = int(m.vert.size());
+      std::vector<int> candU(vertNum);
+      std::vector<ScalarType> candCost(vertNum);
+      std::vector<char> selected(vertNum);
+      int collapseNum=0;
+
+      for(int round=0; round<pp.MaxRounds && m.vn > pp.TargetVertexNum; ++round)
+      {
+        if(round>0) tri::UpdateTopology<TetraMesh>::VertexTetra(m);
+
+        // 1) Evaluate the best collapse of every vertex
+#pragma omp parallel
+        {
+          std::vector<TetraPointer> star;
+          std::vector<int> ind;
+          std::vector<VertexPointer> ring;
+#pragma omp for schedule(dynamic, 256)
+          for(int i=0;i<vertNum;++i)
+          {
+            VertexPointer u = BestCollapse(&m.vert[i],candCost[i],pp,star,ind,ring);
+            candU[i] = u ? int(tri::Index(m,u)) : -1;
+          }
+        }
+
+        // 2) Select the candidates that are local minima among their neighbours:
+        //    two adjacent vertices cannot be both selected, so the stars of the selected ones are disjoint.
+#pragma omp parallel
+        {
+          std::vector<VertexPointer> ring;
+#pragma omp for schedule(dynamic, 256)
+          for(int i=0;i<vertNum;++i)
+          {
+            selected[i]=0;
+            if(candU[i]==-1) continue;
+            VVStarVT<TetraType>(&m.vert[i],ring);
+            bool localMin=true;
+            for(size_t j=0;j<ring.size() && localMin;++j)
+            {
+              const int w = int(tri::Index(m,ring[j]));
+              if(w!=i && candU[w]!=-1 && CandLess(candCost[w],w,candCost[i],i)) localMin=false;
+            }
+            selected[i]=localMin;
+          }
+        }
+
+        std::vector<int> selVec;
+        for(int i=0;i<vertNum;++i)
+          if(selected[i]) selVec.push_back(i);
+        if(selVec.empty()) break;
+        if(m.vn - int(selVec.size()) < pp.TargetVertexNum)
+        { // do not overshoot the target: keep only the shortest collapses
+          std::sort(selVec.begin(),selVec.end(),[&](int a, int b){ return CandLess(candCost[a],a,candCost[b],b); });
+          selVec.resize(m.vn - pp.TargetVertexNum);
+        }
+
+        // 3) Perform the selected collapses concurrently
+        int delTetraNum=0;
+#pragma omp parallel
+        {
+          std::vector<TetraPointer> star;
+          std::vector<int> ind;
+#pragma omp for schedule(dynamic, 256) reduction(+: delTetraNum)
+          for(int k=0;k<int(selVec.size());++k)
+          {
+            VertexPointer v = &m.vert[selVec[k]];
+            VTStarVT<TetraType>(v,star,ind);
+            delTetraNum += DoCollapse(v,&m.vert[candU[selVec[k]]],star,ind,false);
+          }
+        }
+        m.tn -= delTetraNum;
+        m.vn -= int(selVec.size());
+        collapseNum += int(selVec.size());
+      }
+      tri::UpdateTopology<TetraMesh>::VertexTetra(m);
+      tri::UpdateTopology<TetraMesh>::TetraTetra(m);
+      return collapseNum;
+    }
+
+private:
+    struct Candidate
+    {
+      ScalarType cost;
+      int v,u,mark;
+      // std::priority_queue keeps the largest on top: invert to pop the shortest one
+      bool operator < (const Candidate &c) const { return CandLess(c.cost,c.v,cost,v); }
+    };
+
+    static bool CandLess(ScalarType c0, int i0, ScalarType c1, int i1)
+    {
+      return (c0<c1) || (c0==c1 && i0<i1);
+    }
+
+    static void PushCandidate(TetraMesh &m, VertexPointer v, const std::vector<int> &mark, std::priority_queue<Candidate> &heap, const Param &pp,
+                              std::vector<TetraPointer> &star, std::vector<int> &ind, std::vector<VertexPointer> &ring)
+    {
+      Candidate c;
+      VertexPointer u = BestCollapse(v,c.cost,pp,star,ind,ring);
+      if(!u) return;
+      c.v = int(tri::Index(m,v));
+      c.u = int(tri::Index(m,u));
+      c.mark = mark[c.v];
+      heap.push(c);
+    }
+
+    // Remove the tetra t (as seen from its i-th vertex) from the VT list of that vertex
+    static void VTDetach(TetraType *t, int i)
+    {
+      VertexPointer w = t->V(i);
+      if(w->VTp()==t && w->VTi()==i)
+      {
+        w->VTp() = t->VTp(i);
+        w->VTi() = t->VTi(i);
+        return;
+      }
+      TetraType *pt = w->VTp();
+      int pi = w->VTi();
+      while(pt)
+      {
+        TetraType *nt = pt->VTp(pi);
+        const int ni = pt->VTi(pi);
+        if(nt==t && ni==i)
+        {
+          pt->VTp(pi) = t->VTp(i);
+          pt->VTi(pi) = t->VTi(i);
+          return;
+        }
+        pt = nt;
+        pi = ni;
+      }
+      assert(0);
+    }
 };
 
 }
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -93,13 +93,20 @@ public:
     vcg::tri::UpdateNormal<MeshType>::PerVertexAngleWeighted(m);
     vcg::tri::UpdateNormal<MeshType>::NormalizePerVertex(m);
 
-    for (VertexIterator vi =m.vert.begin(); vi !=m.vert.end(); ++vi) {
+    // each vertex is processed independently, with per thread scratch buffers
+#pragma omp parallel
+    {
+    std::vector<float> weights;
+    std::vector<AdjVertex> vertices;
+#pragma omp for schedule(dynamic, 256)
+    for (int vInd = 0; vInd < int(m.vert.size()); ++vInd) {
+      VertexIterator vi = m.vert.begin() + vInd;
       if ( ! (*vi).IsD() && (*vi).VFp() != NULL) {
 
         VertexType * central_vertex = &(*vi);
 
-        std::vector<float> weights;
-        std::vector<AdjVertex> vertices;
+        weights.clear();
+        vertices.clear();
 
         vcg::face::JumpingPos<FaceType> pos((*vi).VFp(), central_vertex);
 
@@ -252,6 +259,7 @@ public:
         (*vi).K2() =  Principal_Curvature2;
       }
     }
+    } // end omp parallel
   }
 
 
@@ -275,13 +283,9 @@ If pointVSfaceInt==false the covariance is computed by (analytic)integration ove
 
   static void PrincipalDirectionsPCA(MeshType &m, ScalarType r, bool pointVSfaceInt = true,vcg::CallBackPos * cb = NULL)
   {
-    std::vector<VertexType*> closests;
-    std::vector<ScalarType> distances;
-    std::vector<CoordType> points;
     VertexIterator vi;
-    ScalarType area;
+    ScalarType area = 0;
     MeshType tmpM;
-    typename std::vector<CoordType>::iterator ii;
     vcg::tri::TrivialSampler<MeshType> vs;
     tri::UpdateNormal<MeshType>::PerVertexAngleWeighted(m);
     tri::UpdateNormal<MeshType>::NormalizePerVertex(m);
@@ -303,37 +307,72 @@ If pointVSfaceInt==false the covariance is computed by (analytic)integration ove
       mGrid.Set(m.face.begin(),m.face.end());
     }
 
-    int jj = 0;
-    for(vi  = m.vert.begin(); vi != m.vert.end(); ++vi)
+    // The vertices are independent and are processed in parallel, in batches of vertices sorted by grid cell,
+    // so that the neighbourhood queries of each thread visit the same cells.
+    // The queries do not use the marks of the mesh, and every thread has its own scratch buffers.
+    const int vn = int(m.vert.size());
+    std::vector<std::pair<long long,int> > order(vn);
+    for(int i=0;i<vn;++i)
     {
-      vcg::Matrix33<ScalarType> A, eigenvectors;
-      vcg::Point3<ScalarType> bp, eigenvalues;
-//      int nrot;
+      Point3i ip;
+      if(pointVSfaceInt) pGrid.PToIP(m.vert[i].cP(),ip);
+      else               mGrid.PToIP(m.vert[i].cP(),ip);
+      const Point3i &siz = pointVSfaceInt ? pGrid.siz : mGrid.siz;
+      order[i] = std::make_pair((long long)(ip[2]*siz[1]+ip[1])*siz[0]+ip[0], i);
+    }
+    std::sort(order.begin(),order.end());
 
-      // sample the neighborhood
-      if(pointVSfaceInt)
+    const int batchSize = 1<<14;
+    for(int b0=0; b0<vn; b0+=batchSize)
+    {
+      if (cb) (*cb)(int(100.0f * (float)b0 / (float)vn),"Vertices Analysis");
+      const int b1 = std::min(vn, b0+batchSize);
+#pragma omp parallel
       {
-        vcg::tri::GetInSphereVertex<
-            MeshType,
-            PointsGridType,std::vector<VertexType*>,
-            std::vector<ScalarType>,
-            std::vector<CoordType> >(tmpM,pGrid,  (*vi).cP(),r ,closests,distances,points);
-
-        A.Covariance(points,bp);
-        A*=area*area/1000;
-      }
-      else{
-        IntersectionBallMesh<MeshType,ScalarType>( m ,vcg::Sphere3<ScalarType>((*vi).cP(),r),tmpM );
-        vcg::Point3<ScalarType> _bary;
-        vcg::tri::Inertia<MeshType>::Covariance(tmpM,_bary,A);
-      }
+        std::vector<VertexType*> closests;
+        std::vector<FaceType*> closestsF;
+        std::vector<ScalarType> distances;
+        std::vector<CoordType> points;
+        MeshType ballM;
+#pragma omp for schedule(dynamic, 64)
+        for(int k=b0; k<b1; ++k)
+        {
+          VertexType &v = m.vert[order[k].second];
+          vcg::Matrix33<ScalarType> A;
+          vcg::Point3<ScalarType> bp;
 
-//      Eigen::Matrix3f AA; AA=A;
-//      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> eig(AA);
-//      Eigen::Vector3f c_val = eig.eigenvalues();
-//      Eigen::Matrix3f c_vec = eig.eigenvectors();
+          // sample the neighborhood
+          if(pointVSfaceInt)
+          {
+            vcg::tri::GetInSphereVertex<
+                MeshType,
+                PointsGridType,std::vector<VertexType*>,
+                std::vector<ScalarType>,
+                std::vector<CoordType> >(tmpM,pGrid,  v.cP(),r ,closests,distances,points);
+
+            A.Covariance(points,bp);
+            A*=area*area/1000;
+          }
+          else{
+            // faces spanning more cells are returned more times, the duplicates are removed by IntersectionBallMesh
+            vcg::face::PointDistanceBaseFunctor<ScalarType> fDist;
+            vcg::tri::EmptyTMark<MeshType> noMark;
+            mGrid.GetInSphere(fDist,noMark,v.cP(),r,closestsF,distances,points);
+            IntersectionBallMesh<MeshType,ScalarType>(closestsF, vcg::Sphere3<ScalarType>(v.cP(),r), ballM);
+            vcg::tri::Inertia<MeshType>::Covariance(ballM,bp,A);
+          }
+          PrincipalDirectionsFromCovariance(v, A, r);
+        }
+      }
+    }
+  }
 
-//      Jacobi(A,  eigenvalues , eigenvectors, nrot);
+private:
+  /// Curvature of the PCA method from the covariance A of the neighbourhood of radius r of the vertex v.
+  static void PrincipalDirectionsFromCovariance(VertexType &v, const vcg::Matrix33<ScalarType> &A, ScalarType r)
+  {
+      vcg::Matrix33<ScalarType> eigenvectors;
+      vcg::Point3<ScalarType> eigenvalues;
 
       Eigen::Matrix3d AA;
       A.ToEigenMatrix(AA);
@@ -342,49 +381,41 @@ If pointVSfaceInt==false the covariance is computed by (analytic)integration ove
       Eigen::Matrix3d c_vec = eig.eigenvectors(); // eigenvector are stored as columns.
       eigenvectors.FromEigenMatrix(c_vec);
       eigenvalues.FromEigenVector(c_val);
-//	  EV.transposeInPlace();
-//	  ev.FromEigenVector(c_val);
 
       // get the estimate of curvatures from eigenvalues and eigenvectors
       // find the 2 most tangent eigenvectors (by finding the one closest to the normal)
-      int best = 0; ScalarType bestv = fabs( (*vi).cN().dot(eigenvectors.GetColumn(0).normalized()) );
+      int best = 0; ScalarType bestv = fabs( v.cN().dot(eigenvectors.GetColumn(0).normalized()) );
       for(int i  = 1 ; i < 3; ++i){
-        ScalarType prod = fabs((*vi).cN().dot(eigenvectors.GetColumn(i).normalized()));
+        ScalarType prod = fabs(v.cN().dot(eigenvectors.GetColumn(i).normalized()));
         if( prod > bestv){bestv = prod; best = i;}
       }
 
-      (*vi).PD1().Import(eigenvectors.GetColumn( (best+1)%3).normalized());
-      (*vi).PD2().Import(eigenvectors.GetColumn( (best+2)%3).normalized());
+      v.PD1().Import(eigenvectors.GetColumn( (best+1)%3).normalized());
+      v.PD2().Import(eigenvectors.GetColumn( (best+2)%3).normalized());
 
       // project them to the plane identified by the normal
       vcg::Matrix33<CurScalarType> rot;
-      CurVecType NN = CurVecType::Construct((*vi).N());
+      CurVecType NN = CurVecType::Construct(v.N());
       CurScalarType angle;
-      angle = acos((*vi).PD1().dot(NN));
-      rot.SetRotateRad(  - (M_PI*0.5 - angle),(*vi).PD1()^NN);
-      (*vi).PD1() = rot*(*vi).PD1();
-      angle = acos((*vi).PD2().dot(NN));
-      rot.SetRotateRad(  - (M_PI*0.5 - angle),(*vi).PD2()^NN);
-      (*vi).PD2() = rot*(*vi).PD2();
+      angle = acos(v.PD1().dot(NN));
+      rot.SetRotateRad(  - (M_PI*0.5 - angle),v.PD1()^NN);
+      v.PD1() = rot*v.PD1();
+      angle = acos(v.PD2().dot(NN));
+      rot.SetRotateRad(  - (M_PI*0.5 - angle),v.PD2()^NN);
+      v.PD2() = rot*v.PD2();
 
 
       // copmutes the curvature values
       const ScalarType r5 = r*r*r*r*r;
       const ScalarType r6 = r*r5;
-      (*vi).K1() = (2.0/5.0) * (4.0*M_PI*r5 + 15*eigenvalues[(best+2)%3]-45.0*eigenvalues[(best+1)%3])/(M_PI*r6);
-      (*vi).K2() = (2.0/5.0) * (4.0*M_PI*r5 + 15*eigenvalues[(best+1)%3]-45.0*eigenvalues[(best+2)%3])/(M_PI*r6);
-      if((*vi).K1() < (*vi).K2())	{	std::swap((*vi).K1(),(*vi).K2());
-        std::swap((*vi).PD1(),(*vi).PD2());
-        if (cb)
-        {
-          (*cb)(int(100.0f * (float)jj / (float)m.vn),"Vertices Analysis");
-          ++jj;
-        }													}
-    }
-
-
+      v.K1() = (2.0/5.0) * (4.0*M_PI*r5 + 15*eigenvalues[(best+2)%3]-45.0*eigenvalues[(best+1)%3])/(M_PI*r6);
+      v.K2() = (2.0/5.0) * (4.0*M_PI*r5 + 15*eigenvalues[(best+1)%3]-45.0*eigenvalues[(best+2)%3])/(M_PI*r6);
+      if(v.K1() < v.K2())	{	std::swap(v.K1(),v.K2());
+        std::swap(v.PD1(),v.PD2());
+      }
   }
 
+public:
 /// \brief Computes the discrete mean gaussian curvature.
 /**
 The algorithm used is the one Desbrun et al. that is based on a discrete analysis of the angles of the faces around a vertex.
@@ -595,8 +626,9 @@ static void MeanAndGaussian(MeshType & m)
     {
       tri::RequireVFAdjacency(m);
 
-      for(VertexIterator vi = m.vert.begin(); vi != m.vert.end(); ++vi)
-        ComputeSingleVertexCurvature(&*vi,false);
+#pragma omp parallel for schedule(dynamic, 256)
+      for(int i = 0; i < int(m.vert.size()); ++i)
+        ComputeSingleVertexCurvature(&m.vert[i],false);
     }
 
 
@@ -615,9 +647,11 @@ static void MeanAndGaussian(MeshType & m)
       tri::RequireVFAdjacency(m);
       tri::RequireFFAdjacency(m);
 
-        typename MeshType::VertexIterator vi;
-
-        for(vi = m.vert.begin(); vi != m.vert.end(); ++vi)
+        // each vertex is processed independently
+#pragma omp parallel for schedule(dynamic, 256)
+        for(int vInd = 0; vInd < int(m.vert.size()); ++vInd)
+        {
+        typename MeshType::VertexIterator vi = m.vert.begin() + vInd;
         if(!((*vi).IsD())){
             vcg::Matrix33<ScalarType> m33;m33.SetZero();
             face::JumpingPos<typename MeshType::FaceType> p((*vi).VFp(),&(*vi));
@@ -683,6 +717,7 @@ static void MeanAndGaussian(MeshType & m)
             (*vi).K1() = lambda[2];
             (*vi).K2() = lambda[1];
         }
+        }
     }
 
     static void PerVertexBasicRadialCrossField(MeshType &m, float anisotropyRatio = 1.0 )
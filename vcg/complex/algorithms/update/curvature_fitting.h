@@ -38,6 +38,8 @@
 #include <vcg/complex/algorithms/inertia.h>
 #include <vcg/complex/algorithms/nring.h>
 
+#include <unordered_set>
+
 #include <Eigen/Core>
 #include <Eigen/QR>
 #include <Eigen/LU>
@@ -235,9 +237,12 @@ class Quadric
         vcg::tri::UpdateNormal<MeshType>::NormalizePerVertex(m);
 
 
-        VertexIterator vi;
-        for(vi = m.vert.begin(); vi!=m.vert.end(); ++vi )
+        // each vertex writes only its own normal and curvature and reads only
+        // the positions of its neighbours, so the loop can be split freely.
+#pragma omp parallel for schedule(dynamic, 256)
+        for(int vInd = 0; vInd < int(m.vert.size()); ++vInd)
         {
+            VertexIterator vi = m.vert.begin() + vInd;
             std::vector<CoordType> ref = computeReferenceFrames(&*vi);
 
             Quadric q = fitQuadric(&*vi,ref);
@@ -387,29 +392,23 @@ class Quadric
                 A(c,3) = u;
                 A(c,4) = v;
 
-                b[c] = n;
+                b(c,0) = n;
             }
 
 
-            static int count = 0, index = 0;
             double min = 0.000000000001; //1.0e-12
-            /*
-            if (!count)
-                printf("GNE %e\n", min);
-             */
 
             if (detCheck && ((A.transpose()*A).determinant() < min && (A.transpose()*A).determinant() > -min))
             {
                 //A.svd().solve(b, &sol); A.svd().solve(b, &sol);
                 //cout << sol << endl;
-                printf("Quadric: unsolvable vertex %d %d\n", count, ++index);
+                printf("Quadric: unsolvable vertex\n");
                 //return Quadric (1, 1, 1, 1, 1);
 //                A.svd().solve(b, &sol);
                 Eigen::JacobiSVD<Eigen::MatrixXd> svd(A);
                 sol=svd.solve(b);
-                return QuadricLocal(sol[0],sol[1],sol[2],sol[3],sol[4]);
+                return QuadricLocal(sol(0,0),sol(1,0),sol(2,0),sol(3,0),sol(4,0));
             }
-            count++;
 
             //for (int i = 0; i < 100; i++)
             {
@@ -424,27 +423,77 @@ class Quadric
 
             }
 
-            return QuadricLocal(sol[0],sol[1],sol[2],sol[3],sol[4]);
+            return QuadricLocal(sol(0,0),sol(1,0),sol(2,0),sol(3,0),sol(4,0));
+        }
+    };
+
+    /// Same ring walk of Nring, but visited elements are kept in a local set
+    /// instead of the V flags, so that many threads can walk the same mesh.
+    class LocalRing
+    {
+    public:
+    std::vector<VertexType*> allV;
+    std::vector<VertexType*> lastV;
+    std::unordered_set<const void *> visited;
+
+    LocalRing(VertexType *v) { insert(v); }
+
+    void insert(VertexType *v)
+    {
+        if (visited.insert(v).second)
+        {
+        allV.push_back(v);
+        lastV.push_back(v);
+        }
+    }
+
+    void insert(FaceType *f)
+    {
+        if (visited.insert(f).second)
+        {
+        insert(f->V(0));
+        insert(f->V(1));
+        insert(f->V(2));
         }
+    }
+
+    void insert1Ring(VertexType *v)
+    {
+        insert(v);
+        face::Pos<FaceType> p(v->VFp(),v);
+        face::Pos<FaceType> ori = p;
+        do
+        {
+        insert(p.F());
+        p.FlipF();
+        p.FlipE();
+        } while (ori != p);
+    }
+
+    void expand()
+    {
+        std::vector<VertexType*> lastVtemp;
+        lastVtemp.swap(lastV);
+        for (size_t i = 0; i < lastVtemp.size(); ++i)
+        insert1Ring(lastVtemp[i]);
+    }
     };
 
-    static void expandMaxLocal (MeshType & mesh, VertexType *v, int max, std::vector<VertexType*> *vv)
+    static void expandMaxLocal (MeshType & /*mesh*/, VertexType *v, int max, std::vector<VertexType*> *vv)
     {
-    Nring<MeshType> rw = Nring<MeshType> (v, &mesh);
+    LocalRing rw(v);
     do rw.expand (); while (rw.allV.size() < max+1);
     if (rw.allV[0] != v)
         printf ("rw.allV[0] != *v\n");
     vv->reserve ((size_t)max);
     for (int i = 1; i < max+1; i++)
         vv->push_back(rw.allV[i]);
-
-    rw.clear();
     }
 
 
     static void expandSphereLocal (MeshType & mesh, VertexType *v, float r, int min, std::vector<VertexType*> *vv)
     {
-    Nring<MeshType> rw = Nring<MeshType> (v, &mesh);
+    LocalRing rw(v);
 
     bool isInside = true;
     while (isInside)
@@ -466,7 +515,6 @@ class Quadric
         }
     }
     //printf ("%d\n", vv->size());
-    rw.clear();
 
     if (vv->size() < min)
     {
@@ -548,7 +596,8 @@ class Quadric
     }
 
 
-    static void finalEigenStuff (VertexType *v, std::vector<CoordType> ref, QuadricLocal q)
+    /// If newN is given the fitted normal is stored there instead of in v->N().
+    static void finalEigenStuff (VertexType *v, std::vector<CoordType> ref, QuadricLocal q, CoordType *newN = 0)
     {
     double a = q.a();
     double b = q.b();
@@ -562,7 +611,9 @@ class Quadric
 
     CoordType n = CoordType(-d,-e,1.0).Normalize();
 
-    v->N() = ref[0] * n[0] + ref[1] * n[1] + ref[2] * n[2];
+    CoordType fitN = ref[0] * n[0] + ref[1] * n[1] + ref[2] * n[2];
+    if (newN) *newN = fitN;
+    else v->N() = fitN;
 
     double L = 2.0 * a * n.Z();
     double M = b * n.Z();
@@ -580,12 +631,12 @@ class Quadric
     c_val = -c_val;
 
     CoordType v1, v2;
-    v1[0] = c_vec[0];
-    v1[1] = c_vec[1];
+    v1[0] = c_vec(0,0);
+    v1[1] = c_vec(1,0);
     v1[2] = d * v1[0] + e * v1[1];
 
-    v2[0] = c_vec[2];
-    v2[1] = c_vec[3];
+    v2[0] = c_vec(0,1);
+    v2[1] = c_vec(1,1);
     v2[2] = d * v2[0] + e * v2[1];
 
     v1 = v1.Normalize();
@@ -625,10 +676,14 @@ class Quadric
     bool projectionPlaneCheck = true;
     int vertexesPerFit = 0;
 
-    int i = 0;
-    VertexIterator vi;
-    for(vi = mesh.vert.begin(); vi != mesh.vert.end(); ++vi, i++)
+    // The fitted normals are written back only at the end, so every vertex
+    // sees the input normals of its neighbours whatever the visiting order.
+    std::vector<CoordType> fittedN(mesh.vert.size());
+
+#pragma omp parallel for schedule(dynamic, 64) reduction(+: vertexesPerFit)
+    for(int i = 0; i < int(mesh.vert.size()); ++i)
     {
+        VertexIterator vi = mesh.vert.begin() + i;
         std::vector<VertexType*> vv;
         std::vector<VertexType*> vvtmp;
 
@@ -690,10 +745,13 @@ class Quadric
         QuadricLocal q;
         fitQuadricLocal (&*vi, ref, vv, &q);
 
-        finalEigenStuff (&*vi, ref, q);
+        finalEigenStuff (&*vi, ref, q, &fittedN[i]);
 
     }
 
+    for(size_t i = 0; i < mesh.vert.size(); ++i)
+        mesh.vert[i].N() = fittedN[i];
+
     //if (verbose)
         //printf ("average vertex num in each fit: %f, total %d, vn %d\n", ((float) vertexesPerFit) / mesh.vn, vertexesPerFit, mesh.vn);
     if (verbose)
@@ -220,38 +220,40 @@ public:
         RequireVFAdjacency(m);
 
         FaceClearB(m);
-        int visitedBit=VertexType::NewBitFlag();
 
         // Calcolo dei bordi
         // per ogni vertice vi si cercano i vertici adiacenti che sono toccati da una faccia sola
         // (o meglio da un numero dispari di facce)
+        // The parity is counted on a local sorted list instead of a user bit, so that different meshes
+        // can be processed concurrently (the allocation of the user bits is not thread safe).
 
         const int BORDERFLAG[3]={FaceType::BORDER0, FaceType::BORDER1, FaceType::BORDER2};
+        std::vector<VertexPointer> adj;
 
         for(VertexIterator vi=m.vert.begin();vi!=m.vert.end();++vi)
             if(!(*vi).IsD())
             {
+                adj.clear();
                 for(face::VFIterator<FaceType> vfi(&*vi) ; !vfi.End(); ++vfi )
                 {
-                    vfi.f->V1(vfi.z)->ClearUserBit(visitedBit);
-                    vfi.f->V2(vfi.z)->ClearUserBit(visitedBit);
+                    adj.push_back(vfi.f->V1(vfi.z));
+                    adj.push_back(vfi.f->V2(vfi.z));
                 }
+                std::sort(adj.begin(),adj.end());
                 for(face::VFIterator<FaceType> vfi(&*vi) ; !vfi.End(); ++vfi )
                 {
-                    if(vfi.f->V1(vfi.z)->IsUserBit(visitedBit))  vfi.f->V1(vfi.z)->ClearUserBit(visitedBit);
-                    else vfi.f->V1(vfi.z)->SetUserBit(visitedBit);
-                    if(vfi.f->V2(vfi.z)->IsUserBit(visitedBit))  vfi.f->V2(vfi.z)->ClearUserBit(visitedBit);
-                    else vfi.f->V2(vfi.z)->SetUserBit(visitedBit);
-                }
-                for(face::VFIterator<FaceType> vfi(&*vi) ; !vfi.End(); ++vfi )
-                {
-                    if(vfi.f->V(vfi.z)< vfi.f->V1(vfi.z)  &&  vfi.f->V1(vfi.z)->IsUserBit(visitedBit))
+                    if(vfi.f->V(vfi.z)< vfi.f->V1(vfi.z)  &&  OddCount(adj,vfi.f->V1(vfi.z)))
                         vfi.f->Flags() |= BORDERFLAG[vfi.z];
-                    if(vfi.f->V(vfi.z)< vfi.f->V2(vfi.z)  &&  vfi.f->V2(vfi.z)->IsUserBit(visitedBit))
+                    if(vfi.f->V(vfi.z)< vfi.f->V2(vfi.z)  &&  OddCount(adj,vfi.f->V2(vfi.z)))
                         vfi.f->Flags() |= BORDERFLAG[(vfi.z+2)%3];
                 }
             }
-        VertexType::DeleteBitFlag(visitedBit);
+    }
+
+    /// true if v appears an odd number of times in the sorted vector adj
+    static bool OddCount(const std::vector<VertexPointer> &adj, VertexPointer v)
+    {
+        return ((std::upper_bound(adj.begin(),adj.end(),v) - std::lower_bound(adj.begin(),adj.end(),v)) & 1) != 0;
     }
 
 
@@ -160,6 +160,121 @@ static void PerVertexNelsonMaxWeighted(ComputeMeshType &m)
    }
 }
 
+/// \brief Compressed (CSR) vertex-face index used by the parallel per-vertex normal computations.
+/**
+ For each vertex vi, the corners of the non-deleted faces incident on it are stored in
+ face[vertStart[vi]] ... face[vertStart[vi+1]-1] (and the same range of corner), in the order of the faces.
+ It depends only on the connectivity: build it once and reuse it as long as the faces do not change
+ (e.g. when the normals are recomputed after each step of a deformation).
+ */
+class VertexFaceIndex
+{
+public:
+  std::vector<size_t> vertStart;   // per vertex, first entry (size vert.size()+1)
+  std::vector<size_t> face;        // per entry, index of the face
+  std::vector<int>    corner;      // per entry, corner of the face
+
+  void Build(ComputeMeshType &m)
+  {
+    vertStart.assign(m.vert.size()+1, 0);
+    for(size_t i=0;i<m.face.size();++i)
+    {
+      const FaceType &f=m.face[i];
+      if(f.IsD()) continue;
+      for(int j=0;j<f.VN();++j)
+        ++vertStart[tri::Index(m,f.cV(j))+1];
+    }
+    for(size_t i=0;i<m.vert.size();++i)
+      vertStart[i+1]+=vertStart[i];
+    face.resize(vertStart.back());
+    corner.resize(vertStart.back());
+    std::vector<size_t> cursor(vertStart.begin(),vertStart.end()-1);
+    for(size_t i=0;i<m.face.size();++i)
+      if(!m.face[i].IsD())
+        for(int j=0;j<m.face[i].VN();++j)
+        {
+          const size_t k = cursor[tri::Index(m,m.face[i].cV(j))]++;
+          face[k]=i;
+          corner[k]=j;
+        }
+  }
+
+  bool IsValid(const ComputeMeshType &m) const
+  {
+    return vertStart.size()==m.vert.size()+1 && (face.empty() || face.back()<m.face.size());
+  }
+};
+
+/// \brief Parallel gather of per-wedge normal contributions into the vertex normals.
+/**
+ wedgeFunc(f, j) returns the contribution of the face f to the normal of its vertex j.
+ Each non-deleted writable vertex with incident faces sums, in parallel, the contributions of its readable
+ faces in the order of the faces: this is exactly the order of the serial scatter, so the result is bitwise
+ identical to it (and does not depend on the number of threads).
+ Vertices without incident faces keep their normal.
+ */
+template <class WedgeNormalFunctor>
+static void PerVertexGather(ComputeMeshType &m, const VertexFaceIndex &vfi, WedgeNormalFunctor wedgeFunc)
+{
+  RequirePerVertexNormal(m);
+  assert(vfi.IsValid(m));
+#pragma omp parallel for schedule(static)
+  for(int i=0;i<int(m.vert.size());++i)
+  {
+    VertexType &v=m.vert[i];
+    if(v.IsD() || !v.IsRW() || vfi.vertStart[i]==vfi.vertStart[i+1]) continue;
+    NormalType n((ScalarType)0,(ScalarType)0,(ScalarType)0);
+    for(size_t k=vfi.vertStart[i];k<vfi.vertStart[i+1];++k)
+    {
+      const FaceType &f=m.face[vfi.face[k]];
+      if(f.IsR())
+        n += wedgeFunc(f, vfi.corner[k]);
+    }
+    v.N()=n;
+  }
+}
+
+///  \brief Multithreaded version of PerVertex(), with the same results. The index must be up to date with the faces.
+static void PerVertexParallel(ComputeMeshType &m, const VertexFaceIndex &vfi)
+{
+  PerVertexGather(m, vfi, [](const FaceType &f, int)
+  {
+    return NormalType(vcg::TriangleNormal(f));
+  });
+}
+
+///  \brief Multithreaded version of PerVertexAngleWeighted(), with the same results. The index must be up to date with the faces.
+static void PerVertexAngleWeightedParallel(ComputeMeshType &m, const VertexFaceIndex &vfi)
+{
+  PerVertexGather(m, vfi, [](const FaceType &f, int j)
+  {
+    NormalType t = TriangleNormal(f).Normalize();
+    NormalType ea = (f.cV1(j)->cP()-f.cV0(j)->cP()).Normalize();             // outgoing edge
+    NormalType eb = (f.cV1((j+2)%3)->cP()-f.cV0((j+2)%3)->cP()).Normalize(); // incoming edge
+    return NormalType(t*AngleN(ea,-eb));
+  });
+}
+
+///  \brief Multithreaded version of PerVertexNelsonMaxWeighted(), with the same results. The index must be up to date with the faces.
+static void PerVertexNelsonMaxWeightedParallel(ComputeMeshType &m, const VertexFaceIndex &vfi)
+{
+  PerVertexGather(m, vfi, [](const FaceType &f, int j)
+  {
+    typename FaceType::NormalType t = TriangleNormal(f);
+    ScalarType ea = SquaredDistance(f.cV0(j)->cP(),f.cV1(j)->cP());
+    ScalarType eb = SquaredDistance(f.cV0((j+2)%3)->cP(),f.cV1((j+2)%3)->cP());
+    return NormalType(t/(ea*eb));
+  });
+}
+
+/// \brief Multithreaded versions that build the vertex-face index on the fly.
+static void PerVertexParallel(ComputeMeshType &m)
+{ VertexFaceIndex vfi; vfi.Build(m); PerVertexParallel(m,vfi); }
+static void PerVertexAngleWeightedParallel(ComputeMeshType &m)
+{ VertexFaceIndex vfi; vfi.Build(m); PerVertexAngleWeightedParallel(m,vfi); }
+static void PerVertexNelsonMaxWeightedParallel(ComputeMeshType &m)
+{ VertexFaceIndex vfi; vfi.Build(m); PerVertexNelsonMaxWeightedParallel(m,vfi); }
+
 /// \brief Calculates the face normal
 ///
 /// Not normalized. Use PerFaceNormalized() or call NormalizePerVertex() if you need unit length per face normals.
@@ -26,6 +26,8 @@
 
 #include <unordered_map>
 #include <vector>
+#include <atomic>
+#include <algorithm>
 #include <assert.h>
 
 namespace vcg
@@ -112,7 +114,7 @@ namespace vcg
       assert(xPos!=inserted_objects.end() && yPos!=inserted_objects.end());
       DisjointSetNode *xNode = &nodes[xPos->second];
       DisjointSetNode *yNode = &nodes[yPos->second];
-      if (xNode->rank>yNode->rank)
+      if (xNode->rank<yNode->rank)
         xNode->parent = y;
       else
       {
@@ -125,6 +127,96 @@ namespace vcg
   protected:
     std::vector< DisjointSetNode >				nodes;
   };
+
+  /*!
+  * Disjoint-set over the contiguous indexes [0,n) that can be updated concurrently by many threads without locks.
+  * Each element stores the index of its parent in an atomic int: Union links the larger of the two roots
+  * under the smaller one with a compare-and-swap (and retries if a root has been linked in the meantime),
+  * FindSet shortens the path while walking it (path halving), again with compare-and-swap.
+  * Since the parents only decrease, the root of each set is its smallest element whatever the order of the
+  * unions, so the result does not depend on the number of threads.
+  */
+  class ConcurrentDisjointSet
+  {
+  public:
+    ConcurrentDisjointSet(int n=0) { Init(n); }
+
+    /*!
+    * Makes n singletons; not thread-safe.
+    */
+    void Init(int n)
+    {
+      std::vector< std::atomic<int> > tmp(n);
+      parent.swap(tmp);
+#pragma omp parallel for schedule(static)
+      for (int i=0; i<n; ++i)
+        parent[i].store(i, std::memory_order_relaxed);
+    }
+
+    int Size() const { return int(parent.size()); }
+
+    /*!
+    * The smallest element of the group of x, once all the concurrent unions have been done.
+    */
+    int FindSet(int x)
+    {
+      assert(x>=0 && x<Size());
+      for (;;)
+      {
+        int p = parent[x].load(std::memory_order_relaxed);
+        if (p==x) return x;
+        int gp = parent[p].load(std::memory_order_relaxed);
+        if (gp!=p)
+          parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+        x = gp;
+      }
+    }
+
+    /*!
+    * Merges the groups of x and y; returns false if they were already the same group.
+    */
+    bool Union(int x, int y)
+    {
+      for (;;)
+      {
+        x = FindSet(x);
+        y = FindSet(y);
+        if (x==y) return false;
+        if (x<y) std::swap(x,y);
+        int expected = x;
+        if (parent[x].compare_exchange_strong(expected, y))
+          return true;
+      }
+    }
+
+    bool SameSet(int x, int y) { return FindSet(x)==FindSet(y); }
+
+    /*!
+    * Numbers the groups from 0, in the order of their smallest element, and fills label with the group of each element;
+    * the elements with skip[i] set (if given, they must be singletons) get -1 and are not counted. Returns the number of groups.
+    * It must be called after all the unions.
+    */
+    int Labels(std::vector<int> &label, const std::vector<char> *skip=0)
+    {
+      const int n = Size();
+      label.resize(n);
+#pragma omp parallel for schedule(static)
+      for (int i=0; i<n; ++i)
+        label[i] = FindSet(i);
+      int groupNum = 0;
+      std::vector<int> rootLabel(n, -1);
+      for (int i=0; i<n; ++i)
+        if (label[i]==i && !(skip && (*skip)[i]))
+          rootLabel[i] = groupNum++;
+#pragma omp parallel for schedule(static)
+      for (int i=0; i<n; ++i)
+        label[i] = (skip && (*skip)[i]) ? -1 : rootLabel[label[i]];
+      return groupNum;
+    }
+
+  private:
+    std::vector< std::atomic<int> > parent;
+  };
 };// end of namespace vcg
 
 #endif //VCG_MATH_UNIONSET_H
@@ -178,6 +178,13 @@ public:
      */
   void Add(ScalarType v, ScalarType increment=ScalarType(1.0));
 
+  /**
+     * Add all the values of another histogram, that must have the same bins.
+     *
+     * Useful to merge the histograms filled by different threads.
+     */
+  void Merge(const Histogram<ScalarType> &h);
+
   ScalarType MaxCount() const;        //! Max number of elements among all buckets (including the two infinity bounded buckets)
   ScalarType MaxCountInRange() const; //! Max number of elements among all buckets between MinV and MaxV.
   int BinNum() const {return n;}
@@ -317,6 +324,19 @@ void Histogram<ScalarType>::Add(ScalarType v, ScalarType increment)
   rms += (v*v)*increment;
 }
 
+template <class ScalarType>
+void Histogram<ScalarType>::Merge(const Histogram<ScalarType> &h)
+{
+  assert(h.n==n && h.R==R);
+  for(size_t i=0;i<H.size();++i)
+    H[i]+=h.H[i];
+  if(h.minElem<minElem) minElem=h.minElem;
+  if(h.maxElem>maxElem) maxElem=h.maxElem;
+  cnt+=h.cnt;
+  sum+=h.sum;
+  rms+=h.rms;
+}
+
 template <class ScalarType>
 ScalarType Histogram<ScalarType>::BinCount(ScalarType v)
 {
@@ -0,0 +1,109 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef __VCGLIB_QUADRIC_SIMD
+#define __VCGLIB_QUADRIC_SIMD
+
+#include <cstddef>
+#include <vcg/math/quadric.h>
+
+#if !defined(VCG_NO_SIMD)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VCG_QUADRIC_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VCG_QUADRIC_SSE2
+#endif
+#endif
+
+namespace vcg {
+namespace math {
+
+/*
+ * A double precision quadric with a packed layout, used to accumulate the plane
+ * quadrics of the vertices when the quadric simplification is initialized.
+ * The ten coefficients of a Quadric<double> (a11 a12 a13 a22 a23 a33 b1 b2 b3 c)
+ * are stored contiguously and padded to twelve doubles, so that a sum maps to
+ * three AVX (or six SSE2) additions.
+ * When no SIMD instruction set is available (or VCG_NO_SIMD is defined)
+ * a plain scalar path is used.
+ *
+ * ByPlane and += give exactly the same results of the corresponding Quadric<double> methods.
+ */
+class QuadricSIMD
+{
+public:
+  typedef double ScalarType;
+  enum { PackedSize = 12 };
+
+  ScalarType q[PackedSize]; // a11 a12 a13 a22 a23 a33 b1 b2 b3 c 0 0
+
+  inline QuadricSIMD() { SetZero(); }
+
+  void SetZero()
+  {
+    for(int i=0;i<PackedSize;++i) q[i]=0;
+  }
+
+  void Export(Quadric<double> &qd) const
+  {
+    for(int i=0;i<6;++i) qd.a[i]=q[i];
+    for(int i=0;i<3;++i) qd.b[i]=q[6+i];
+    qd.c=q[9];
+  }
+
+  // Same as Quadric::ByPlane
+  template< class PlaneType >
+  void ByPlane( const PlaneType & p )
+  {
+    const ScalarType n0 = (ScalarType)p.Direction()[0];
+    const ScalarType n1 = (ScalarType)p.Direction()[1];
+    const ScalarType n2 = (ScalarType)p.Direction()[2];
+    const ScalarType off = (ScalarType)p.Offset();
+    q[0] = n0*n0; q[1] = n1*n0; q[2] = n2*n0;
+    q[3] = n1*n1; q[4] = n2*n1; q[5] = n2*n2;
+    q[6] = (ScalarType)(-2.0)*off*n0;
+    q[7] = (ScalarType)(-2.0)*off*n1;
+    q[8] = (ScalarType)(-2.0)*off*n2;
+    q[9] = off*off;
+    q[10] = 0; q[11] = 0;
+  }
+
+  void operator += ( const QuadricSIMD & o )
+  {
+#if defined(VCG_QUADRIC_AVX)
+    for(int i=0;i<PackedSize;i+=4)
+      _mm256_storeu_pd(q+i, _mm256_add_pd(_mm256_loadu_pd(q+i), _mm256_loadu_pd(o.q+i)));
+#elif defined(VCG_QUADRIC_SSE2)
+    for(int i=0;i<PackedSize;i+=2)
+      _mm_storeu_pd(q+i, _mm_add_pd(_mm_loadu_pd(q+i), _mm_loadu_pd(o.q+i)));
+#else
+    for(int i=0;i<PackedSize;++i) q[i]+=o.q[i];
+#endif
+  }
+};
+
+} // end namespace math
+} // end namespace vcg
+
+#endif
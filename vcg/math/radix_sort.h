@@ -0,0 +1,90 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef VCG_MATH_RADIX_SORT_H
+#define VCG_MATH_RADIX_SORT_H
+
+#include <vector>
+#include <algorithm>
+
+namespace vcg
+{
+  /*!
+  * Parallel LSD radix sort of (key,value) pairs on their 64 bit unsigned key, one byte for each pass.
+  * The vector is split in chunks that count and scatter their elements concurrently, each into its own
+  * range of every bucket, so the sort is stable (equal keys keep their order) and the result does not depend
+  * on the number of threads. The passes on the bytes that are the same for all the keys are skipped.
+  */
+  template <class ValueType>
+  void RadixSort(std::vector< std::pair<unsigned long long, ValueType> > &v)
+  {
+    typedef std::pair<unsigned long long, ValueType> ElemType;
+    const size_t n = v.size();
+    if (n < 2) return;
+    const int chunkNum = int(std::min<size_t>(256, n/65536 + 1));
+    std::vector<size_t> chunkBegin(chunkNum+1);
+    for (int c=0; c<=chunkNum; ++c)
+      chunkBegin[c] = n*c/chunkNum;
+
+    std::vector<ElemType> tmp(n);
+    std::vector<size_t> offset(size_t(chunkNum)*256);
+    for (int shift=0; shift<64; shift+=8)
+    {
+#pragma omp parallel for schedule(dynamic, 1)
+      for (int c=0; c<chunkNum; ++c)
+      {
+        size_t *cnt = &offset[size_t(c)*256];
+        std::fill(cnt, cnt+256, size_t(0));
+        for (size_t i=chunkBegin[c]; i<chunkBegin[c+1]; ++i)
+          ++cnt[(v[i].first>>shift)&255];
+      }
+
+      // bucket by bucket, the ranges of the chunks in order
+      bool sameDigit = false;
+      size_t sum = 0;
+      for (int d=0; d<256; ++d)
+      {
+        const size_t bucketBegin = sum;
+        for (int c=0; c<chunkNum; ++c)
+        {
+          const size_t cnt = offset[size_t(c)*256+d];
+          offset[size_t(c)*256+d] = sum;
+          sum += cnt;
+        }
+        if (sum-bucketBegin == n) sameDigit = true;
+      }
+      if (sameDigit) continue;
+
+#pragma omp parallel for schedule(dynamic, 1)
+      for (int c=0; c<chunkNum; ++c)
+      {
+        size_t *off = &offset[size_t(c)*256];
+        for (size_t i=chunkBegin[c]; i<chunkBegin[c+1]; ++i)
+          tmp[off[(v[i].first>>shift)&255]++] = v[i];
+      }
+      v.swap(tmp);
+    }
+  }
+} // end namespace vcg
+
+#endif // VCG_MATH_RADIX_SORT_H
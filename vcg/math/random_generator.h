@@ -24,15 +24,23 @@
 #ifndef __VCG_RandomGenerator
 #define __VCG_RandomGenerator
 
+#include <cstddef>
+#include <vector>
 #include <vcg/math/base.h>
 
+#if !defined(VCG_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VCG_PHILOX_SSE2
+#endif
+
 namespace vcg {
 namespace math {
 
 /**
  * Common interface for random generation (with uniform distribution).
  *
- * Two RNGs are available: Subtractive Ring and an improved Marsenne-Twister.
+ * Three RNGs are available: Subtractive Ring, an improved Marsenne-Twister and
+ * the counter-based Philox.
  */
 class RandomGenerator
 {
@@ -414,6 +422,199 @@ public:
 
 }; // end class MarsenneTwisterRNG
 
+/**
+ * Counter-based RNG: Philox4x32-10.
+ *
+ * The n-th block of four 32 bit numbers is a pure function (ten rounds of multiply/xor)
+ * of the counter n and of the key (seed, stream), so the generator can be positioned
+ * anywhere in its sequence in constant time (setCounter, skipAhead) and independent
+ * streams can be given to threads, samples or elements without any sharing.
+ * This makes it suited for parallel code whose results must not depend on the number of threads.
+ * fill() and fill01() generate many numbers at once, four blocks at a time with SSE2 when available;
+ * they give exactly the same sequence of repeated calls of generate().
+ *
+ * Reference:
+ *   J. K. Salmon, M. A. Moraes, R. O. Dror, D. E. Shaw
+ *   "Parallel random numbers: as easy as 1, 2, 3", SC 2011.
+ */
+class PhiloxRNG : public RandomGenerator
+{
+// private data member
+private:
+    unsigned int key[2];           // seed and stream
+    unsigned long long pos;        // index of the next number in the sequence
+    unsigned long long bufBlock;   // block currently stored in buf
+    unsigned int buf[4];
+
+// construction
+public:
+
+    PhiloxRNG(unsigned int seed = 0, unsigned int stream = 0)
+    {
+        key[0] = seed;
+        key[1] = stream;
+        pos = 0;
+        bufBlock = ~0ull;
+    }
+
+    virtual ~PhiloxRNG()
+    {}
+
+// public methods
+public:
+
+    /// (Re-)initialize with the given seed; the stream is kept and the sequence restarts.
+    void initialize(unsigned int seed)
+    {
+        key[0] = seed;
+        pos = 0;
+        bufBlock = ~0ull;
+    }
+
+    /// Select one of the 2^32 independent streams of the current seed; the sequence restarts.
+    void setStream(unsigned int stream)
+    {
+        key[1] = stream;
+        pos = 0;
+        bufBlock = ~0ull;
+    }
+
+    /// Move to the beginning of the given block (each block is made of four numbers).
+    void setCounter(unsigned long long block) { pos = block << 2; }
+
+    /// Skip the next n numbers.
+    void skipAhead(unsigned long long n) { pos += n; }
+
+    /// Compute the block of four numbers of the given counter and key.
+    static void Block(unsigned long long counter, const unsigned int k[2], unsigned int out[4])
+    {
+        unsigned int c0 = (unsigned int)counter, c1 = (unsigned int)(counter >> 32), c2 = 0, c3 = 0;
+        unsigned int k0 = k[0], k1 = k[1];
+        for(int r=0; r<10; ++r)
+        {
+            if(r>0) { k0 += 0x9E3779B9u; k1 += 0xBB67AE85u; }
+            const unsigned long long p0 = (unsigned long long)0xD2511F53u * c0;
+            const unsigned long long p1 = (unsigned long long)0xCD9E8D57u * c2;
+            const unsigned int n0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0;
+            const unsigned int n2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1;
+            c1 = (unsigned int)p1;
+            c3 = (unsigned int)p0;
+            c0 = n0;
+            c2 = n2;
+        }
+        out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+    /// Return a random number in the [0,2^32) interval.
+    unsigned int generate()
+    {
+        const unsigned long long b = pos >> 2;
+        if(b != bufBlock)
+        {
+            Block(b, key, buf);
+            bufBlock = b;
+        }
+        return buf[(pos++) & 3];
+    }
+
+    /// Return a random number in the [0,limit) interval.
+    unsigned int generate(unsigned int limit)
+    {
+        return generate()%limit;
+    }
+
+    /// Returns a random number in the [0,1] real interval.
+    double generate01closed()
+    {
+        return generate()*(1.0/4294967295.0);
+    }
+
+    /// Returns a random number in the [0,1) real interval.
+    double generate01()
+    {
+        return generate()*(1.0/4294967296.0);
+    }
+
+    /// Generates a random number in the (0,1) real interval.
+    double generate01open()
+    {
+        return (((double)generate()) + 0.5)*(1.0/4294967296.0);
+    }
+
+    /// Write the next n numbers in dst.
+    void fill(unsigned int *dst, size_t n)
+    {
+        size_t i = 0;
+        for(; i<n && (pos & 3); ++i)
+            dst[i] = generate();
+        for(; i+16<=n; i+=16, pos+=16)
+            Block4(pos >> 2, key, dst+i);
+        for(; i<n; ++i)
+            dst[i] = generate();
+    }
+
+    /// Write the next n numbers, mapped in the [0,1) real interval, in dst.
+    void fill01(double *dst, size_t n)
+    {
+        unsigned int tmp[256];
+        for(size_t i=0; i<n; i+=256)
+        {
+            const size_t m = (n-i < 256) ? n-i : 256;
+            fill(tmp, m);
+            for(size_t j=0; j<m; ++j)
+                dst[i+j] = tmp[j]*(1.0/4294967296.0);
+        }
+    }
+
+private:
+    /// The four consecutive blocks starting from counter, in sequence order.
+    static void Block4(unsigned long long counter, const unsigned int k[2], unsigned int *out)
+    {
+#if defined(VCG_PHILOX_SSE2)
+        // one lane per block, one register per word
+        __m128i c0 = _mm_setr_epi32(int((unsigned int)counter), int((unsigned int)(counter+1)), int((unsigned int)(counter+2)), int((unsigned int)(counter+3)));
+        __m128i c1 = _mm_setr_epi32(int((unsigned int)(counter>>32)), int((unsigned int)((counter+1)>>32)), int((unsigned int)((counter+2)>>32)), int((unsigned int)((counter+3)>>32)));
+        __m128i c2 = _mm_setzero_si128(), c3 = _mm_setzero_si128();
+        const __m128i m0 = _mm_set1_epi32(int(0xD2511F53u)), m1 = _mm_set1_epi32(int(0xCD9E8D57u));
+        unsigned int k0 = k[0], k1 = k[1];
+        for(int r=0; r<10; ++r)
+        {
+            if(r>0) { k0 += 0x9E3779B9u; k1 += 0xBB67AE85u; }
+            __m128i hi0, lo0, hi1, lo1;
+            MulHiLo(m0, c0, hi0, lo0);
+            MulHiLo(m1, c2, hi1, lo1);
+            c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32(int(k0)));
+            c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32(int(k1)));
+            c1 = lo1;
+            c3 = lo0;
+        }
+        // transpose: block b is made of the b-th lane of c0..c3
+        const __m128i t0 = _mm_unpacklo_epi32(c0, c1), t1 = _mm_unpacklo_epi32(c2, c3);
+        const __m128i t2 = _mm_unpackhi_epi32(c0, c1), t3 = _mm_unpackhi_epi32(c2, c3);
+        _mm_storeu_si128((__m128i *)(out   ), _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *)(out+4 ), _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *)(out+8 ), _mm_unpacklo_epi64(t2, t3));
+        _mm_storeu_si128((__m128i *)(out+12), _mm_unpackhi_epi64(t2, t3));
+#else
+        for(int b=0; b<4; ++b)
+            Block(counter+b, k, out+4*b);
+#endif
+    }
+
+#if defined(VCG_PHILOX_SSE2)
+    /// 32x32->64 bit products of the four lanes of a and m, split in high and low words.
+    static void MulHiLo(const __m128i &m, const __m128i &a, __m128i &hi, __m128i &lo)
+    {
+        const __m128i p02 = _mm_mul_epu32(a, m);                                        // lanes 0 and 2
+        const __m128i p13 = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(m, 32)); // lanes 1 and 3
+        lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(p02, _MM_SHUFFLE(0,0,2,0)), _mm_shuffle_epi32(p13, _MM_SHUFFLE(0,0,2,0)));
+        hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(p02, _MM_SHUFFLE(0,0,3,1)), _mm_shuffle_epi32(p13, _MM_SHUFFLE(0,0,3,1)));
+    }
+#endif
+
+}; // end class PhiloxRNG
+
+
 /* Returns a value with normal distribution with mean m, standard deviation s
  *
  * It implements the Polar form of the Box-Muller Transformation
@@ -446,6 +647,97 @@ inline double box_muller(RandomGenerator &generator, double m, double s) /* norm
   }
   return( m + y1 * s );
 }
+
+/**
+ * Alias table for sampling a discrete distribution in constant time.
+ *
+ * Given n non negative weights w_i, Sample() returns the index i with probability w_i/Sum(w).
+ * The table is built in O(n) with the method of Vose; each sample draws a uniform index
+ * and a uniform real, and picks either that index or its alias.
+ *
+ * M. D. Vose, "A linear algorithm for generating random numbers with a given distribution",
+ * IEEE Transactions on Software Engineering 17(9), 972-975, 1991.
+ */
+class AliasTable
+{
+public:
+    AliasTable() : total(0) {}
+
+    template <class WeightVector>
+    explicit AliasTable(const WeightVector &w) { Init(w); }
+
+    /// Build the table for the given weights (any random access container of values convertible to double).
+    template <class WeightVector>
+    void Init(const WeightVector &w)
+    {
+        const size_t n = w.size();
+        prob.assign(n, 1.0);
+        alias.resize(n);
+        total = 0;
+        for(size_t i=0; i<n; ++i)
+        {
+            assert(w[i] >= 0);
+            total += double(w[i]);
+        }
+        if(n==0 || total<=0) return;
+
+        std::vector<double> scaled(n);
+        std::vector<unsigned int> smallV, largeV;
+        for(size_t i=0; i<n; ++i)
+        {
+            alias[i] = (unsigned int)(i);
+            scaled[i] = double(w[i])*n/total;
+            if(scaled[i]<1.0) smallV.push_back((unsigned int)(i));
+            else              largeV.push_back((unsigned int)(i));
+        }
+        while(!smallV.empty() && !largeV.empty())
+        {
+            const unsigned int s = smallV.back(); smallV.pop_back();
+            const unsigned int l = largeV.back();
+            prob[s] = scaled[s];
+            alias[s] = l;
+            scaled[l] = (scaled[l]+scaled[s])-1.0;
+            if(scaled[l]<1.0) { largeV.pop_back(); smallV.push_back(l); }
+        }
+        // the leftovers are due to round off and keep probability one,
+        // but a zero weight must never be picked: it is redirected to any non zero one.
+        for(size_t i=0; i<largeV.size(); ++i) prob[largeV[i]] = 1.0;
+        size_t firstNonZero=0;
+        while(w[firstNonZero]<=0) ++firstNonZero;
+        for(size_t i=0; i<smallV.size(); ++i)
+        {
+            const unsigned int s = smallV[i];
+            prob[s] = 1.0;
+            if(w[s]<=0)
+            {
+                prob[s] = 0.0;
+                alias[s] = (unsigned int)(firstNonZero);
+            }
+        }
+    }
+
+    size_t size() const { return prob.size(); }
+
+    /// Sum of the weights used to build the table.
+    double Total() const { return total; }
+
+    /// Return an index with probability proportional to its weight (the table must not be empty).
+    template <class GeneratorType>
+    size_t Sample(GeneratorType &rnd) const
+    {
+        assert(!prob.empty());
+        // generate(n) is a modulo reduction, biased toward the first columns when n does not divide the range
+        const size_t n = prob.size();
+        const size_t i = std::min(size_t(rnd.generate01()*double(n)), n-1);
+        return (rnd.generate01() < prob[i]) ? i : alias[i];
+    }
+
+private:
+    std::vector<double> prob;
+    std::vector<unsigned int> alias;
+    double total;
+};
+
 } // end namespace math
 } // end namespace vcg
 
@@ -0,0 +1,114 @@
+/****************************************************************************
+* VCGLib                                                            o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2016                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef VCG_MATH_SPARSE_SOLVER_CACHE_H
+#define VCG_MATH_SPARSE_SOLVER_CACHE_H
+
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <assert.h>
+
+namespace vcg
+{
+  /*!
+  * Keeps the factorization of a sparse symmetric positive definite matrix across successive solves.
+  * Factorize() compares the given matrix with the last one it has seen:
+  * if the sparsity pattern is the same the symbolic analysis is reused and only the numeric factorization is redone,
+  * if the values are the same too even the numeric factorization is reused, so the solve costs only the back-substitution.
+  * The factorization is the same SimplicialCholesky used by the callers, so the results do not change.
+  */
+  template<class ScalarType>
+  class SparseSolverCache
+  {
+  public:
+    typedef Eigen::SparseMatrix<ScalarType> SparseMatrixType;
+    typedef Eigen::SimplicialCholesky<SparseMatrixType> SolverType;
+
+    SparseSolverCache() : patternValid(false), numericValid(false), analyzeNum(0), factorizeNum(0) {}
+
+    /*!
+    * Prepares the solver for the matrix S, redoing only the parts of the factorization that changed.
+    * Returns false if the factorization failed.
+    */
+    bool Factorize(const SparseMatrixType &S)
+    {
+      SparseMatrixType Sc(S);
+      Sc.makeCompressed();
+      const bool samePattern = patternValid && SamePattern(Sc, last);
+      if (samePattern && numericValid &&
+          std::equal(Sc.valuePtr(), Sc.valuePtr()+Sc.nonZeros(), last.valuePtr()))
+        return true;
+
+      if (!samePattern)
+      {
+        solver.analyzePattern(Sc);
+        ++analyzeNum;
+        patternValid = (solver.info()==Eigen::Success);
+      }
+      solver.factorize(Sc);
+      ++factorizeNum;
+      numericValid = (solver.info()==Eigen::Success);
+      last.swap(Sc);
+      return numericValid;
+    }
+
+    /// Solves S x = b with the last factorized matrix S.
+    template <class RhsType>
+    Eigen::Matrix<ScalarType, Eigen::Dynamic, RhsType::ColsAtCompileTime> Solve(const RhsType &b) const
+    {
+      assert(numericValid);
+      return solver.solve(b);
+    }
+
+    /// Drops the cached factorization, e.g. when the connectivity of the mesh changes.
+    void Clear()
+    {
+      patternValid = numericValid = false;
+      last = SparseMatrixType();
+    }
+
+    bool IsFactorized() const { return numericValid; }
+    /// Status of the solver, as the info() of the Eigen solver.
+    Eigen::ComputationInfo Info() const { return solver.info(); }
+    /// Number of symbolic analyses and numeric factorizations done so far.
+    int AnalyzeNum() const { return analyzeNum; }
+    int FactorizeNum() const { return factorizeNum; }
+
+  private:
+    static bool SamePattern(const SparseMatrixType &a, const SparseMatrixType &b)
+    {
+      if (a.rows()!=b.rows() || a.cols()!=b.cols() || a.nonZeros()!=b.nonZeros()) return false;
+      return std::equal(a.outerIndexPtr(), a.outerIndexPtr()+a.outerSize()+1, b.outerIndexPtr()) &&
+             std::equal(a.innerIndexPtr(), a.innerIndexPtr()+a.nonZeros(), b.innerIndexPtr());
+    }
+
+    SolverType solver;
+    SparseMatrixType last;
+    bool patternValid;
+    bool numericValid;
+    int analyzeNum;
+    int factorizeNum;
+  };
+}// end of namespace vcg
+
+#endif // VCG_MATH_SPARSE_SOLVER_CACHE_H
@@ -59,7 +59,11 @@ public:
 
 	template <class OBJPOINTDISTANCEFUNCT>
 	static inline ObjPtr Closest(TreeType & tree, OBJPOINTDISTANCEFUNCT & getPointDistance, const CoordType & p, const ScalarType & maxDist, ScalarType & minDist, CoordType & q) {
-		typedef std::vector<NodeType *> NodePtrVector;
+		// the squared distance lower bound of each node is kept together with the node pointer
+		// (and not in the node itself), so that concurrent queries over the same tree are safe.
+		typedef std::pair<NodeType *, ScalarType> NodeDist;
+		typedef std::vector<NodeDist> NodePtrVector;
+		typedef typename NodePtrVector::iterator NodePtrVector_i;
 		typedef typename NodePtrVector::const_iterator NodePtrVector_ci;
 
 		NodeType * pRoot = tree.pRoot;
@@ -75,41 +79,34 @@ public:
 		NodePtrVector * candidates = &clist1;
 		NodePtrVector * newCandidates = &clist2;
 
-		clist1.reserve(tree.pObjects.size());
-		clist2.reserve(tree.pObjects.size());
-		leaves.reserve(tree.pObjects.size());
-
-		clist1.resize(0);
-		clist2.resize(0);
-		leaves.resize(0);
-
 		ScalarType minMaxDist = maxDist * maxDist;
 
-		candidates->push_back(pRoot);
+		candidates->push_back(NodeDist(pRoot, ScalarType(0)));
 
 		while (!candidates->empty()) {
 			newCandidates->resize(0);
 
-			for (NodePtrVector_ci bv=candidates->begin(); bv!=candidates->end(); ++bv) {
-				const CoordType dc = Abs(p - (*bv)->boxCenter);
-				const ScalarType maxDist = (dc + (*bv)->boxHalfDims).SquaredNorm();
-				(*bv)->ScalarValue() = LowClampToZero(dc - (*bv)->boxHalfDims).SquaredNorm();
+			for (NodePtrVector_i bv=candidates->begin(); bv!=candidates->end(); ++bv) {
+				const CoordType dc = Abs(p - (*bv).first->boxCenter);
+				const ScalarType maxDist = (dc + (*bv).first->boxHalfDims).SquaredNorm();
+				(*bv).second = LowClampToZero(dc - (*bv).first->boxHalfDims).SquaredNorm();
 				if (maxDist < minMaxDist) {
 					minMaxDist = maxDist;
 				}
 			}
 
 			for (NodePtrVector_ci ci=candidates->begin(); ci!=candidates->end(); ++ci) {
-				if ((*ci)->ScalarValue() < minMaxDist) {
-					if ((*ci)->IsLeaf()) {
+				if ((*ci).second < minMaxDist) {
+					NodeType * node = (*ci).first;
+					if (node->IsLeaf()) {
 						leaves.push_back(*ci);
 					}
 					else {
-						if ((*ci)->children[0] != 0) {
-							newCandidates->push_back((*ci)->children[0]);
+						if (node->children[0] != 0) {
+							newCandidates->push_back(NodeDist(node->children[0], ScalarType(0)));
 						}
-						if ((*ci)->children[1] != 0) {
-							newCandidates->push_back((*ci)->children[1]);
+						if (node->children[1] != 0) {
+							newCandidates->push_back(NodeDist(node->children[1], ScalarType(0)));
 						}
 					}
 				}
@@ -119,9 +116,6 @@ public:
 			newCandidates = cSwap;
 		}
 
-		clist1.clear();
-		clist2.clear();
-
 		ObjPtr closestObject = 0;
 		CoordType closestPoint;
 		ScalarType closestDist = math::Sqrt(minMaxDist) + std::numeric_limits<ScalarType>::epsilon();
@@ -129,8 +123,8 @@ public:
 
 
 		for (NodePtrVector_ci ci=leaves.begin(); ci!=leaves.end(); ++ci) {
-			if ((*ci)->ScalarValue() < closestDistSq) {
-				for (typename TreeType::ObjPtrVectorConstIterator si=(*ci)->oBegin; si!=(*ci)->oEnd; ++si) {
+			if ((*ci).second < closestDistSq) {
+				for (typename TreeType::ObjPtrVectorConstIterator si=(*ci).first->oBegin; si!=(*ci).first->oEnd; ++si) {
 					if (getPointDistance(*(*si), p, closestDist, closestPoint)) {
 						closestDistSq = closestDist * closestDist;
 						closestObject = (*si);
@@ -141,8 +135,6 @@ public:
 			}
 		}
 
-		leaves.clear();
-
 		return (closestObject);
 	}
 